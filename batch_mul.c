@@ -0,0 +1,248 @@
+#include <string.h>
+#include <time.h>
+#include "common_defs.h"
+
+/*
+** Batched polynomial multiplication. Many small products of the same
+** size are done BATCH_LANES at a time in an interleaved layout: row j of
+** the work buffer holds coefficient j of every problem in the group, so
+** each butterfly is one vector operation with one lane per problem and
+** the twiddle is a scalar shared by all lanes. The rows are GCC vector
+** extension types, and the group kernel is compiled once per SIMD level
+** (target attributes, dispatched like fft_simd.c).
+**
+** The inverse transform uses the forward plan: IDFT(X) = conj(DFT(conj(X))).
+*/
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_SIMD
+#endif
+
+/* Problems per group (one per vector lane) */
+#define BATCH_LANES  8
+
+typedef double batch_vec __attribute__((vector_size(BATCH_LANES * sizeof(double))));
+
+/* One coefficient of BATCH_LANES problems */
+typedef struct
+{
+   batch_vec r;
+   batch_vec i;
+} batch_complex;
+
+/* Interleaved work rows for a and b (grow only, 64-byte aligned) */
+static fft_arena work = { NULL, 0 };
+
+/* batch_fft - in-place radix-2 FFT of bit-reversed rows x[0..n) */
+static inline __attribute__((always_inline))
+void batch_fft(batch_complex* x, int n, const complex* twiddle)
+{
+   batch_complex* top;
+   batch_complex* bot;
+   batch_vec tr, ti, ur, ui;
+   const complex* w;
+   int half, k, j;
+
+   for (half = 1; half < n; half <<= 1)
+   {
+      w = twiddle + (half - 1);
+      for (k = 0; k < n; k += 2*half)
+      {
+         top = x + k;
+         bot = x + k + half;
+         for (j = 0; j < half; j++)
+         {
+            tr = w[j].r * bot[j].r - w[j].i * bot[j].i;
+            ti = w[j].r * bot[j].i + w[j].i * bot[j].r;
+            ur = top[j].r;
+            ui = top[j].i;
+            top[j].r = ur + tr;
+            top[j].i = ui + ti;
+            bot[j].r = ur - tr;
+            bot[j].i = ui - ti;
+         }
+      }
+   }
+}
+
+/*
+** batch_group
+**
+** Multiply problems first .. first+lanes-1 (lanes <= BATCH_LANES). The
+** bit-reversal is folded into the interleaving load; unused lanes are
+** zero and never stored.
+*/
+static inline __attribute__((always_inline))
+void batch_group(const fft_plan* plan, complex** a, complex** b, int first,
+                 int lanes, batch_complex* x, batch_complex* y)
+{
+   batch_complex t;
+   batch_vec pr;
+   double scale = 1.0 / plan->n;
+   int n = plan->n;
+   int j, l, src;
+
+   for (j = 0; j < n; j++)
+   {
+      src = plan->rev[j];
+      for (l = 0; l < BATCH_LANES; l++)
+      {
+         x[j].r[l] = (l < lanes) ? a[first + l][src].r : 0.0;
+         x[j].i[l] = (l < lanes) ? a[first + l][src].i : 0.0;
+         y[j].r[l] = (l < lanes) ? b[first + l][src].r : 0.0;
+         y[j].i[l] = (l < lanes) ? b[first + l][src].i : 0.0;
+      }
+   }
+
+   batch_fft(x, n, plan->twiddle);
+   batch_fft(y, n, plan->twiddle);
+
+   /* Pointwise product, conjugated for the inverse */
+   for (j = 0; j < n; j++)
+   {
+      pr = x[j].r * y[j].r - x[j].i * y[j].i;
+      x[j].i = -(x[j].r * y[j].i + x[j].i * y[j].r);
+      x[j].r = pr;
+   }
+
+   /* Bit-reverse the rows for the second transform */
+   for (j = 0; j < n; j++)
+   {
+      src = plan->rev[j];
+      if (j < src)
+      {
+         t = x[j];
+         x[j] = x[src];
+         x[src] = t;
+      }
+   }
+
+   batch_fft(x, n, plan->twiddle);
+
+   for (l = 0; l < lanes; l++)
+   {
+      for (j = 0; j < n; j++)
+      {
+         a[first + l][j].r = x[j].r[l] * scale;
+         a[first + l][j].i = -x[j].i[l] * scale;
+      }
+   }
+}
+
+/* batch_groups_scalar - portable build of the group kernel */
+static void batch_groups_scalar(const fft_plan* plan, complex** a,
+                                complex** b, int count,
+                                batch_complex* x, batch_complex* y)
+{
+   int first;
+
+   for (first = 0; first < count; first += BATCH_LANES)
+   {
+      batch_group(plan, a, b, first,
+                  (count - first < BATCH_LANES) ? count - first : BATCH_LANES,
+                  x, y);
+   }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* batch_groups_avx2 - group kernel, two 256-bit registers per row */
+__attribute__((target("avx2,fma")))
+static void batch_groups_avx2(const fft_plan* plan, complex** a,
+                              complex** b, int count,
+                              batch_complex* x, batch_complex* y)
+{
+   int first;
+
+   for (first = 0; first < count; first += BATCH_LANES)
+   {
+      batch_group(plan, a, b, first,
+                  (count - first < BATCH_LANES) ? count - first : BATCH_LANES,
+                  x, y);
+   }
+}
+
+/* batch_groups_avx512 - group kernel, one 512-bit register per row */
+__attribute__((target("avx512f,avx2,fma")))
+static void batch_groups_avx512(const fft_plan* plan, complex** a,
+                                complex** b, int count,
+                                batch_complex* x, batch_complex* y)
+{
+   int first;
+
+   for (first = 0; first < count; first += BATCH_LANES)
+   {
+      batch_group(plan, a, b, first,
+                  (count - first < BATCH_LANES) ? count - first : BATCH_LANES,
+                  x, y);
+   }
+}
+
+#endif
+
+/* batch_one - a = a * b through the plans, b kept (four-step sizes) */
+static void batch_one(fft_plan* plan, complex* a, const complex* b)
+{
+   complex* y;
+   double scale = 1.0 / plan->n;
+   int j;
+
+   fft_arena_reserve(&work, plan->n);
+   y = work.buf;
+   memcpy(y, b, plan->n * sizeof(complex));
+
+   fft_execute(plan, a);
+   fft_execute(plan, y);
+   complex_mul_array(a, y, plan->n);
+   fft_execute(fft_plan_get(plan->n, 1), a);
+
+   for (j = 0; j < plan->n; j++)
+   {
+      a[j].r *= scale;
+      a[j].i *= scale;
+   }
+}
+
+/* poly_mul_batch - see common_defs.h for more details */
+double poly_mul_batch(complex** a, complex** b, int n, int count)
+{
+   struct timespec start, end;
+   batch_complex* x;
+   fft_plan* plan;
+   double elapsed;
+   int k;
+
+   plan = fft_plan_get(n, 0);
+   if (!plan || plan->num_factors > 0 || count < 1)
+      return 0.0;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   /* Four-step sizes are far too big to interleave; one product at a time */
+   if (!plan->rev)
+   {
+      for (k = 0; k < count; k++)
+         batch_one(plan, a[k], b[k]);
+   }
+   else
+   {
+
+      /* 2n rows of 2*BATCH_LANES doubles (fft_malloc is 64-byte aligned) */
+      fft_arena_reserve(&work, 2 * n * BATCH_LANES);
+      x = (batch_complex*)work.buf;
+
+#ifdef HAVE_X86_SIMD
+      if (fft_simd_level() == FFT_SIMD_AVX512)
+         batch_groups_avx512(plan, a, b, count, x, x + n);
+      else if (fft_simd_level() == FFT_SIMD_AVX2)
+         batch_groups_avx2(plan, a, b, count, x, x + n);
+      else
+#endif
+         batch_groups_scalar(plan, a, b, count, x, x + n);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+   return (elapsed > 0.0) ? count / elapsed : 0.0;
+}
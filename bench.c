@@ -0,0 +1,669 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "common_defs.h"
+#include "fft_alloc.h"
+#include "thread_pool.h"
+#include "ntt.h"
+#include "text_io.h"
+
+/*
+** Benchmark harness. Every case is one engine or one phase of the
+** multiply at one size. A case has an untimed prepare step (fresh
+** inputs) and a timed run step. Each sample is measured with the
+** monotonic wall clock after a few warm-up runs. Cases that leave their
+** inputs alone repeat the run step inside a sample until it lasts at
+** least BENCH_MIN_SAMPLE, and the time is divided by the repeat count.
+** The report gives the median, p90 and p99 of the samples, GFLOP/s
+** from the nominal flop count of the case, and GB/s from its nominal
+** bytes moved:
+**
+**    complex FFT of n points    5 n lg n flops, 32 n lg n bytes
+**                               (one read and one write per stage)
+**    real FFT of n points       half of the above
+**    pointwise multiply         6 n flops, 48 n bytes
+**    poly_mul of size n         3 FFTs + pointwise + scale
+**    float FFT                  same flops, half the bytes
+**
+** Results go to stdout as a table and optionally to JSON and CSV files
+** so runs can be compared across builds and hosts.
+*/
+
+#define MAX_COEFF          10
+#define MAX_SAMPLES        1001
+#define BENCH_MIN_SAMPLE   2e-4     /* seconds per sample (repeatable cases) */
+#define BENCH_MAX_INNER    100000
+#define BENCH_BATCH        1024     /* problems per poly_mul_batch sample */
+#define BENCH_BATCH_MAX_LG 11
+#define BENCH_STREAM_NK    1000     /* kernel length for the stream case */
+#define BENCH_STREAM_CHUNK 4096
+
+/* Block size for the stream case (-b, 0 for the poly_stream default) */
+static int stream_block = 0;
+
+/* Buffers shared by all cases, sized for the largest n */
+typedef struct
+{
+   int n;               /* current size */
+   complex* a;          /* working arrays */
+   complex* b;
+   complex* y;
+   complex* src_a;      /* random inputs (first half non-zero) */
+   complex* src_b;
+   complexf* fa;        /* single precision working array */
+   double* da;          /* real inputs/outputs */
+   double* db;
+   double* dc;
+   int32_t* ia;         /* integer inputs */
+   int32_t* ib;
+   int64_t* ic;
+   complex** batch_a;   /* BENCH_BATCH problems of up to 2^BENCH_BATCH_MAX_LG */
+   complex** batch_b;
+   char* text;          /* n integers as text */
+   size_t text_len;
+   FILE* text_fp;       /* text opened with fmemopen */
+   FILE* null_fp;       /* /dev/null */
+   fft_arena arena;     /* recursive FFT scratch */
+} bench_ctx;
+
+typedef struct
+{
+   const char* name;    /* "engine/phase" */
+   int min_lg;          /* sizes the case runs at */
+   int max_lg;
+   int repeatable;      /* 1 if run can be repeated without prepare */
+   void (*prepare)(bench_ctx* ctx);
+   void (*run)(bench_ctx* ctx);
+   double flops_per;    /* flops = flops_per * n lg n + flops_lin * n */
+   double flops_lin;
+   double bytes_per;    /* bytes = bytes_per * n lg n + bytes_lin * n */
+   double bytes_lin;
+} bench_case;
+
+/* One line of the report */
+typedef struct
+{
+   const char* name;
+   int n;
+   int samples;
+   int inner;
+   double median;
+   double p90;
+   double p99;
+   double min;
+   double gflops;       /* 0 if not meaningful */
+   double gbytes;
+} bench_result;
+
+static double now_sec(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+** Prepare steps
+*/
+
+/* copy_inputs - fresh padded complex inputs in a and b */
+static void copy_inputs(bench_ctx* ctx)
+{
+   memcpy(ctx->a, ctx->src_a, ctx->n * sizeof(complex));
+   memcpy(ctx->b, ctx->src_b, ctx->n * sizeof(complex));
+}
+
+/* spectra - a and b hold spectra (for the pointwise/inverse phases) */
+static void spectra(bench_ctx* ctx)
+{
+   copy_inputs(ctx);
+   fft_execute(fft_plan_get(ctx->n, 0), ctx->a);
+   fft_execute(fft_plan_get(ctx->n, 0), ctx->b);
+}
+
+/* float_inputs - padded input a in single precision */
+static void float_inputs(bench_ctx* ctx)
+{
+   int j;
+
+   for (j = 0; j < ctx->n; j++)
+   {
+      ctx->fa[j].r = (float)ctx->src_a[j].r;
+      ctx->fa[j].i = (float)ctx->src_a[j].i;
+   }
+}
+
+/* real_inputs - n/2 real coefficients in da and db */
+static void real_inputs(bench_ctx* ctx)
+{
+   int j;
+
+   for (j = 0; j < ctx->n; j++)
+   {
+      ctx->da[j] = ctx->src_a[j].r;
+      ctx->db[j] = ctx->src_b[j].r;
+   }
+}
+
+/* int_inputs - n/2 integer coefficients in ia and ib */
+static void int_inputs(bench_ctx* ctx)
+{
+   int j;
+
+   for (j = 0; j < ctx->n; j++)
+   {
+      ctx->ia[j] = (int32_t)ctx->src_a[j].r;
+      ctx->ib[j] = (int32_t)ctx->src_b[j].r;
+   }
+}
+
+/* batch_inputs - BENCH_BATCH padded problems of size n */
+static void batch_inputs(bench_ctx* ctx)
+{
+   int k;
+
+   for (k = 0; k < BENCH_BATCH; k++)
+   {
+      memcpy(ctx->batch_a[k], ctx->src_a, ctx->n * sizeof(complex));
+      memcpy(ctx->batch_b[k], ctx->src_b, ctx->n * sizeof(complex));
+   }
+}
+
+/* text_input - n random integers as text, opened for reading */
+static void text_input(bench_ctx* ctx)
+{
+   int j;
+
+   if (ctx->text_fp)
+      fclose(ctx->text_fp);
+
+   ctx->text_len = 0;
+   for (j = 0; j < ctx->n; j++)
+   {
+      ctx->text_len += sprintf(ctx->text + ctx->text_len, "%d ",
+                               (int)(ctx->src_a[j].r * 100003) - 500000);
+   }
+   ctx->text_fp = fmemopen(ctx->text, ctx->text_len, "r");
+}
+
+/*
+** Run steps
+*/
+
+static void run_recursive(bench_ctx* ctx)
+{
+   recursive_fft_arena(ctx->a, ctx->y, ctx->n, 0, &ctx->arena);
+}
+
+static void run_iterative(bench_ctx* ctx)
+{
+   iterative_fft(ctx->a, ctx->n, 0);
+}
+
+static void run_bitrev(bench_ctx* ctx)
+{
+   bit_reverse_copy(ctx->a, ctx->y, ctx->n);
+}
+
+static void run_forward(bench_ctx* ctx)
+{
+   fft_execute(fft_plan_get(ctx->n, 0), ctx->a);
+}
+
+static void run_inverse(bench_ctx* ctx)
+{
+   fft_execute(fft_plan_get(ctx->n, 1), ctx->a);
+}
+
+static void run_pointwise(bench_ctx* ctx)
+{
+   complex_mul_array(ctx->a, ctx->b, ctx->n);
+}
+
+static void run_scale(bench_ctx* ctx)
+{
+   double scale = 1.0 / ctx->n;
+   int j;
+
+   for (j = 0; j < ctx->n; j++)
+   {
+      ctx->a[j].r *= scale;
+      ctx->a[j].i *= scale;
+   }
+}
+
+static void run_poly_mul_recursive(bench_ctx* ctx)
+{
+   poly_mul_set_engine(FFT_ENGINE_RECURSIVE);
+   poly_mul(ctx->a, ctx->b, ctx->n);
+}
+
+static void run_poly_mul_iterative(bench_ctx* ctx)
+{
+   poly_mul_set_engine(FFT_ENGINE_ITERATIVE);
+   poly_mul(ctx->a, ctx->b, ctx->n);
+}
+
+static void run_poly_mul_plan(bench_ctx* ctx)
+{
+   poly_mul_set_engine(FFT_ENGINE_PLAN);
+   poly_mul(ctx->a, ctx->b, ctx->n);
+}
+
+static void run_rfft(bench_ctx* ctx)
+{
+   rfft(ctx->da, ctx->y, ctx->n);
+}
+
+static void run_poly_mul_real(bench_ctx* ctx)
+{
+   poly_mul_real(ctx->a, ctx->b, ctx->n);
+}
+
+static void run_poly_mul_auto(bench_ctx* ctx)
+{
+   poly_mul_auto(ctx->da, ctx->n/2, ctx->db, ctx->n/2, ctx->dc);
+}
+
+static void run_fft_float(bench_ctx* ctx)
+{
+   fft_float(ctx->fa, ctx->n, 0);
+}
+
+static void run_poly_mul_float(bench_ctx* ctx)
+{
+   poly_mul_float(ctx->da, ctx->n/2, ctx->db, ctx->n/2, ctx->dc);
+}
+
+static void run_ntt(bench_ctx* ctx)
+{
+   poly_mul_ntt32(ctx->ia, ctx->n/2, ctx->ib, ctx->n/2, ctx->ic);
+}
+
+static void run_batch(bench_ctx* ctx)
+{
+   poly_mul_batch(ctx->batch_a, ctx->batch_b, ctx->n, BENCH_BATCH);
+}
+
+/* discard - poly_stream callback that keeps the output live */
+static void discard(const double* c, int count, void* arg)
+{
+   *(double*)arg += c[count - 1];
+}
+
+static void run_stream(bench_ctx* ctx)
+{
+   poly_stream* s;
+   double sink = 0.0;
+   int j;
+
+   s = poly_stream_create(ctx->db, BENCH_STREAM_NK, stream_block, discard, &sink);
+   for (j = 0; j < ctx->n; j += BENCH_STREAM_CHUNK)
+   {
+      poly_stream_push(s, ctx->da + j,
+                       (ctx->n - j < BENCH_STREAM_CHUNK) ? ctx->n - j :
+                                                           BENCH_STREAM_CHUNK);
+   }
+   poly_stream_finish(s);
+   poly_stream_destroy(s);
+}
+
+static void run_parse(bench_ctx* ctx)
+{
+   text_reader r;
+   int64_t v;
+
+   text_reader_init(&r, ctx->text_fp);
+   while (text_read_int(&r, &v))
+      ;
+   text_reader_free(&r);
+}
+
+static void run_format(bench_ctx* ctx)
+{
+   text_writer w;
+   int j;
+
+   text_writer_init(&w, ctx->null_fp);
+   for (j = 0; j < ctx->n; j++)
+      text_write_coeff_double(&w, j, ctx->src_a[j].r * 100003);
+   text_writer_close(&w);
+}
+
+/*
+** Case table. Sizes are lg(n) of the transform (or of the input length
+** for stream/text). flops/bytes follow the header comment.
+*/
+static const bench_case cases[] =
+{
+   { "recursive_fft/forward", 1, 30, 1, copy_inputs, run_recursive,       5.0, 0.0, 32.0, 0.0 },
+   { "iterative_fft/forward", 1, 30, 0, copy_inputs, run_iterative,       5.0, 0.0, 32.0, 0.0 },
+   { "plan/bitrev",           1, 30, 1, copy_inputs, run_bitrev,          0.0, 0.0,  0.0, 32.0 },
+   { "plan/forward",          1, 30, 0, copy_inputs, run_forward,         5.0, 0.0, 32.0, 0.0 },
+   { "plan/pointwise",        1, 30, 0, spectra,     run_pointwise,       0.0, 6.0,  0.0, 48.0 },
+   { "plan/inverse",          1, 30, 0, spectra,     run_inverse,         5.0, 0.0, 32.0, 0.0 },
+   { "plan/scale",            1, 30, 0, copy_inputs, run_scale,           0.0, 2.0,  0.0, 32.0 },
+   { "poly_mul/recursive",    1, 30, 0, copy_inputs, run_poly_mul_recursive, 15.0, 8.0, 96.0, 80.0 },
+   { "poly_mul/iterative",    1, 30, 0, copy_inputs, run_poly_mul_iterative, 15.0, 8.0, 96.0, 80.0 },
+   { "poly_mul/plan",         1, 30, 0, copy_inputs, run_poly_mul_plan,   15.0, 8.0, 96.0, 80.0 },
+   { "real/rfft",             2, 30, 1, real_inputs, run_rfft,            2.5, 0.0, 16.0, 0.0 },
+   { "real/poly_mul_real",    2, 30, 0, copy_inputs, run_poly_mul_real,   7.5, 6.0, 48.0, 48.0 },
+   { "auto/poly_mul_auto",    2, 30, 1, real_inputs, run_poly_mul_auto,   7.5, 6.0, 48.0, 48.0 },
+   { "float/fft_float",       1, 30, 0, float_inputs, run_fft_float,     5.0, 0.0, 16.0, 0.0 },
+   { "float/poly_mul_float",  2, 30, 1, real_inputs, run_poly_mul_float, 10.0, 6.0, 32.0, 16.0 },
+   { "ntt/poly_mul_ntt32",    2, 24, 1, int_inputs,  run_ntt,             0.0, 0.0,  0.0, 0.0 },
+   { "batch/poly_mul_batch",  1, BENCH_BATCH_MAX_LG, 0, batch_inputs, run_batch,
+                              15.0 * BENCH_BATCH, 6.0 * BENCH_BATCH, 96.0 * BENCH_BATCH, 64.0 * BENCH_BATCH },
+   { "stream/poly_stream",   12, 30, 1, real_inputs, run_stream,          0.0, 0.0,  0.0, 16.0 },
+   { "text/parse",            8, 30, 0, text_input,  run_parse,           0.0, 0.0,  0.0, 0.0 },
+   { "text/format",           8, 30, 1, real_inputs, run_format,          0.0, 0.0,  0.0, 0.0 },
+};
+
+#define NUM_CASES  ((int)(sizeof(cases) / sizeof(cases[0])))
+
+static int cmp_double(const void* x, const void* y)
+{
+   double a = *(const double*)x, b = *(const double*)y;
+
+   return (a < b) ? -1 : (a > b);
+}
+
+/* percentile - nearest-rank percentile of sorted samples */
+static double percentile(const double* sorted, int count, double p)
+{
+   int k = (int)(p / 100.0 * count + 0.999999) - 1;
+
+   if (k < 0)
+      k = 0;
+   if (k >= count)
+      k = count - 1;
+   return sorted[k];
+}
+
+/* time_case - warm up, take samples, fill in the result */
+static void time_case(const bench_case* c, bench_ctx* ctx, int warmup,
+                      int reps, bench_result* res)
+{
+   double samples[MAX_SAMPLES];
+   double t, nlgn, flops, bytes;
+   int inner = 1;
+   int i, k, lg;
+
+   for (i = 0; i < warmup; i++)
+   {
+      c->prepare(ctx);
+      t = now_sec();
+      c->run(ctx);
+      t = now_sec() - t;
+   }
+
+   /* Repeatable cases: enough calls per sample to beat clock noise */
+   if (c->repeatable)
+   {
+      c->prepare(ctx);
+      t = now_sec();
+      c->run(ctx);
+      t = now_sec() - t;
+      while (inner < BENCH_MAX_INNER && inner * t < BENCH_MIN_SAMPLE)
+         inner *= 2;
+   }
+
+   for (i = 0; i < reps; i++)
+   {
+      c->prepare(ctx);
+      t = now_sec();
+      for (k = 0; k < inner; k++)
+         c->run(ctx);
+      samples[i] = (now_sec() - t) / inner;
+   }
+
+   qsort(samples, reps, sizeof(double), cmp_double);
+
+   for (lg = 0; (1 << lg) < ctx->n; lg++)
+      ;
+   nlgn = (double)ctx->n * lg;
+   flops = c->flops_per * nlgn + c->flops_lin * ctx->n;
+   bytes = c->bytes_per * nlgn + c->bytes_lin * ctx->n;
+
+   /* Text cases move the text itself */
+   if (c->run == run_parse)
+      bytes = (double)ctx->text_len;
+   if (c->run == run_format)
+      bytes = 20.0 * ctx->n;
+
+   res->name = c->name;
+   res->n = ctx->n;
+   res->samples = reps;
+   res->inner = inner;
+   res->median = percentile(samples, reps, 50.0);
+   res->p90 = percentile(samples, reps, 90.0);
+   res->p99 = percentile(samples, reps, 99.0);
+   res->min = samples[0];
+   res->gflops = flops / res->median * 1e-9;
+   res->gbytes = bytes / res->median * 1e-9;
+}
+
+/* host_json - write the host/build description */
+static void host_json(FILE* fp, int threads)
+{
+   char host[256];
+   time_t now = time(NULL);
+   char stamp[64];
+
+   if (gethostname(host, sizeof(host)) != 0)
+      strcpy(host, "unknown");
+   host[sizeof(host) - 1] = 0;
+   strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+   fprintf(fp, "  \"host\": \"%s\",\n", host);
+   fprintf(fp, "  \"date\": \"%s\",\n", stamp);
+#ifdef __VERSION__
+   fprintf(fp, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+   fprintf(fp, "  \"cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+   fprintf(fp, "  \"threads\": %d,\n", threads);
+   fprintf(fp, "  \"simd_level\": %d,\n", fft_simd_level());
+}
+
+static void usage(const char* prog)
+{
+   fprintf(stderr, "usage: %s [-s lo:hi] [-r reps] [-w warmup] [-k case]\n"
+                   "       [-b block] [-j file.json] [-c file.csv] [-t threads] [-l]\n", prog);
+   fprintf(stderr, "   -s   lg(n) range (default 4:18)\n");
+   fprintf(stderr, "   -r   timed samples per case and size (default 11)\n");
+   fprintf(stderr, "   -w   warm-up runs (default 2)\n");
+   fprintf(stderr, "   -k   only cases whose name contains this (repeatable)\n");
+   fprintf(stderr, "   -b   block size of the stream case (default: poly_stream's)\n");
+   fprintf(stderr, "   -j   write results as JSON\n");
+   fprintf(stderr, "   -c   write results as CSV\n");
+   fprintf(stderr, "   -t   number of threads (default: FFT_THREADS or all CPUs)\n");
+   fprintf(stderr, "   -l   list cases and exit\n");
+}
+
+int main(int argc, char* argv[])
+{
+   bench_ctx ctx;
+   bench_result* results;
+   const char* filters[NUM_CASES];
+   const char* json_path = NULL;
+   const char* csv_path = NULL;
+   FILE* fp;
+   int lo = 4, hi = 18, reps = 11, warmup = 2;
+   int num_filters = 0, num_results = 0;
+   int max_n, i, c, lg, k, f, match;
+
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-s") == 0 && (i + 1) < argc)
+      {
+         if (sscanf(argv[++i], "%d:%d", &lo, &hi) != 2)
+            hi = lo;
+      }
+      else if (strcmp(argv[i], "-r") == 0 && (i + 1) < argc)
+         reps = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-w") == 0 && (i + 1) < argc)
+         warmup = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-k") == 0 && (i + 1) < argc &&
+               num_filters < NUM_CASES)
+         filters[num_filters++] = argv[++i];
+      else if (strcmp(argv[i], "-b") == 0 && (i + 1) < argc)
+         stream_block = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-j") == 0 && (i + 1) < argc)
+         json_path = argv[++i];
+      else if (strcmp(argv[i], "-c") == 0 && (i + 1) < argc)
+         csv_path = argv[++i];
+      else if (strcmp(argv[i], "-t") == 0 && (i + 1) < argc)
+         tp_init(atoi(argv[++i]));
+      else if (strcmp(argv[i], "-l") == 0)
+      {
+         for (c = 0; c < NUM_CASES; c++)
+            printf("%s\n", cases[c].name);
+         return 0;
+      }
+      else
+      {
+         usage(argv[0]);
+         return 1;
+      }
+   }
+
+   if (lo < 1 || hi > 26 || lo > hi || reps < 1 || reps > MAX_SAMPLES ||
+       warmup < 0)
+   {
+      usage(argv[0]);
+      return 1;
+   }
+
+   /* Inputs for the largest size; smaller sizes use a prefix */
+   srand(1);
+   max_n = 1 << hi;
+   memset(&ctx, 0, sizeof(ctx));
+   ctx.a = (complex*)fft_alloc(max_n * sizeof(complex));
+   ctx.b = (complex*)fft_alloc(max_n * sizeof(complex));
+   ctx.y = (complex*)fft_alloc((max_n + 1) * sizeof(complex));
+   ctx.src_a = (complex*)fft_alloc(max_n * sizeof(complex));
+   ctx.src_b = (complex*)fft_alloc(max_n * sizeof(complex));
+   ctx.fa = (complexf*)fft_alloc(max_n * sizeof(complexf));
+   ctx.da = (double*)fft_alloc(max_n * sizeof(double));
+   ctx.db = (double*)fft_alloc((max_n > BENCH_STREAM_NK ? max_n : BENCH_STREAM_NK) * sizeof(double));
+   ctx.dc = (double*)fft_alloc(max_n * sizeof(double));
+   ctx.ia = (int32_t*)fft_alloc(max_n * sizeof(int32_t));
+   ctx.ib = (int32_t*)fft_alloc(max_n * sizeof(int32_t));
+   ctx.ic = (int64_t*)fft_alloc(max_n * sizeof(int64_t));
+   ctx.text = (char*)malloc((size_t)max_n * 12 + 1);
+   ctx.null_fp = fopen("/dev/null", "w");
+   ctx.batch_a = (complex**)malloc(BENCH_BATCH * sizeof(complex*));
+   ctx.batch_b = (complex**)malloc(BENCH_BATCH * sizeof(complex*));
+   for (k = 0; k < BENCH_BATCH; k++)
+   {
+      ctx.batch_a[k] = (complex*)fft_alloc((1 << BENCH_BATCH_MAX_LG) * sizeof(complex));
+      ctx.batch_b[k] = (complex*)fft_alloc((1 << BENCH_BATCH_MAX_LG) * sizeof(complex));
+   }
+   results = (bench_result*)malloc(NUM_CASES * (hi - lo + 1) * sizeof(bench_result));
+
+   printf("%-24s %9s %7s %13s %13s %13s %9s %9s\n", "case", "n", "inner",
+          "median (s)", "p90 (s)", "p99 (s)", "GFLOP/s", "GB/s");
+
+   for (lg = lo; lg <= hi; lg++)
+   {
+      ctx.n = 1 << lg;
+
+      /* Half random coefficients, half zero padding (as poly_mul expects) */
+      for (i = 0; i < ctx.n; i++)
+      {
+         ctx.src_a[i].r = (i < ctx.n/2 || ctx.n == 1) ? rand() % MAX_COEFF : 0.0;
+         ctx.src_a[i].i = 0.0;
+         ctx.src_b[i].r = (i < ctx.n/2 || ctx.n == 1) ? rand() % MAX_COEFF : 0.0;
+         ctx.src_b[i].i = 0.0;
+      }
+
+      for (c = 0; c < NUM_CASES; c++)
+      {
+         if (lg < cases[c].min_lg || lg > cases[c].max_lg)
+            continue;
+
+         match = (num_filters == 0);
+         for (f = 0; f < num_filters; f++)
+         {
+            if (strstr(cases[c].name, filters[f]))
+               match = 1;
+         }
+         if (!match)
+            continue;
+
+         time_case(&cases[c], &ctx, warmup, reps, &results[num_results]);
+         printf("%-24s %9d %7d %13.9f %13.9f %13.9f %9.3f %9.3f\n",
+            results[num_results].name, results[num_results].n,
+            results[num_results].inner, results[num_results].median,
+            results[num_results].p90, results[num_results].p99,
+            results[num_results].gflops, results[num_results].gbytes);
+         fflush(stdout);
+         num_results++;
+      }
+   }
+
+   if (json_path && (fp = fopen(json_path, "w")) != NULL)
+   {
+      fprintf(fp, "{\n");
+      host_json(fp, tp_num_threads());
+      fprintf(fp, "  \"warmup\": %d,\n  \"results\": [\n", warmup);
+      for (i = 0; i < num_results; i++)
+      {
+         fprintf(fp, "    { \"case\": \"%s\", \"n\": %d, \"samples\": %d, "
+                     "\"inner\": %d, \"median\": %.9e, \"p90\": %.9e, "
+                     "\"p99\": %.9e, \"min\": %.9e, \"gflops\": %.6f, "
+                     "\"gbytes\": %.6f }%s\n",
+            results[i].name, results[i].n, results[i].samples, results[i].inner,
+            results[i].median, results[i].p90, results[i].p99, results[i].min,
+            results[i].gflops, results[i].gbytes, (i + 1 < num_results) ? "," : "");
+      }
+      fprintf(fp, "  ]\n}\n");
+      fclose(fp);
+   }
+
+   if (csv_path && (fp = fopen(csv_path, "w")) != NULL)
+   {
+      fprintf(fp, "case,n,samples,inner,median,p90,p99,min,gflops,gbytes\n");
+      for (i = 0; i < num_results; i++)
+      {
+         fprintf(fp, "%s,%d,%d,%d,%.9e,%.9e,%.9e,%.9e,%.6f,%.6f\n",
+            results[i].name, results[i].n, results[i].samples, results[i].inner,
+            results[i].median, results[i].p90, results[i].p99, results[i].min,
+            results[i].gflops, results[i].gbytes);
+      }
+      fclose(fp);
+   }
+
+   for (k = 0; k < BENCH_BATCH; k++)
+   {
+      fft_alloc_free(ctx.batch_a[k]);
+      fft_alloc_free(ctx.batch_b[k]);
+   }
+   free(ctx.batch_a);
+   free(ctx.batch_b);
+   fft_alloc_free(ctx.a);
+   fft_alloc_free(ctx.b);
+   fft_alloc_free(ctx.y);
+   fft_alloc_free(ctx.src_a);
+   fft_alloc_free(ctx.src_b);
+   fft_alloc_free(ctx.fa);
+   fft_alloc_free(ctx.da);
+   fft_alloc_free(ctx.db);
+   fft_alloc_free(ctx.dc);
+   fft_alloc_free(ctx.ia);
+   fft_alloc_free(ctx.ib);
+   fft_alloc_free(ctx.ic);
+   free(ctx.text);
+   if (ctx.text_fp)
+      fclose(ctx.text_fp);
+   if (ctx.null_fp)
+      fclose(ctx.null_fp);
+   fft_arena_free(&ctx.arena);
+   free(results);
+   fft_plan_cache_clear();
+
+   return 0;
+}
@@ -1,5 +1,80 @@
 #include <stdlib.h>
 #include "common_defs.h"
+#include "fft_alloc.h"
+#include "fft_stats.h"
+#include "thread_pool.h"
+
+/* Transforms at least this long run the two forward DFTs concurrently */
+#define PARALLEL_MIN   (1<<15)
+#define GRAIN          4096
+
+/* Arguments for running fft_execute/complex_mul_array as pool tasks */
+typedef struct
+{
+   fft_plan* plan;
+   complex* a;
+   complex* b;
+} fft_job;
+
+/* FFT engine used by poly_mul */
+static int fft_engine = FFT_ENGINE_PLAN;
+
+/* fft_malloc - see common_defs.h for more details */
+void* fft_malloc(size_t size)
+{
+   fft_probe probe;
+   void* ptr;
+
+   fft_probe_begin(&probe);
+   ptr = fft_alloc(size);
+   fft_probe_end(&probe, FFT_PHASE_ALLOC, 0.0);
+
+   return ptr;
+}
+
+/* fft_free - see common_defs.h for more details */
+void fft_free(void* ptr)
+{
+   fft_probe probe;
+
+   fft_probe_begin(&probe);
+   fft_alloc_free(ptr);
+   fft_probe_end(&probe, FFT_PHASE_ALLOC, 0.0);
+}
+
+/* fft_alloc_count - see common_defs.h for more details */
+long fft_alloc_count(void)
+{
+   fft_alloc_stats stats;
+
+   fft_alloc_get_stats(&stats);
+   return stats.system;
+}
+
+/* fft_alloc_count_reset - see common_defs.h for more details */
+void fft_alloc_count_reset(void)
+{
+   fft_alloc_reset_stats();
+}
+
+/* fft_arena_reserve - see common_defs.h for more details */
+void fft_arena_reserve(fft_arena* arena, int size)
+{
+   if (arena->size >= size)
+      return;
+   
+   fft_free(arena->buf);
+   arena->buf = (complex*)fft_malloc(size * sizeof(complex));
+   arena->size = size;
+}
+
+/* fft_arena_free - see common_defs.h for more details */
+void fft_arena_free(fft_arena* arena)
+{
+   fft_free(arena->buf);
+   arena->buf = NULL;
+   arena->size = 0;
+}
 
 /* complex_mul - see common_defs.h for more details */
 complex complex_mul(complex a, complex b)
@@ -34,40 +109,187 @@ complex complex_sub(complex a, complex b)
    return ans;
 }
 
-#if 0
 /* bit_reverse_copy - see common_defs.h for more details */
-void bit_reverse_copy(complex* a, complex* a_rev_copy)
+void bit_reverse_copy(complex* a, complex* A, int n)
 {
-   a = 0;
+   int i, j, k;
+   
+   /* j tracks the bit-reversal of i (add 1 starting at the MSB) */
+   j = 0;
+   for (i = 0; i < n; i++)
+   {
+      A[j] = a[i];
+      
+      k = n >> 1;
+      while (k && (j & k))
+      {
+         j ^= k;
+         k >>= 1;
+      }
+      j |= k;
+   }
+}
+
+/* fft_task - fft_execute as a pool task */
+static void fft_task(void* arg)
+{
+   fft_job* job = (fft_job*)arg;
+   
+   fft_execute(job->plan, job->a);
+}
+
+/* mul_range - complex_mul_array on [begin, end) as a pool task */
+static void mul_range(void* arg, int begin, int end)
+{
+   fft_job* job = (fft_job*)arg;
+   
+   complex_mul_array(job->a + begin, job->b + begin, end - begin);
+}
+
+/* poly_mul_set_engine - see common_defs.h for more details */
+void poly_mul_set_engine(int engine)
+{
+   fft_engine = engine;
 }
-#endif
 
 /* poly_mul - see common_defs.h for more details */
 void poly_mul(complex* a, complex* b, int n)
 {
    complex* ya;
-   complex* yb;
+   fft_arena* arena;
+   fft_arena scratch;
+   fft_plan* fwd;
+   fft_plan* inv;
+   fft_job job;
+   fft_probe probe;
+   tp_task task;
+   double bytes = (double)n * sizeof(complex);
    int j;
    
-   /* Allocate storage for fft results */
-   ya = (complex*)malloc(n * sizeof(complex));
-   yb = (complex*)malloc(n * sizeof(complex));
+   if (fft_engine == FFT_ENGINE_PLAN)
+   {
+      /* Plans are built once per size and reused across calls */
+      fwd = fft_plan_get(n, 0);
+      inv = fft_plan_get(n, 1);
+      
+      job.plan = fwd;
+      job.a = a;
+      job.b = b;
+      
+      if (n >= PARALLEL_MIN && tp_num_threads() > 1)
+      {
+         /* 
+         ** DFT of B is independent of A, so hand it to the pool. Mixed
+         ** radix and four-step plans have one work buffer, so they do
+         ** one transform at a time (four-step spreads its own work).
+         */
+         fft_probe_begin(&probe);
+         fft_simd_level();
+         if (fwd->work)
+         {
+            fft_execute(fwd, a);
+            fft_execute(fwd, b);
+         }
+         else
+         {
+            job.a = b;
+            tp_spawn(&task, fft_task, &job);
+            fft_execute(fwd, a);
+            tp_wait(&task);
+            job.a = a;
+         }
+         fft_probe_end(&probe, FFT_PHASE_FORWARD, 4*bytes);
+         
+         /* Pointwise Multiplication split across threads */
+         fft_probe_begin(&probe);
+         tp_parallel_for(n, GRAIN, mul_range, &job);
+         fft_probe_end(&probe, FFT_PHASE_POINTWISE, 3*bytes);
+      }
+      else
+      {
+         /* DFT of A and B (in place) */
+         fft_probe_begin(&probe);
+         fft_execute(fwd, a);
+         fft_execute(fwd, b);
+         fft_probe_end(&probe, FFT_PHASE_FORWARD, 4*bytes);
+         
+         /* Pointwise Multiplication */
+         fft_probe_begin(&probe);
+         complex_mul_array(a, b, n);
+         fft_probe_end(&probe, FFT_PHASE_POINTWISE, 3*bytes);
+      }
+      
+      /* Inverse DFT (in place) */
+      fft_probe_begin(&probe);
+      fft_execute(inv, a);
+      fft_probe_end(&probe, FFT_PHASE_INVERSE, 2*bytes);
+      
+      /* Divide real part by n */
+      fft_probe_begin(&probe);
+      for (j = 0; j < n; j++)
+         a[j].r = a[j].r/n;
+      fft_probe_end(&probe, FFT_PHASE_SCALE, 2*bytes);
+      
+      return;
+   }
+   else if (fft_engine == FFT_ENGINE_ITERATIVE)
+   {
+      /* DFT of A and B (in place) */
+      fft_probe_begin(&probe);
+      iterative_fft(a, n, 0);
+      iterative_fft(b, n, 0);
+      fft_probe_end(&probe, FFT_PHASE_FORWARD, 4*bytes);
+      
+      /* Pointwise Multiplication */
+      fft_probe_begin(&probe);
+      complex_mul_array(a, b, n);
+      fft_probe_end(&probe, FFT_PHASE_POINTWISE, 3*bytes);
+      
+      /* Inverse DFT (in place) */
+      fft_probe_begin(&probe);
+      iterative_fft(a, n, 1);
+      fft_probe_end(&probe, FFT_PHASE_INVERSE, 2*bytes);
+      
+      /* Divide real part by n */
+      fft_probe_begin(&probe);
+      for (j = 0; j < n; j++)
+         a[j].r = a[j].r/n;
+      fft_probe_end(&probe, FFT_PHASE_SCALE, 2*bytes);
+      
+      return;
+   }
+   
+   /* 
+   ** Recursive engine. Everything comes from the arena of the cached
+   ** forward plan: n entries for the DFT of A followed by the 2n entries
+   ** of recursion scratch. The DFT of B is written into a, since a has
+   ** been consumed by then.
+   */
+   arena = &fft_plan_get(n, 0)->arena;
+   fft_arena_reserve(arena, 3*n);
+   ya = arena->buf;
+   scratch.buf = arena->buf + n;
+   scratch.size = 2*n;
    
    /* DFT of A and B */
-   recursive_fft(a, ya, n, 0);
-   recursive_fft(b, yb, n, 0);
+   fft_probe_begin(&probe);
+   recursive_fft_arena(a, ya, n, 0, &scratch);
+   recursive_fft_arena(b, a, n, 0, &scratch);
+   fft_probe_end(&probe, FFT_PHASE_FORWARD, 4*bytes);
    
    /* Pointwise Multiplication */
-   for (j = 0; j < n; j++)
-      ya[j] = complex_mul(ya[j], yb[j]);
+   fft_probe_begin(&probe);
+   complex_mul_array(ya, a, n);
+   fft_probe_end(&probe, FFT_PHASE_POINTWISE, 3*bytes);
       
    /* Inverse DFT (swapped input and output arrays) */
-   recursive_fft(ya, a, n, 1);
+   fft_probe_begin(&probe);
+   recursive_fft_arena(ya, a, n, 1, &scratch);
+   fft_probe_end(&probe, FFT_PHASE_INVERSE, 2*bytes);
    
    /* Divide real part by n */
-   for (j = 0; j < (n-1); j++)
+   fft_probe_begin(&probe);
+   for (j = 0; j < n; j++)
       a[j].r = a[j].r/n;
-      
-   free(ya);
-   free(yb);
+   fft_probe_end(&probe, FFT_PHASE_SCALE, 2*bytes);
 }
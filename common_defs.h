@@ -4,15 +4,128 @@
 #define _USE_MATH_DEFINES /* for M_PI constant */
 
 #include <math.h>
+#include <stddef.h>
 
 #define PI M_PI /* from math.h */
 
+/* FFT engines available to poly_mul (see poly_mul_set_engine) */
+#define FFT_ENGINE_RECURSIVE  0
+#define FFT_ENGINE_ITERATIVE  1
+#define FFT_ENGINE_PLAN       2
+
+/* Precision modes of poly_mul_auto (see poly_mul_set_precision) */
+#define POLY_PRECISION_AUTO   0  /* float when provably exact, else double */
+#define POLY_PRECISION_DOUBLE 1
+#define POLY_PRECISION_FLOAT  2
+
+/* SIMD kernel levels (see fft_simd_level) */
+#define FFT_SIMD_SCALAR       0
+#define FFT_SIMD_AVX2         1  /* AVX2 + FMA */
+#define FFT_SIMD_AVX512       2  /* AVX-512F */
+
 typedef struct
 {
    double r; /* real */
    double i; /* imaginary */
 } complex;
 
+/* Single precision complex (fft_float, poly_mul_float) */
+typedef struct
+{
+   float r;
+   float i;
+} complexf;
+
+/*
+** fft_arena
+**
+** Reusable scratch memory for the recursive FFT. The buffer
+** only grows (see fft_arena_reserve), so once it is big
+** enough a transform does no heap activity. Initialize to
+** { NULL, 0 }.
+*/
+typedef struct
+{
+   complex* buf;        /* scratch buffer */
+   int size;            /* capacity of buf in complex numbers */
+} fft_arena;
+
+/* Most radices a mixed radix plan can have (n < 2^31) */
+#define MAX_FACTORS  32
+
+/* 
+** fft_plan
+**
+** Precomputed data for transforms of one size and direction.
+** twiddle holds one table per butterfly stage: the m/2
+** twiddles w_m^j for a stage of size m start at offset m/2-1.
+** Sizes 2^a * 3^b * 5^c that are not powers of 2 use a mixed
+** radix plan instead (num_factors > 0, rev and twiddle NULL).
+** Powers of 2 from FFT_FOUR_STEP_MIN up use a four-step plan
+** (rows != NULL, rev and twiddle NULL): n = n1 * n2 is done
+** as n2 transforms of n1, a twiddle multiply and n1 
+** transforms of n2, with blocked transposes in between.
+*/
+typedef struct fft_plan
+{
+   int n;               /* transform length */
+   int lg_n;            /* log (base 2) of n, -1 for mixed radix */
+   int inv;             /* 1 if inverse DFT, 0 otherwise */
+   int* rev;            /* bit-reversal permutation indices */
+   complex* twiddle;    /* n-1 twiddle factors for all stages */
+   int num_factors;     /* number of radices (mixed radix only) */
+   int factors[MAX_FACTORS]; /* radices 4, 2, 3, 5 in execution order */
+   complex* mixed_tw;   /* per level twiddles (mixed radix only) */
+   complex* work;       /* ping-pong/transpose buffer (mixed radix and
+                           four-step only) */
+   struct fft_plan* rows; /* length n1 sub-plan (four-step only) */
+   struct fft_plan* cols; /* length n2 sub-plan (four-step only) */
+   complex* tw_hi;      /* w_n^(h*2^lo_bits) (four-step only) */
+   complex* tw_lo;      /* w_n^l for l < 2^lo_bits (four-step only) */
+   int lo_bits;         /* split of the four-step twiddle exponent */
+   fft_arena arena;     /* scratch owned by the plan (recursive engine) */
+} fft_plan;
+
+/*
+** poly_spectrum
+**
+** A fixed polynomial in transformed form (see 
+** poly_spectrum_create). spec holds bins 0..size/2 of the
+** real DFT of the zero padded coefficients, divided by size.
+*/
+typedef struct
+{
+   int n;               /* number of coefficients */
+   int size;            /* real transform length */
+   complex* spec;       /* size/2+1 bins, scaled by 1/size */
+   double* coeffs;      /* copy of the coefficients (cache check) */
+} poly_spectrum;
+
+/* poly_stream_fn - receives count finished product coefficients */
+typedef void (*poly_stream_fn)(const double* c, int count, void* arg);
+
+/*
+** poly_stream
+**
+** State of a streaming multiply by a fixed kernel (see
+** poly_stream_create). Input is buffered into blocks and the
+** last nk-1 coefficients of each block product are carried.
+*/
+typedef struct
+{
+   int nk;              /* kernel length */
+   int block;           /* input coefficients per transform */
+   poly_spectrum* kernel; /* kernel spectrum for blocks of this size */
+   double* in;          /* buffered input (block) */
+   double* prod;        /* block product (block + nk - 1) */
+   double* tail;        /* carried coefficients (nk - 1) */
+   int in_count;        /* coefficients waiting in in */
+   long pushed;         /* input coefficients so far */
+   long emitted;        /* output coefficients so far */
+   poly_stream_fn emit; /* output callback */
+   void* arg;           /* passed to emit */
+} poly_stream;
+
 /*---------------------------------------------------------
 ** NAME: bit_reverse_copy
 **
@@ -24,14 +137,16 @@ typedef struct
 **
 ** INPUTS:
 **    a     Complex array of polynomial coefficients
+**    n     Length of array (must be a power of 2)
 **
 ** OUTPUTS:
-**    A     Bit-reversed copy of a
+**    A     Bit-reversed copy of a. User must allocate
+**          this memory.
 **
 ** RETURNS: void
 **
 **-------------------------------------------------------*/
-void bit_reverse_copy(complex* a, complex* a_rev_copy);
+void bit_reverse_copy(complex* a, complex* A, int n);
 
 /*---------------------------------------------------------
 ** NAME: recursive_fft
@@ -56,6 +171,76 @@ void bit_reverse_copy(complex* a, complex* a_rev_copy);
 **-------------------------------------------------------*/
 void recursive_fft(complex* a, complex* y, int n, int inv);
 
+/*---------------------------------------------------------
+** NAME: recursive_fft_arena
+**
+** PURPOSE:
+**    Same as recursive_fft, but all even/odd split buffers
+**    are carved out of a caller supplied arena (2n complex
+**    numbers in total). The arena is only grown if it is
+**    too small, so reusing it across calls of the same
+**    size does no heap allocation.
+**
+** INPUTS:
+**    a     Complex array of polynomial coefficients
+**    n     Length of array (must be a power of 2)
+**    inv   1 if performing inverse DFT, 0 otherwise
+**    arena Scratch arena (e.g. plan->arena)
+**
+** OUTPUTS:
+**    y     An array of n complex numbers representing the 
+**          evaluation of the input polynomial at complex 
+**          roots of unity. User must allocate this memory.  
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void recursive_fft_arena(complex* a, complex* y, int n, int inv, 
+                         fft_arena* arena);
+
+/*---------------------------------------------------------
+** NAME: rfft
+**
+** PURPOSE:
+**    DFT of a real sequence using a single complex FFT of
+**    half the length. Since the spectrum of real input is
+**    conjugate symmetric (y[n-k] = conj(y[k])), only bins
+**    0..n/2 are produced.
+**
+** INPUTS:
+**    x     Real array of n polynomial coefficients
+**    n     Length of array (even, n/2 = 2^a * 3^b * 5^c)
+**
+** OUTPUTS:
+**    y     Bins 0..n/2 of the DFT of x. User must allocate
+**          n/2+1 complex numbers.
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void rfft(double* x, complex* y, int n);
+
+/*---------------------------------------------------------
+** NAME: irfft
+**
+** PURPOSE:
+**    Inverse of rfft. Like recursive_fft with inv = 1, the
+**    result is not divided by n.
+**
+** INPUTS:
+**    y     Bins 0..n/2 of a conjugate symmetric spectrum
+**          (contents are destroyed)
+**    n     Length of the real output (even, n/2 = 
+**          2^a * 3^b * 5^c)
+**
+** OUTPUTS:
+**    x     n real values of the inverse DFT, times n
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void irfft(complex* y, double* x, int n);
+
 /*---------------------------------------------------------
 ** NAME: iterative_fft
 **
@@ -64,6 +249,10 @@ void recursive_fft(complex* a, complex* y, int n, int inv);
 **    for evaluating polynomials at complex roots of unity.
 **    Used as a helper function for multiplying polynomials.
 **
+**    The input is bit-reverse permuted in place, followed
+**    by lg(n) butterfly passes over the same buffer, so no
+**    memory is allocated.
+**
 ** INPUTS:
 **    a     Complex array of polynomial coefficients
 **    n     Length of array (must be a power of 2)
@@ -79,13 +268,100 @@ void recursive_fft(complex* a, complex* y, int n, int inv);
 **-------------------------------------------------------*/
 void iterative_fft(complex* a, int n, int inv);
 
+/*---------------------------------------------------------
+** NAME: fft_plan_create
+**
+** PURPOSE:
+**    Build a plan for transforms of a given size and
+**    direction. Bit-reversal indices and twiddle tables
+**    are computed once here, so repeated fft_execute calls
+**    do no trigonometry. Twiddles are evaluated directly
+**    with cos/sin instead of a running product.
+**
+**    Lengths of the form 2^a * 3^b * 5^c that are not
+**    powers of 2 get a mixed radix (Stockham) plan, so
+**    padding only has to reach the next such size (see
+**    fft_good_size).
+**
+**    Powers of 2 of at least 2^21 (FFT_FOUR_STEP_MIN
+**    environment variable, 0 to disable) get a four-step
+**    plan: the array is treated as a matrix of about
+**    sqrt(n) x sqrt(n), so each sub-transform fits in
+**    cache and the tables are only O(sqrt(n)) long.
+**
+** INPUTS:
+**    n     Transform length (2^a * 3^b * 5^c)
+**    inv   1 for inverse DFT, 0 otherwise
+**
+** OUTPUTS: none
+**
+** RETURNS: New plan (free with fft_plan_destroy), or NULL
+**          if n has a prime factor other than 2, 3 or 5
+**
+**-------------------------------------------------------*/
+fft_plan* fft_plan_create(int n, int inv);
+
+/*---------------------------------------------------------
+** NAME: fft_execute
+**
+** PURPOSE:
+**    Run the in-place FFT described by a plan. For powers
+**    of 2 gives the same results as iterative_fft (the 
+**    inverse is not scaled by 1/n). Not reentrant for
+**    mixed radix and four-step plans (they own a work
+**    buffer).
+**
+** INPUTS:
+**    plan  Plan from fft_plan_create or fft_plan_get
+**    a     Complex array of plan->n coefficients
+**
+** OUTPUTS:
+**    a     DFT (or inverse DFT) of the input
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void fft_execute(fft_plan* plan, complex* a);
+
+/* fft_plan_destroy - free a plan created by fft_plan_create */
+void fft_plan_destroy(fft_plan* plan);
+
+/*---------------------------------------------------------
+** NAME: fft_plan_get
+**
+** PURPOSE:
+**    Return a cached plan for the given size and direction,
+**    creating it on first use. Cached plans are owned by
+**    the library and must not be destroyed by the caller.
+**    Only the most recently used mixed radix sizes are
+**    kept, so do not hold on to those plans across more
+**    than one other call.
+**
+** INPUTS:
+**    n     Transform length (2^a * 3^b * 5^c)
+**    inv   1 for inverse DFT, 0 otherwise
+**
+** OUTPUTS: none
+**
+** RETURNS: Cached plan, or NULL if n is not supported
+**
+**-------------------------------------------------------*/
+fft_plan* fft_plan_get(int n, int inv);
+
+/* fft_plan_cache_clear - destroy all plans cached by fft_plan_get */
+void fft_plan_cache_clear(void);
+
+/* fft_good_size - smallest 2^a * 3^b * 5^c >= n (a valid plan length) */
+int fft_good_size(int n);
+
 /*---------------------------------------------------------
 ** NAME: poly_mul
 **
 ** PURPOSE:
 **    Perform polynomial multiplication per CLRS algorithm.
 **    Utilizes the recursive (or iterative fft) for converting
-**    to/from coefficient and point-value forms.
+**    to/from coefficient and point-value forms. The engine
+**    is selected with poly_mul_set_engine.
 **
 **    NOTE: It is assumed that the coefficient arrays are
 **    already padded with zeros.
@@ -98,12 +374,527 @@ void iterative_fft(complex* a, int n, int inv);
 ** OUTPUTS:
 **    a     Coefficient vector resulting from polynomial
 **          multiplication of a and b.  
+**    b     Used as scratch space (contents are destroyed)
 **
 ** RETURNS: void
 **
 **-------------------------------------------------------*/
 void poly_mul(complex* a, complex* b, int n);
 
+/*---------------------------------------------------------
+** NAME: poly_mul_batch
+**
+** PURPOSE:
+**    poly_mul for many problems of the same size. Problems
+**    are interleaved in groups of 8, one SIMD lane per 
+**    problem, and every group runs through the same cached
+**    plan and work buffer, so the batch does no allocation
+**    once the buffer is big enough. Suited to small n;
+**    sizes with a four-step plan are done one at a time.
+**
+**    NOTE: As with poly_mul, the coefficient arrays must
+**    already be padded with zeros.
+**
+** INPUTS:
+**    a     count complex arrays of n coefficients
+**    b     count complex arrays of n coefficients
+**    n     Size of every coefficient array (power of 2)
+**    count Number of products
+**
+** OUTPUTS:
+**    a     a[k] holds the product of a[k] and b[k] (b is
+**          not modified)
+**
+** RETURNS: Throughput of the call in multiplications per
+**          second, or 0 if n is not a power of 2
+**
+**-------------------------------------------------------*/
+double poly_mul_batch(complex** a, complex** b, int n, int count);
+
+/*---------------------------------------------------------
+** NAME: poly_mul_real
+**
+** PURPOSE:
+**    Same as poly_mul for polynomials with real coefficients.
+**    a and b are packed into the real and imaginary parts
+**    of one complex FFT, their spectra are separated by
+**    conjugate symmetry, and the product goes through a
+**    half-length real inverse transform. This is roughly
+**    half the FFT work of poly_mul. Always uses cached
+**    plans.
+**
+** INPUTS:
+**    a     Complex array of polynomial coefficients (only
+**          the real parts are used)
+**    b     Complex array of polynomial coefficients (only
+**          the real parts are used)
+**    n     Size of coefficient arrays a and b (even,
+**          n/2 = 2^a * 3^b * 5^c)
+**
+** OUTPUTS:
+**    a     Coefficient vector resulting from polynomial
+**          multiplication of a and b.
+**    b     Used as scratch space (contents are destroyed)
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void poly_mul_real(complex* a, complex* b, int n);
+
+/*---------------------------------------------------------
+** NAME: poly_mul_auto
+**
+** PURPOSE:
+**    Multiply two real polynomials, picking the algorithm
+**    by the shorter length s (the longer one is l):
+**
+**       s < karatsuba threshold    schoolbook O(l*s)
+**       s < FFT threshold          Karatsuba (l/s chunks
+**                                  of s if l > s)
+**       l >= 4*s                   blocked FFT: overlap-add
+**                                  with a transform of ~4s
+**       otherwise                  poly_mul_real
+**
+**    Above the schoolbook sizes, poly_mul_float replaces 
+**    the above when the precision mode allows it (see
+**    poly_mul_set_precision); in auto mode its result is 
+**    rounded, which is then exact.
+**
+**    FFT lengths are the smallest 2^a * 3^b * 5^c sizes that
+**    hold the product, not the next power of 2. No padding
+**    is needed by the caller. The thresholds
+**    come from poly_mul_set_thresholds, the
+**    POLYMUL_KARATSUBA_MIN and POLYMUL_FFT_MIN environment
+**    variables, or poly_mul_autotune. Scratch memory is 
+**    kept between calls, so this is not reentrant.
+**
+** INPUTS:
+**    a     na real coefficients
+**    na    Number of coefficients in a (>= 1)
+**    b     nb real coefficients
+**    nb    Number of coefficients in b (>= 1)
+**
+** OUTPUTS:
+**    c     na+nb-1 coefficients of a*b. User must allocate
+**          this memory.
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void poly_mul_auto(const double* a, int na, const double* b, int nb, 
+                   double* c);
+
+/*---------------------------------------------------------
+** NAME: poly_mul_set_precision
+**
+** PURPOSE:
+**    Select the precision of poly_mul_auto above the 
+**    schoolbook threshold. POLY_PRECISION_AUTO (the default,
+**    or POLYMUL_PRECISION=auto|double|float) uses
+**    poly_mul_float when the coefficients are integers and
+**    poly_mul_float_bound guarantees the rounded product is
+**    exact, and double otherwise. That worst-case bound
+**    only passes for short operands with small norms (0/1
+**    coefficients up to 128 terms), so in practice
+**    float is reached through POLY_PRECISION_FLOAT, which
+**    always uses it (no exactness guarantee).
+**
+** INPUTS:
+**    mode  POLY_PRECISION_AUTO, POLY_PRECISION_DOUBLE or
+**          POLY_PRECISION_FLOAT
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void poly_mul_set_precision(int mode);
+
+/* 
+** poly_mul_precision_stats - number of poly_mul_auto calls done in float
+** and in double since start-up (schoolbook sizes are not counted)
+*/
+void poly_mul_precision_stats(long* floats, long* doubles);
+
+/*---------------------------------------------------------
+** NAME: fft_float
+**
+** PURPOSE:
+**    In-place single precision FFT (same sign convention as
+**    the double engines, inverse unscaled). Twiddles are
+**    computed with cos/sin in double and rounded to float
+**    once per size (no double plan is built).
+**    Butterflies are SIMD dispatched like fft_butterfly_pass.
+**
+** INPUTS:
+**    a     Complex float array of n elements
+**    n     Length of array (power of 2, 2 .. 2^30)
+**    inv   1 if inverse DFT, 0 otherwise
+**
+** OUTPUTS:
+**    a     Transformed array
+**
+** RETURNS: 0, or -1 (a untouched) if n is not a power of 2
+**          up to 2^30
+**
+**-------------------------------------------------------*/
+int fft_float(complexf* a, int n, int inv);
+
+/*---------------------------------------------------------
+** NAME: poly_mul_float
+**
+** PURPOSE:
+**    Multiply two real polynomials in single precision. a
+**    and b are packed into one complex float FFT of the 
+**    next power of 2 above na+nb-1, and the product goes 
+**    back through a second one. The result is not rounded
+**    (see poly_mul_float_bound for when rounding it is
+**    exact). Products of more than 2^30 terms are too long
+**    for fft_float; poly_mul_auto multiplies those in 
+**    double.
+**
+** INPUTS:
+**    a     na real coefficients
+**    na    Number of coefficients in a (>= 1)
+**    b     nb real coefficients
+**    nb    Number of coefficients in b (>= 1)
+**
+** OUTPUTS:
+**    c     na+nb-1 coefficients of a*b
+**
+** RETURNS: 0, or -1 (c untouched) if na+nb-1 > 2^30
+**
+**-------------------------------------------------------*/
+int poly_mul_float(const double* a, int na, const double* b, int nb,
+                   double* c);
+
+/*---------------------------------------------------------
+** NAME: poly_mul_float_bound
+**
+** PURPOSE:
+**    A-priori bound on the largest coefficient error of
+**    poly_mul_float for these operands, from Percival's FFT
+**    convolution error bound with the float unit roundoff,
+**    the transform length and the operand 2-norms. If the
+**    bound is below 0.5 and the inputs are integers, 
+**    rounding the float product gives the exact product.
+**
+** INPUTS:
+**    a     na real coefficients
+**    na    Number of coefficients in a
+**    b     nb real coefficients
+**    nb    Number of coefficients in b
+**
+** OUTPUTS: none
+**
+** RETURNS: The bound, or HUGE_VAL if a coefficient is not
+**          an integer of magnitude at most 2^24 or the 
+**          product is too long for poly_mul_float
+**
+**-------------------------------------------------------*/
+double poly_mul_float_bound(const double* a, int na, const double* b, int nb);
+
+/*---------------------------------------------------------
+** NAME: poly_spectrum_create
+**
+** PURPOSE:
+**    Transform a fixed polynomial b once so it can be 
+**    multiplied by many others with poly_mul_spectrum. The
+**    transform length is the smallest supported size that
+**    holds a product with max_na coefficients of input; 
+**    longer inputs are done in blocks.
+**
+** INPUTS:
+**    b       nb real coefficients (copied)
+**    nb      Number of coefficients in b (>= 1)
+**    max_na  Longest input done in a single transform
+**
+** OUTPUTS: none
+**
+** RETURNS: New handle (free with poly_spectrum_destroy),
+**          or NULL for bad sizes
+**
+**-------------------------------------------------------*/
+poly_spectrum* poly_spectrum_create(const double* b, int nb, int max_na);
+
+/* poly_spectrum_destroy - free a handle from poly_spectrum_create */
+void poly_spectrum_destroy(poly_spectrum* s);
+
+/*---------------------------------------------------------
+** NAME: poly_mul_spectrum
+**
+** PURPOSE:
+**    Multiply a by the polynomial held in a spectrum handle.
+**    Inputs of up to size - nb + 1 coefficients cost one 
+**    forward and one inverse real transform; longer ones
+**    are split into blocks of that length (overlap-add).
+**    Scratch memory is kept between calls, so this is not
+**    reentrant.
+**
+** INPUTS:
+**    a     na real coefficients
+**    na    Number of coefficients in a (>= 1)
+**    s     Handle from poly_spectrum_create/get
+**
+** OUTPUTS:
+**    c     na+s->n-1 coefficients of a*b. User must
+**          allocate this memory.
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void poly_mul_spectrum(const double* a, int na, const poly_spectrum* s,
+                       double* c);
+
+/*---------------------------------------------------------
+** NAME: poly_spectrum_get
+**
+** PURPOSE:
+**    Same as poly_spectrum_create, but the handle comes from
+**    a 16 entry LRU cache keyed by an FNV-1a hash of the
+**    coefficients, nb and the transform size. Hash matches
+**    are checked against the stored coefficients. The cache
+**    owns the handle; it stays valid until 16 other spectra
+**    have been requested.
+**
+** INPUTS:
+**    b       nb real coefficients
+**    nb      Number of coefficients in b (>= 1)
+**    max_na  Longest input done in a single transform
+**
+** OUTPUTS: none
+**
+** RETURNS: Cached handle, or NULL for bad sizes
+**
+**-------------------------------------------------------*/
+poly_spectrum* poly_spectrum_get(const double* b, int nb, int max_na);
+
+/* poly_spectrum_cache_stats - hits and misses of poly_spectrum_get */
+void poly_spectrum_cache_stats(long* hits, long* misses);
+
+/* poly_spectrum_cache_clear - free cached spectra, reset the counters */
+void poly_spectrum_cache_clear(void);
+
+/*---------------------------------------------------------
+** NAME: poly_stream_create
+**
+** PURPOSE:
+**    Start a streaming multiply of an unbounded input by a 
+**    fixed kernel polynomial (overlap-add). Input is given
+**    in any number of poly_stream_push calls; finished
+**    product coefficients are passed to emit in order as
+**    soon as no later input can change them. Memory is set
+**    by block and nk, not by the input length.
+**
+** INPUTS:
+**    kernel  nk real coefficients (copied)
+**    nk      Number of kernel coefficients (>= 1)
+**    block   Input coefficients per transform (<= 0 picks
+**            a default). Bigger blocks mean fewer, larger
+**            transforms and more latency.
+**    emit    Called with each run of finished coefficients
+**    arg     Passed to emit
+**
+** OUTPUTS: none
+**
+** RETURNS: New stream (free with poly_stream_destroy), or
+**          NULL for bad arguments
+**
+**-------------------------------------------------------*/
+poly_stream* poly_stream_create(const double* kernel, int nk, int block,
+                                poly_stream_fn emit, void* arg);
+
+/* poly_stream_push - append count input coefficients to a stream */
+void poly_stream_push(poly_stream* s, const double* a, int count);
+
+/* 
+** poly_stream_finish - flush the partial block and the carried tail (the
+** stream has then emitted na+nk-1 coefficients in total)
+*/
+void poly_stream_finish(poly_stream* s);
+
+/* poly_stream_destroy - free a stream from poly_stream_create */
+void poly_stream_destroy(poly_stream* s);
+
+/* poly_mul_schoolbook - direct O(na*nb) product, c gets na+nb-1 coefficients */
+void poly_mul_schoolbook(const double* a, int na, const double* b, int nb,
+                         double* c);
+
+/* poly_mul_karatsuba - Karatsuba product, c gets 2n-1 coefficients */
+void poly_mul_karatsuba(const double* a, const double* b, double* c, int n);
+
+/*---------------------------------------------------------
+** NAME: poly_mul_set_thresholds
+**
+** PURPOSE:
+**    Set the crossover points used by poly_mul_auto.
+**    Karatsuba recursion also stops at karatsuba_n.
+**
+** INPUTS:
+**    karatsuba_n Smallest n multiplied with Karatsuba
+**    fft_n       Smallest n multiplied with the FFT
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void poly_mul_set_thresholds(int karatsuba_n, int fft_n);
+
+/* poly_mul_get_thresholds - current crossover points of poly_mul_auto */
+void poly_mul_get_thresholds(int* karatsuba_n, int* fft_n);
+
+/*---------------------------------------------------------
+** NAME: poly_mul_autotune
+**
+** PURPOSE:
+**    Measure the schoolbook/Karatsuba and Karatsuba/FFT 
+**    crossover points on this host (takes a fraction of a
+**    second) and use them in poly_mul_auto. Read them back
+**    with poly_mul_get_thresholds to save them in the
+**    environment variables.
+**
+** INPUTS: none
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void poly_mul_autotune(void);
+
+/*---------------------------------------------------------
+** NAME: poly_mul_set_engine
+**
+** PURPOSE:
+**    Select the FFT engine used by subsequent poly_mul
+**    calls. The plan engine (cached fft_plan per size) is
+**    the default.
+**
+** INPUTS:
+**    engine   FFT_ENGINE_RECURSIVE, FFT_ENGINE_ITERATIVE or
+**             FFT_ENGINE_PLAN
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void poly_mul_set_engine(int engine);
+
+/*---------------------------------------------------------
+** NAME: fft_butterfly_pass
+**
+** PURPOSE:
+**    One radix-2 butterfly stage of an in-place iterative
+**    FFT: for every block of 2*half elements,
+**
+**       t = w[j] * a[k+j+half]
+**       a[k+j] = a[k+j] + t,  a[k+j+half] = a[k+j] - t
+**
+**    Dispatches to the scalar, AVX2 or AVX-512 kernel
+**    selected by fft_simd_level.
+**
+** INPUTS:
+**    a     Complex array of n elements
+**    n     Length of array (must be a power of 2)
+**    half  Half the butterfly size (1, 2, 4, ... n/2)
+**    w     half twiddle factors for this stage
+**
+** OUTPUTS:
+**    a     Array after the butterfly stage
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void fft_butterfly_pass(complex* a, int n, int half, const complex* w);
+
+/* 
+** fft_butterflies - count butterflies of one stage on separate top and
+** bottom halves: t = w[j]*bot[j], top[j] += t, bot[j] = old top[j] - t.
+** Used to split a single large stage across threads.
+*/
+void fft_butterflies(complex* top, complex* bot, const complex* w, int count);
+
+/* complex_mul_array - pointwise a[j] = a[j] * b[j] (SIMD dispatched) */
+void complex_mul_array(complex* a, const complex* b, int n);
+
+/*---------------------------------------------------------
+** NAME: fft_simd_level
+**
+** PURPOSE:
+**    SIMD level used by the FFT kernels. Detected from the
+**    CPU on first use. Setting the FFT_SIMD environment
+**    variable to "scalar" or "avx2" caps the level.
+**
+** INPUTS: none
+**
+** OUTPUTS: none
+**
+** RETURNS: FFT_SIMD_SCALAR, FFT_SIMD_AVX2 or FFT_SIMD_AVX512
+**
+**-------------------------------------------------------*/
+int fft_simd_level(void);
+
+/* fft_simd_set_level - select a SIMD level (capped to what the CPU has) */
+void fft_simd_set_level(int level);
+
+/*---------------------------------------------------------
+** NAME: fft_arena_reserve
+**
+** PURPOSE:
+**    Make sure an arena holds at least size complex
+**    numbers. Existing contents are not preserved when the
+**    buffer grows.
+**
+** INPUTS:
+**    arena Arena to grow
+**    size  Required capacity in complex numbers
+**
+** OUTPUTS:
+**    arena Arena with buf of at least size entries
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void fft_arena_reserve(fft_arena* arena, int size);
+
+/* fft_arena_free - release an arena's buffer and reset it to empty */
+void fft_arena_free(fft_arena* arena);
+
+/*
+** fft_malloc / fft_free
+**
+** Heap allocation used by all FFT and multiplication code, backed by
+** fft_alloc (fft_alloc.h): blocks are 64-byte aligned and recycled by
+** size class, so only requests the free lists can't serve reach the
+** system. Those are counted, see fft_alloc_count.
+*/
+void* fft_malloc(size_t size);
+void fft_free(void* ptr);
+
+/*---------------------------------------------------------
+** NAME: fft_alloc_count
+**
+** PURPOSE:
+**    Number of blocks fft_malloc had to get from the system
+**    (recycled blocks are not counted) since start-up (or
+**    the last fft_alloc_count_reset).
+**    The allocations done by one poly_mul call are the
+**    difference of two readings taken around the call.
+**
+** INPUTS: none
+**
+** OUTPUTS: none
+**
+** RETURNS: Allocation count
+**
+**-------------------------------------------------------*/
+long fft_alloc_count(void);
+
+/* fft_alloc_count_reset - set the allocation counter back to 0 */
+void fft_alloc_count_reset(void);
+
 /* 
 ** complex_mul
 **    
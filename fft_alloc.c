@@ -0,0 +1,291 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "fft_alloc.h"
+
+/*
+** Each block starts with a one cache line header, so the caller's
+** pointer (just past it) keeps the block's alignment. Small blocks come
+** from posix_memalign; blocks of FFT_HUGE_MIN and up are anonymous
+** mappings aligned to a huge page, so THP can back all of them when it
+** is turned on.
+**
+** Size classes are quarter octaves: 2^k, 1.25*2^k, 1.5*2^k, 1.75*2^k
+** bytes, from 64 bytes up. A freed block goes on its class's list and
+** the next request of that class takes it back.
+*/
+
+#define HUGE_PAGE        (2u << 20)   /* x86-64 huge page size */
+#define MIN_CLASS_BITS   6            /* smallest class is 64 bytes */
+#define MAX_CLASS_BITS   48
+#define NUM_CLASSES      (4 * (MAX_CLASS_BITS - MIN_CLASS_BITS + 1))
+#define DEFAULT_CACHE_MB 1024
+
+/* Block header (exactly one cache line) */
+typedef union fft_block
+{
+   struct
+   {
+      union fft_block* next;  /* next free block of the class */
+      void* base;             /* start of the allocation or mapping */
+      size_t map_size;        /* mapping length, 0 for heap blocks */
+      size_t cap;             /* usable bytes (the class size) */
+      int cls;                /* size class */
+   } h;
+   char pad[FFT_ALLOC_ALIGN];
+} fft_block;
+
+static fft_block* free_list[NUM_CLASSES];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static fft_alloc_stats stats;
+
+/* Huge page mode and free list limit, -1 until read from the environment */
+static int huge_mode = -1;
+static long long cache_limit = -1;
+
+/* load_settings - FFT_HUGEPAGES and FFT_ALLOC_CACHE_MB (lock held) */
+static void load_settings(void)
+{
+   char* env;
+
+   if (huge_mode < 0)
+   {
+      huge_mode = FFT_HUGE_OFF;
+      env = getenv("FFT_HUGEPAGES");
+      if (env && strcmp(env, "thp") == 0)
+         huge_mode = FFT_HUGE_THP;
+      else if (env && strcmp(env, "explicit") == 0)
+         huge_mode = FFT_HUGE_EXPLICIT;
+   }
+
+   if (cache_limit < 0)
+   {
+      cache_limit = (long long)DEFAULT_CACHE_MB << 20;
+      env = getenv("FFT_ALLOC_CACHE_MB");
+      if (env)
+         cache_limit = (long long)atoi(env) << 20;
+   }
+}
+
+/* size_class - class of a request and its size in bytes */
+static int size_class(size_t size, size_t* cap)
+{
+   size_t quarter;
+   int k, q;
+
+   if (size <= ((size_t)1 << MIN_CLASS_BITS))
+   {
+      *cap = (size_t)1 << MIN_CLASS_BITS;
+      return 0;
+   }
+
+   /* 2^k <= size-1 < 2^(k+1), then the quarter step that covers size */
+   k = 63 - __builtin_clzll((unsigned long long)(size - 1));
+   quarter = (size_t)1 << (k - 2);
+   q = (int)((size - ((size_t)1 << k) + quarter - 1) / quarter);
+   if (q == 4)
+   {
+      k++;
+      q = 0;
+      quarter <<= 1;
+   }
+
+   *cap = ((size_t)1 << k) + q * quarter;
+   return 4 * (k - MIN_CLASS_BITS) + q;
+}
+
+/*
+** map_block
+**
+** Anonymous mapping for total bytes (a multiple of HUGE_PAGE). In
+** explicit mode MAP_HUGETLB is tried first; otherwise the mapping is
+** over-allocated by one huge page, trimmed to a huge page boundary and
+** marked MADV_HUGEPAGE (THP mode).
+*/
+static void* map_block(size_t total, int* huge)
+{
+   char* p;
+   size_t head;
+
+   *huge = 0;
+
+#ifdef MAP_HUGETLB
+   if (huge_mode == FFT_HUGE_EXPLICIT)
+   {
+      p = (char*)mmap(NULL, total, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED)
+      {
+         *huge = 1;
+         return p;
+      }
+   }
+#endif
+
+   p = (char*)mmap(NULL, total + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (p == MAP_FAILED)
+      return NULL;
+
+   head = (HUGE_PAGE - ((uintptr_t)p & (HUGE_PAGE - 1))) & (HUGE_PAGE - 1);
+   if (head)
+      munmap(p, head);
+   if (HUGE_PAGE - head)
+      munmap(p + head + total, HUGE_PAGE - head);
+   p += head;
+
+#ifdef MADV_HUGEPAGE
+   if (huge_mode != FFT_HUGE_OFF)
+      madvise(p, total, MADV_HUGEPAGE);
+#endif
+
+   return p;
+}
+
+/* system_alloc - new block of class cls (cap bytes) from the system */
+static fft_block* system_alloc(int cls, size_t cap)
+{
+   fft_block* blk;
+   void* base;
+   size_t total = 0;
+   int huge = 0;
+
+   if (cap + sizeof(fft_block) >= FFT_HUGE_MIN)
+   {
+      total = (cap + sizeof(fft_block) + HUGE_PAGE - 1) & ~(size_t)(HUGE_PAGE - 1);
+      base = map_block(total, &huge);
+   }
+   else if (posix_memalign(&base, FFT_ALLOC_ALIGN, cap + sizeof(fft_block)))
+      base = NULL;
+
+   if (!base)
+      return NULL;
+
+   blk = (fft_block*)base;
+   blk->h.base = base;
+   blk->h.map_size = total;
+   blk->h.cap = cap;
+   blk->h.cls = cls;
+
+   stats.system++;
+   stats.huge += huge;
+
+   return blk;
+}
+
+/* system_free - give a block back to the system */
+static void system_free(fft_block* blk)
+{
+   if (blk->h.map_size)
+      munmap(blk->h.base, blk->h.map_size);
+   else
+      free(blk->h.base);
+
+   stats.released++;
+}
+
+/* fft_alloc - see fft_alloc.h for more details */
+void* fft_alloc(size_t size)
+{
+   fft_block* blk;
+   size_t cap;
+   int cls;
+
+   cls = size_class(size, &cap);
+   if (cls >= NUM_CLASSES)
+      return NULL;
+
+   pthread_mutex_lock(&lock);
+   load_settings();
+
+   blk = free_list[cls];
+   if (blk)
+   {
+      free_list[cls] = blk->h.next;
+      stats.cached -= cap;
+      stats.reused++;
+   }
+   else
+      blk = system_alloc(cls, cap);
+
+   pthread_mutex_unlock(&lock);
+
+   return blk ? (void*)(blk + 1) : NULL;
+}
+
+/* fft_alloc_free - see fft_alloc.h for more details */
+void fft_alloc_free(void* ptr)
+{
+   fft_block* blk;
+
+   if (!ptr)
+      return;
+
+   blk = (fft_block*)ptr - 1;
+
+   pthread_mutex_lock(&lock);
+   load_settings();
+
+   if ((long long)(stats.cached + blk->h.cap) > cache_limit)
+      system_free(blk);
+   else
+   {
+      blk->h.next = free_list[blk->h.cls];
+      free_list[blk->h.cls] = blk;
+      stats.cached += blk->h.cap;
+   }
+
+   pthread_mutex_unlock(&lock);
+}
+
+/* fft_alloc_trim - see fft_alloc.h for more details */
+void fft_alloc_trim(void)
+{
+   fft_block* blk;
+   int cls;
+
+   pthread_mutex_lock(&lock);
+
+   for (cls = 0; cls < NUM_CLASSES; cls++)
+   {
+      while (free_list[cls])
+      {
+         blk = free_list[cls];
+         free_list[cls] = blk->h.next;
+         system_free(blk);
+      }
+   }
+   stats.cached = 0;
+
+   pthread_mutex_unlock(&lock);
+}
+
+/* fft_alloc_set_huge - see fft_alloc.h for more details */
+void fft_alloc_set_huge(int mode)
+{
+   pthread_mutex_lock(&lock);
+   load_settings();
+   huge_mode = mode;
+   pthread_mutex_unlock(&lock);
+}
+
+/* fft_alloc_get_stats - see fft_alloc.h for more details */
+void fft_alloc_get_stats(fft_alloc_stats* s)
+{
+   pthread_mutex_lock(&lock);
+   *s = stats;
+   pthread_mutex_unlock(&lock);
+}
+
+/* fft_alloc_reset_stats - see fft_alloc.h for more details */
+void fft_alloc_reset_stats(void)
+{
+   pthread_mutex_lock(&lock);
+   stats.system = 0;
+   stats.reused = 0;
+   stats.released = 0;
+   stats.huge = 0;
+   pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,114 @@
+#ifndef FFT_ALLOC_H
+#define FFT_ALLOC_H
+
+#include <stddef.h>
+
+/*
+** Buffer allocator for transform data. Every block is aligned to
+** FFT_ALLOC_ALIGN bytes (a cache line, and the width of an AVX-512
+** load). Freed blocks are kept on per size class free lists and handed
+** out again, so repeated multiplies of the same size do not go back to
+** the system. Blocks of at least FFT_HUGE_MIN bytes are mapped directly
+** (aligned to a huge page) and can be backed by huge pages, see
+** fft_alloc_set_huge.
+*/
+#define FFT_ALLOC_ALIGN    64
+#define FFT_HUGE_MIN       ((size_t)2 << 20)
+
+/* Huge page modes */
+#define FFT_HUGE_OFF       0     /* 4 KiB pages only (default) */
+#define FFT_HUGE_THP       1     /* madvise(MADV_HUGEPAGE) */
+#define FFT_HUGE_EXPLICIT  2     /* MAP_HUGETLB, THP if none are free */
+
+/*
+** fft_alloc_stats
+**
+** Allocator counters since start-up (or fft_alloc_reset_stats).
+*/
+typedef struct
+{
+   long system;         /* blocks obtained from the system */
+   long reused;         /* requests served from a free list */
+   long released;       /* blocks given back to the system */
+   long huge;           /* system blocks mapped with MAP_HUGETLB */
+   size_t cached;       /* bytes currently held on the free lists */
+} fft_alloc_stats;
+
+/*---------------------------------------------------------
+** NAME: fft_alloc
+**
+** PURPOSE:
+**    Allocate an aligned block of at least size bytes. The
+**    request is rounded up to its size class (quarter
+**    octaves, so at most 25% is wasted) and served from
+**    that class's free list when possible. Thread safe.
+**
+** INPUTS:
+**    size  Bytes needed
+**
+** OUTPUTS: none
+**
+** RETURNS: FFT_ALLOC_ALIGN aligned block (contents are
+**          undefined), or NULL if the system is out of
+**          memory
+**
+**-------------------------------------------------------*/
+void* fft_alloc(size_t size);
+
+/*---------------------------------------------------------
+** NAME: fft_alloc_free
+**
+** PURPOSE:
+**    Return a block from fft_alloc to its free list. If the
+**    free lists would then hold more than the cache limit
+**    (FFT_ALLOC_CACHE_MB environment variable, default 1024)
+**    the block goes back to the system instead.
+**
+** INPUTS:
+**    ptr   Block from fft_alloc, or NULL (ignored)
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void fft_alloc_free(void* ptr);
+
+/* fft_alloc_trim - give every cached free block back to the system */
+void fft_alloc_trim(void);
+
+/*---------------------------------------------------------
+** NAME: fft_alloc_set_huge
+**
+** PURPOSE:
+**    Select how blocks of FFT_HUGE_MIN bytes and up are
+**    backed. The default comes from the FFT_HUGEPAGES
+**    environment variable (off, thp or explicit), or off.
+**    Explicit huge pages must be reserved by the
+**    administrator (vm.nr_hugepages); when none are left
+**    the block falls back to THP. Affects new system
+**    allocations only.
+**
+**    Huge pages cut TLB misses, but being physically
+**    contiguous they also make the power of 2 strides of
+**    the radix-2 passes (up to n/2) hit the same sets of
+**    the physically indexed caches. Measure both: four-step
+**    plans don't have those strides.
+**
+** INPUTS:
+**    mode  FFT_HUGE_OFF, FFT_HUGE_THP or FFT_HUGE_EXPLICIT
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void fft_alloc_set_huge(int mode);
+
+/* fft_alloc_get_stats - copy the allocator counters */
+void fft_alloc_get_stats(fft_alloc_stats* stats);
+
+/* fft_alloc_reset_stats - zero the counters (cached is left as is) */
+void fft_alloc_reset_stats(void);
+
+#endif /* FFT_ALLOC_H */
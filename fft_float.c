@@ -0,0 +1,398 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "common_defs.h"
+#include "fft_stats.h"
+
+/*
+** Single precision FFT and real polynomial multiply. complexf is half
+** the size of complex, so a 256-bit register holds four points instead
+** of two and every pass moves half the bytes. The butterflies are the
+** same interleaved fmaddsub kernels as fft_simd.c, in float.
+**
+** Twiddles are computed with cos/sin in double and rounded once to
+** float, so each is within one float rounding of the exact root.
+** poly_mul_float_bound turns that and the float rounding of every
+** butterfly into an a-priori bound on the product error.
+*/
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* Largest supported lg(n) */
+#define FLOAT_MAX_LG  30
+
+/* Unit roundoff of float (round to nearest) */
+#define FLOAT_EPS     (1.0 / (1 << 24))
+
+/* Float twiddles per size, same layout as fft_plan.twiddle */
+static complexf* twiddle_cache[FLOAT_MAX_LG + 1];
+
+/* Work buffer of poly_mul_float (grow only) */
+static complexf* work = NULL;
+static int work_size = 0;
+
+/*
+** float_twiddles
+**
+** Float twiddles for n = 2^lg, stage of size m at offset m/2-1. The
+** largest stage comes from cos/sin in double and the smaller ones
+** subsample it (w_m^j = w_n^(j*n/m)), like the double plan's table but
+** without building (and caching) a double plan for n.
+*/
+static const complexf* float_twiddles(int lg)
+{
+   complexf* tw;
+   complexf* top;
+   double theta;
+   int n = 1 << lg;
+   int m, j;
+
+   if (!twiddle_cache[lg])
+   {
+      tw = (complexf*)fft_malloc((n > 1 ? n - 1 : 1) * sizeof(complexf));
+      top = tw + (n/2 - 1);
+      for (j = 0; j < (n/2); j++)
+      {
+         theta = 2*PI*(double)j/(double)n;
+         top[j].r = (float)cos(theta);
+         top[j].i = (float)sin(theta);
+      }
+      for (m = 2; m < n; m <<= 1)
+      {
+         for (j = 0; j < (m/2); j++)
+            tw[m/2 - 1 + j] = top[j * (n/m)];
+      }
+      twiddle_cache[lg] = tw;
+   }
+
+   return twiddle_cache[lg];
+}
+
+/* butterflies_scalar - portable float butterflies on top[j], bot[j] */
+static void butterflies_scalar(complexf* top, complexf* bot, const complexf* w,
+                               int count)
+{
+   complexf t, u, v;
+   int j;
+
+   for (j = 0; j < count; j++)
+   {
+      v = bot[j];
+      t.r = w[j].r * v.r - w[j].i * v.i;
+      t.i = w[j].r * v.i + w[j].i * v.r;
+      u = top[j];
+      top[j].r = u.r + t.r;
+      top[j].i = u.i + t.i;
+      bot[j].r = u.r - t.r;
+      bot[j].i = u.i - t.i;
+   }
+}
+
+/* passes_scalar - all butterfly passes, portable */
+static void passes_scalar(complexf* a, int n, const complexf* twiddle)
+{
+   int half, k;
+
+   for (half = 1; half < n; half <<= 1)
+   {
+      for (k = 0; k < n; k += 2*half)
+         butterflies_scalar(a + k, a + k + half, twiddle + (half - 1), half);
+   }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* cmul_avx2 - four complex float products per register */
+__attribute__((target("avx2,fma")))
+static inline __m256 cmul_avx2(__m256 v, __m256 w)
+{
+   __m256 wr = _mm256_moveldup_ps(w);
+   __m256 wi = _mm256_movehdup_ps(w);
+   __m256 vs = _mm256_permute_ps(v, 0xB1);
+
+   return _mm256_fmaddsub_ps(v, wr, _mm256_mul_ps(vs, wi));
+}
+
+/* passes_avx2 - butterfly passes with half < end, 4 per iteration from half 4 */
+__attribute__((target("avx2,fma")))
+static void passes_avx2(complexf* a, int n, const complexf* twiddle, int end)
+{
+   const complexf* w;
+   complexf* top;
+   complexf* bot;
+   __m256 u, t;
+   int half, k, j;
+
+   for (half = 1; half < n && half < 4; half <<= 1)
+   {
+      for (k = 0; k < n; k += 2*half)
+         butterflies_scalar(a + k, a + k + half, twiddle + (half - 1), half);
+   }
+
+   for (; half < n && half < end; half <<= 1)
+   {
+      w = twiddle + (half - 1);
+      for (k = 0; k < n; k += 2*half)
+      {
+         top = a + k;
+         bot = a + k + half;
+         for (j = 0; j < half; j += 4)
+         {
+            u = _mm256_loadu_ps(&top[j].r);
+            t = cmul_avx2(_mm256_loadu_ps(&bot[j].r), _mm256_loadu_ps(&w[j].r));
+            _mm256_storeu_ps(&top[j].r, _mm256_add_ps(u, t));
+            _mm256_storeu_ps(&bot[j].r, _mm256_sub_ps(u, t));
+         }
+      }
+   }
+}
+
+/* cmul_avx512 - eight complex float products per register */
+__attribute__((target("avx512f")))
+static inline __m512 cmul_avx512(__m512 v, __m512 w)
+{
+   __m512 wr = _mm512_moveldup_ps(w);
+   __m512 wi = _mm512_movehdup_ps(w);
+   __m512 vs = _mm512_permute_ps(v, 0xB1);
+
+   return _mm512_fmaddsub_ps(v, wr, _mm512_mul_ps(vs, wi));
+}
+
+/* passes_avx512 - butterfly passes, 8 butterflies per iteration from half 8 */
+__attribute__((target("avx512f,avx2,fma")))
+static void passes_avx512(complexf* a, int n, const complexf* twiddle)
+{
+   const complexf* w;
+   complexf* top;
+   complexf* bot;
+   __m512 u, t;
+   int half, k, j;
+
+   /* Passes narrower than a 512-bit register */
+   passes_avx2(a, n, twiddle, 8);
+
+   for (half = 8; half < n; half <<= 1)
+   {
+      w = twiddle + (half - 1);
+      for (k = 0; k < n; k += 2*half)
+      {
+         top = a + k;
+         bot = a + k + half;
+         for (j = 0; j < half; j += 8)
+         {
+            u = _mm512_loadu_ps(&top[j].r);
+            t = cmul_avx512(_mm512_loadu_ps(&bot[j].r), _mm512_loadu_ps(&w[j].r));
+            _mm512_storeu_ps(&top[j].r, _mm512_add_ps(u, t));
+            _mm512_storeu_ps(&bot[j].r, _mm512_sub_ps(u, t));
+         }
+      }
+   }
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* fft_float - see common_defs.h for more details */
+int fft_float(complexf* a, int n, int inv)
+{
+   const complexf* twiddle;
+   complexf t;
+   int lg = 0;
+   int j, r, k;
+
+   while (lg < FLOAT_MAX_LG && (1 << lg) < n)
+      lg++;
+   if (n < 1 || (1 << lg) != n)
+      return -1;
+   if (n == 1)
+      return 0;
+
+   twiddle = float_twiddles(lg);
+
+   /* Inverse by conjugation: IDFT(x) = conj(DFT(conj(x))) */
+   if (inv)
+   {
+      for (j = 0; j < n; j++)
+         a[j].i = -a[j].i;
+   }
+
+   /* Bit-reverse permutation (r counts in reverse, "add 1 at the MSB") */
+   r = 0;
+   for (j = 0; j < n; j++)
+   {
+      if (j < r)
+      {
+         t = a[j];
+         a[j] = a[r];
+         a[r] = t;
+      }
+
+      k = n >> 1;
+      while (k && (r & k))
+      {
+         r ^= k;
+         k >>= 1;
+      }
+      r |= k;
+   }
+
+#ifdef HAVE_X86_SIMD
+   switch (fft_simd_level())
+   {
+      case FFT_SIMD_AVX512:
+         passes_avx512(a, n, twiddle);
+         break;
+      case FFT_SIMD_AVX2:
+         passes_avx2(a, n, twiddle, n);
+         break;
+      default:
+         passes_scalar(a, n, twiddle);
+   }
+#else
+   passes_scalar(a, n, twiddle);
+#endif
+
+   if (inv)
+   {
+      for (j = 0; j < n; j++)
+         a[j].i = -a[j].i;
+   }
+
+   return 0;
+}
+
+/* 
+** float_size - transform length for a product of n terms (power of 2,
+** >= 2), 0 if that is longer than fft_float supports
+*/
+static int float_size(int n)
+{
+   int size = 2;
+
+   if (n > (1 << FLOAT_MAX_LG))
+      return 0;
+
+   while (size < n)
+      size <<= 1;
+   return size;
+}
+
+/* poly_mul_float_bound - see common_defs.h for more details */
+double poly_mul_float_bound(const double* a, int na, const double* b, int nb)
+{
+   double sa = 0.0, sb = 0.0;
+   double levels, growth;
+   int size, lg, j;
+
+   /* Integers up to 2^24 are exact in float; anything else has no bound */
+   for (j = 0; j < na; j++)
+   {
+      if (a[j] != rint(a[j]) || fabs(a[j]) > (1 << 24))
+         return HUGE_VAL;
+      sa += a[j] * a[j];
+   }
+   for (j = 0; j < nb; j++)
+   {
+      if (b[j] != rint(b[j]) || fabs(b[j]) > (1 << 24))
+         return HUGE_VAL;
+      sb += b[j] * b[j];
+   }
+
+   size = float_size(na + nb - 1);
+   if (size == 0)
+      return HUGE_VAL;
+   for (lg = 0; (1 << lg) < size; lg++)
+      ;
+
+   /*
+   ** Percival's bound for a convolution through length 2^L FFTs:
+   **
+   **    |error| <= |x| |y| N ((1+e)^3L (1+e*sqrt5)^(3L+1) (1+b)^3L - 1)
+   **
+   ** with e the unit roundoff and b the twiddle error (here also e).
+   ** a and b share one packed transform, so an error in either spectrum
+   ** scales with |a|^2 + |b|^2 instead of |a| |b|, and the spectrum
+   ** separation counts as one more level. The last term is the float
+   ** rounding of the result itself (|c_k| <= |a| |b|).
+   */
+   levels = 3.0 * (lg + 1);
+   growth = expm1(levels * log1p(FLOAT_EPS) +
+                  (levels + 1.0) * log1p(FLOAT_EPS * sqrt(5.0)) +
+                  levels * log1p(FLOAT_EPS));
+
+   return (sa + sb) * size * growth + FLOAT_EPS * sqrt(sa * sb);
+}
+
+/* poly_mul_float - see common_defs.h for more details */
+int poly_mul_float(const double* a, int na, const double* b, int nb,
+                   double* c)
+{
+   fft_probe probe;
+   complexf z, zm;
+   float scale, re, im;
+   int size, j, k;
+
+   size = float_size(na + nb - 1);
+   if (size == 0)
+      return -1;
+
+   fft_probe_begin(&probe);
+
+   if (size > work_size)
+   {
+      fft_free(work);
+      work = (complexf*)fft_malloc(size * sizeof(complexf));
+      work_size = size;
+   }
+
+   /* Pack z = a + i b */
+   for (j = 0; j < size; j++)
+   {
+      work[j].r = (j < na) ? (float)a[j] : 0.0f;
+      work[j].i = (j < nb) ? (float)b[j] : 0.0f;
+   }
+
+   fft_float(work, size, 0);
+
+   /*
+   ** With Z = A + iB and A, B Hermitian, A = (Z[k] + conj Z[-k]) / 2 and
+   ** B = (Z[k] - conj Z[-k]) / 2i, so
+   **
+   **    A B = (Z[k]^2 - (conj Z[-k])^2) / 4i
+   **
+   ** Bins k and size-k are done together so the update is in place. The
+   ** inverse is a forward transform of the conjugate (only the real part
+   ** is kept), so the conjugate is stored here with 1/(4 size) folded in.
+   */
+   scale = 0.25f / size;
+   for (j = 0; j <= size/2; j++)
+   {
+      k = (size - j) & (size - 1);
+      z = work[j];
+      zm.r = work[k].r;
+      zm.i = -work[k].i;
+
+      /* (z^2 - zm^2) / 4i, then conjugated: (im, re) */
+      re = (z.r * z.r - z.i * z.i) - (zm.r * zm.r - zm.i * zm.i);
+      im = 2.0f * (z.r * z.i - zm.r * zm.i);
+      work[j].r = im * scale;
+      work[j].i = re * scale;
+
+      /* Bin k is the conjugate of bin j in the (Hermitian) product */
+      if (k != j)
+      {
+         work[k].r = work[j].r;
+         work[k].i = -work[j].i;
+      }
+   }
+
+   fft_float(work, size, 0);
+
+   for (j = 0; j < (na + nb - 1); j++)
+      c[j] = work[j].r;
+
+   fft_probe_end(&probe, FFT_PHASE_FLOAT, 8.0*(2*(na + nb) - 1));
+   return 0;
+}
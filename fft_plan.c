@@ -0,0 +1,822 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common_defs.h"
+#include "thread_pool.h"
+#include "fft_trace.h"
+
+/* Maximum supported lg(n) for cached plans */
+#define MAX_LG_N  31
+
+/* Threaded execution settings (see fft_execute) */
+#define PARALLEL_MIN   (1<<15)  /* shorter transforms stay serial */
+#define SERIAL_BLOCK   (1<<13)  /* sub-transforms this long run serially */
+#define GRAIN          4096     /* minimum loop chunk per task */
+
+/* 
+** Four-step plans from this length up (FFT_FOUR_STEP_MIN environment
+** variable overrides, 0 turns them off). Below it the radix-2 passes
+** still win: most of their stages run on blocks that fit in cache.
+*/
+#define FOUR_STEP_MIN  (1<<21)
+
+/* Transpose tile edge (two 32x32 tiles of complex fit in L1) */
+#define TILE           32
+
+/* Four-step columns gathered per block (128 bytes of each matrix row) */
+#define COLS           8
+
+/* Rows or columns of a four-step transform */
+typedef struct
+{
+   fft_plan* plan;      /* four-step plan */
+   complex* src;        /* n1 x n2 matrix being transformed */
+   complex* dst;        /* transpose destination (n1 != n2 only) */
+   int rows;            /* n1 */
+   int cols;            /* n2 */
+} four_step_job;
+
+/* Smallest four-step length, -1 until read from the environment */
+static int four_step_min = -1;
+
+/* Sub-transform of a threaded fft_execute */
+typedef struct
+{
+   fft_plan* plan;
+   complex* a;
+   int n;
+} fft_block_job;
+
+/* One butterfly stage split across threads */
+typedef struct
+{
+   complex* top;
+   complex* bot;
+   const complex* w;
+} fft_stage_job;
+
+/* Number of cached mixed radix plans (least recently used is replaced) */
+#define MAX_MIXED_PLANS  64
+
+/* Plans handed out by fft_plan_get, indexed by [inv][lg(n)] */
+static fft_plan* plan_cache[2][MAX_LG_N];
+
+/* Cached mixed radix plans and the lookup count of their last use */
+static fft_plan* mixed_cache[MAX_MIXED_PLANS];
+static unsigned long mixed_used[MAX_MIXED_PLANS];
+static unsigned long mixed_clock = 0;
+
+/* factorize - split n into radices 4, 2, 3, 5; 0 if n has other factors */
+static int factorize(int n, int* factors)
+{
+   int count = 0;
+
+   while (n % 4 == 0)
+   {
+      factors[count++] = 4;
+      n /= 4;
+   }
+   while (n % 2 == 0)
+   {
+      factors[count++] = 2;
+      n /= 2;
+   }
+   while (n % 3 == 0)
+   {
+      factors[count++] = 3;
+      n /= 3;
+   }
+   while (n % 5 == 0)
+   {
+      factors[count++] = 5;
+      n /= 5;
+   }
+
+   return (n == 1) ? count : 0;
+}
+
+/*
+** mixed_plan_create
+**
+** Plan for n = 2^a * 3^b * 5^c (not a power of 2). The transform is a 
+** Stockham autosort FFT: each level does len/p DFTs of size p with 
+** stride s, multiplies by twiddles w_len^(q*j) and writes the result in
+** the order the next level reads it, so no digit reversal is needed.
+** The twiddles for each level are stored [q][j-1], q < len/p, 0 < j < p.
+*/
+static fft_plan* mixed_plan_create(int n, int inv)
+{
+   fft_plan* plan;
+   complex* tw;
+   double theta;
+   int factors[MAX_FACTORS];
+   int count, total, len, p, m, f, q, j;
+
+   count = factorize(n, factors);
+   if (count == 0)
+      return NULL;
+
+   plan = (fft_plan*)fft_malloc(sizeof(fft_plan));
+   memset(plan, 0, sizeof(fft_plan));
+   plan->n = n;
+   plan->inv = inv;
+   plan->lg_n = -1;
+   plan->num_factors = count;
+   memcpy(plan->factors, factors, count * sizeof(int));
+
+   /* Twiddles for all levels */
+   total = 0;
+   for (len = n, f = 0; f < count; len /= factors[f], f++)
+      total += (factors[f] - 1) * (len / factors[f]);
+
+   plan->mixed_tw = (complex*)fft_malloc((total > 0 ? total : 1) * sizeof(complex));
+   tw = plan->mixed_tw;
+   for (len = n, f = 0; f < count; len /= p, f++)
+   {
+      p = factors[f];
+      m = len / p;
+      for (q = 0; q < m; q++)
+      {
+         for (j = 1; j < p; j++)
+         {
+            theta = 2*PI*(double)(((long long)q * j) % len)/(double)len;
+            tw->r = cos(theta);
+            tw->i = inv ? -sin(theta) : sin(theta);
+            tw++;
+         }
+      }
+   }
+
+   plan->work = (complex*)fft_malloc(n * sizeof(complex));
+
+   return plan;
+}
+
+/* Constants for the radix 3 and 5 DFTs */
+#define SIN_60    0.86602540378443864676
+#define COS_72    0.30901699437494742410
+#define SIN_72    0.95105651629515357212
+#define COS_144  -0.80901699437494742410
+#define SIN_144   0.58778525229247312917
+
+/* cmul - complex multiply (local so the mixed radix loops inline it) */
+static complex cmul(complex a, complex b)
+{
+   complex ans;
+
+   ans.r = a.r*b.r - a.i*b.i;
+   ans.i = a.r*b.i + a.i*b.r;
+
+   return ans;
+}
+
+/* sum_i_times - compute a + i*sign*b and a - i*sign*b */
+static void sum_i_times(complex a, complex b, double sign, 
+                        complex* plus, complex* minus)
+{
+   plus->r  = a.r - sign*b.i;
+   plus->i  = a.i + sign*b.r;
+   minus->r = a.r + sign*b.i;
+   minus->i = a.i - sign*b.r;
+}
+
+/*
+** small_dft
+**
+** DFT of size p = 2, 3, 4 or 5 with w_p = exp(sign*2*PI*i/p). Pairs of
+** outputs j and p-j share their real parts, so radix 3 and 5 only need
+** the sums and differences of v[k] and v[p-k].
+*/
+static void small_dft(const complex* v, complex* b, int p, double sign)
+{
+   complex s1, s2, d1, d2, e1, e2, o1, o2;
+
+   switch (p)
+   {
+      case 2:
+         b[0].r = v[0].r + v[1].r;  b[0].i = v[0].i + v[1].i;
+         b[1].r = v[0].r - v[1].r;  b[1].i = v[0].i - v[1].i;
+         break;
+
+      case 3:
+         s1.r = v[1].r + v[2].r;  s1.i = v[1].i + v[2].i;
+         d1.r = SIN_60*(v[1].r - v[2].r);  d1.i = SIN_60*(v[1].i - v[2].i);
+         e1.r = v[0].r - 0.5*s1.r;  e1.i = v[0].i - 0.5*s1.i;
+         b[0].r = v[0].r + s1.r;  b[0].i = v[0].i + s1.i;
+         sum_i_times(e1, d1, sign, &b[1], &b[2]);
+         break;
+
+      case 4:
+         s1.r = v[0].r + v[2].r;  s1.i = v[0].i + v[2].i;
+         d1.r = v[0].r - v[2].r;  d1.i = v[0].i - v[2].i;
+         s2.r = v[1].r + v[3].r;  s2.i = v[1].i + v[3].i;
+         d2.r = v[1].r - v[3].r;  d2.i = v[1].i - v[3].i;
+         b[0].r = s1.r + s2.r;  b[0].i = s1.i + s2.i;
+         b[2].r = s1.r - s2.r;  b[2].i = s1.i - s2.i;
+         sum_i_times(d1, d2, sign, &b[1], &b[3]);
+         break;
+
+      case 5:
+         s1.r = v[1].r + v[4].r;  s1.i = v[1].i + v[4].i;
+         s2.r = v[2].r + v[3].r;  s2.i = v[2].i + v[3].i;
+         d1.r = v[1].r - v[4].r;  d1.i = v[1].i - v[4].i;
+         d2.r = v[2].r - v[3].r;  d2.i = v[2].i - v[3].i;
+         b[0].r = v[0].r + s1.r + s2.r;  b[0].i = v[0].i + s1.i + s2.i;
+
+         e1.r = v[0].r + COS_72*s1.r + COS_144*s2.r;
+         e1.i = v[0].i + COS_72*s1.i + COS_144*s2.i;
+         o1.r = SIN_72*d1.r + SIN_144*d2.r;
+         o1.i = SIN_72*d1.i + SIN_144*d2.i;
+         sum_i_times(e1, o1, sign, &b[1], &b[4]);
+
+         e2.r = v[0].r + COS_144*s1.r + COS_72*s2.r;
+         e2.i = v[0].i + COS_144*s1.i + COS_72*s2.i;
+         o2.r = SIN_144*d1.r - SIN_72*d2.r;
+         o2.i = SIN_144*d1.i - SIN_72*d2.i;
+         sum_i_times(e2, o2, sign, &b[2], &b[3]);
+         break;
+   }
+}
+
+/* mixed_execute - Stockham mixed radix transform (see mixed_plan_create) */
+static void mixed_execute(fft_plan* plan, complex* a)
+{
+   const complex* tw = plan->mixed_tw;
+   const complex* w;
+   complex* x = a;
+   complex* y = plan->work;
+   complex* t;
+   complex v[5], b[5];
+   double sign = plan->inv ? -1.0 : 1.0;
+   int len = plan->n, s = 1;
+   int f, p, m, q, r, j, k;
+
+   for (f = 0; f < plan->num_factors; f++)
+   {
+      p = plan->factors[f];
+      m = len / p;
+
+      /* x[r + s*(q + m*k)] -> y[r + s*(p*q + j)] */
+      for (q = 0; q < m; q++)
+      {
+         w = tw + q*(p-1);
+         for (r = 0; r < s; r++)
+         {
+            for (k = 0; k < p; k++)
+               v[k] = x[r + s*(q + m*k)];
+
+            small_dft(v, b, p, sign);
+
+            y[r + s*p*q] = b[0];
+            if (q == 0)
+            {
+               for (j = 1; j < p; j++)
+                  y[r + s*j] = b[j];
+            }
+            else
+            {
+               for (j = 1; j < p; j++)
+                  y[r + s*(p*q + j)] = cmul(b[j], w[j-1]);
+            }
+         }
+      }
+
+      tw += (p-1)*m;
+      t = x;
+      x = y;
+      y = t;
+      len = m;
+      s *= p;
+   }
+
+   if (x != a)
+      memcpy(a, x, plan->n * sizeof(complex));
+}
+
+/* use_four_step - 1 if a power of 2 length n gets a four-step plan */
+static int use_four_step(int n)
+{
+   char* env;
+
+   if (four_step_min < 0)
+   {
+      four_step_min = FOUR_STEP_MIN;
+      env = getenv("FFT_FOUR_STEP_MIN");
+      if (env)
+         four_step_min = atoi(env);
+   }
+
+   /* Each side needs at least one transpose tile */
+   return four_step_min > 0 && n >= four_step_min && n >= TILE * TILE;
+}
+
+/* radix2_plan_create - bit-reversal and per-stage twiddles for n = 2^lg_n */
+static fft_plan* radix2_plan_create(int n, int lg_n, int inv)
+{
+   fft_plan* plan;
+   complex* top;
+   double theta;
+   int i, j, k, m;
+
+   plan = (fft_plan*)fft_malloc(sizeof(fft_plan));
+   memset(plan, 0, sizeof(fft_plan));
+   plan->n = n;
+   plan->inv = inv;
+   plan->lg_n = lg_n;
+
+   plan->rev = (int*)fft_malloc(n * sizeof(int));
+   plan->twiddle = (complex*)fft_malloc((n > 1 ? n-1 : 1) * sizeof(complex));
+
+   /* Bit-reversal indices (same "add 1 at the MSB" counter as bit_reverse_copy) */
+   j = 0;
+   for (i = 0; i < n; i++)
+   {
+      plan->rev[i] = j;
+
+      k = n >> 1;
+      while (k && (j & k))
+      {
+         j ^= k;
+         k >>= 1;
+      }
+      j |= k;
+   }
+
+   if (n == 1)
+      return plan;
+
+   /* 
+   ** Largest stage (m = n) gets w^j = exp(+/-2*PI*i*j/n) straight from
+   ** cos/sin, so there is no error build up from a running product 
+   */
+   top = plan->twiddle + (n/2 - 1);
+   for (j = 0; j < (n/2); j++)
+   {
+      theta = 2*PI*(double)j/(double)n;
+      top[j].r = cos(theta);
+      top[j].i = inv ? -sin(theta) : sin(theta);
+   }
+
+   /* Smaller stages subsample the largest one: w_m^j = w_n^(j*n/m) */
+   for (m = 2; m < n; m <<= 1)
+   {
+      for (j = 0; j < (m/2); j++)
+         plan->twiddle[m/2 - 1 + j] = top[j * (n/m)];
+   }
+
+   return plan;
+}
+
+/*
+** four_step_plan_create
+**
+** Four-step (Bailey) plan for n = 2^lg_n = n1 * n2, n1 = 2^(lg_n/2).
+** Only sqrt(n) sized tables are kept: the sub-plans, and the twiddle
+** w_n^e for e < n split as w_n^(h*2^lo_bits) * w_n^l. The full twiddle
+** and bit-reversal tables are never built.
+** The sub-plans are always radix-2, so they own no buffer and threads
+** can share them.
+*/
+static fft_plan* four_step_plan_create(int n, int lg_n, int inv)
+{
+   fft_plan* plan;
+   double theta;
+   int n1, hi, lo, j;
+
+   n1 = 1 << (lg_n / 2);
+
+   plan = (fft_plan*)fft_malloc(sizeof(fft_plan));
+   memset(plan, 0, sizeof(fft_plan));
+   plan->n = n;
+   plan->lg_n = lg_n;
+   plan->inv = inv;
+   plan->rows = radix2_plan_create(n1, lg_n / 2, inv);
+   plan->cols = radix2_plan_create(n / n1, lg_n - lg_n / 2, inv);
+
+   plan->lo_bits = (lg_n + 1) / 2;
+   lo = 1 << plan->lo_bits;
+   hi = n >> plan->lo_bits;
+   plan->tw_lo = (complex*)fft_malloc(lo * sizeof(complex));
+   plan->tw_hi = (complex*)fft_malloc(hi * sizeof(complex));
+   for (j = 0; j < lo; j++)
+   {
+      theta = 2*PI*(double)j/(double)n;
+      plan->tw_lo[j].r = cos(theta);
+      plan->tw_lo[j].i = inv ? -sin(theta) : sin(theta);
+   }
+   for (j = 0; j < hi; j++)
+   {
+      theta = 2*PI*(double)j/(double)hi;
+      plan->tw_hi[j].r = cos(theta);
+      plan->tw_hi[j].i = inv ? -sin(theta) : sin(theta);
+   }
+
+   plan->work = (complex*)fft_malloc(n * sizeof(complex));
+
+   return plan;
+}
+
+/* fft_plan_create - see common_defs.h for more details */
+fft_plan* fft_plan_create(int n, int inv)
+{
+   int m;
+
+   if (n < 1)
+      return NULL;
+
+   /* Other 5-smooth sizes use the mixed radix transform */
+   if (n & (n-1))
+      return mixed_plan_create(n, inv);
+
+   m = 0;
+   while ((1 << m) < n)
+      m++;
+
+   /* Large powers of 2 are done as a matrix of cache-sized transforms */
+   if (use_four_step(n))
+      return four_step_plan_create(n, m, inv);
+
+   return radix2_plan_create(n, m, inv);
+}
+
+/* fft_plan_destroy - see common_defs.h for more details */
+void fft_plan_destroy(fft_plan* plan)
+{
+   if (!plan)
+      return;
+
+   fft_plan_destroy(plan->rows);
+   fft_plan_destroy(plan->cols);
+   fft_free(plan->tw_hi);
+   fft_free(plan->tw_lo);
+   fft_free(plan->rev);
+   fft_free(plan->twiddle);
+   fft_free(plan->mixed_tw);
+   fft_free(plan->work);
+   fft_arena_free(&plan->arena);
+   fft_free(plan);
+}
+
+/* bit_reverse_range - swap a[i] and a[rev[i]] for i in [begin, end) */
+static void bit_reverse_range(void* arg, int begin, int end)
+{
+   fft_block_job* job = (fft_block_job*)arg;
+   complex* a = job->a;
+   complex t;
+   int i, j;
+
+   for (i = begin; i < end; i++)
+   {
+      j = job->plan->rev[i];
+      if (i < j)
+      {
+         t = a[i];
+         a[i] = a[j];
+         a[j] = t;
+      }
+   }
+}
+
+/* stage_range - butterflies [begin, end) of a single block stage */
+static void stage_range(void* arg, int begin, int end)
+{
+   fft_stage_job* job = (fft_stage_job*)arg;
+
+   fft_butterflies(job->top + begin, job->bot + begin, job->w + begin, 
+                   end - begin);
+}
+
+/*
+** fft_block
+**
+** Butterfly stages for one bit-reversed block of length n. After the 
+** permutation, the first lg(n) stages of each block only touch that 
+** block, so this is the same split as the recursive FFT: the two halves
+** are independent subtrees (one is handed to the pool), and the last
+** stage combines them with its butterflies divided between threads.
+*/
+static void fft_block(void* arg)
+{
+   fft_block_job* job = (fft_block_job*)arg;
+   fft_block_job lo, hi;
+   fft_stage_job stage;
+   tp_task task;
+   int half;
+
+   FFT_TRACE_ENTER_N(job->n, job->plan->inv);
+
+   if (job->n <= SERIAL_BLOCK)
+   {
+      for (half = 1; half < job->n; half <<= 1)
+         fft_butterfly_pass(job->a, job->n, half, job->plan->twiddle + (half - 1));
+      FFT_TRACE_EXIT_N(job->n, job->plan->inv);
+      return;
+   }
+
+   half = job->n/2;
+   lo.plan = job->plan; lo.a = job->a;        lo.n = half;
+   hi.plan = job->plan; hi.a = job->a + half; hi.n = half;
+
+   tp_spawn(&task, fft_block, &hi);
+   fft_block(&lo);
+   tp_wait(&task);
+
+   stage.top = job->a;
+   stage.bot = job->a + half;
+   stage.w = job->plan->twiddle + (half - 1);
+   tp_parallel_for(half, GRAIN, stage_range, &stage);
+
+   FFT_TRACE_EXIT_N(job->n, job->plan->inv);
+}
+
+/* transpose_range - tile rows [begin, end) of dst = transpose(src) */
+static void transpose_range(void* arg, int begin, int end)
+{
+   four_step_job* job = (four_step_job*)arg;
+   const complex* src = job->src;
+   complex* dst = job->dst;
+   int rows = job->rows, cols = job->cols;
+   int r0, c0, r, c;
+
+   for (r0 = begin * TILE; r0 < end * TILE; r0 += TILE)
+   {
+      for (c0 = 0; c0 < cols; c0 += TILE)
+      {
+         for (r = r0; r < r0 + TILE; r++)
+         {
+            for (c = c0; c < c0 + TILE; c++)
+               dst[(size_t)c * rows + r] = src[(size_t)r * cols + c];
+         }
+      }
+   }
+}
+
+/* square_range - in-place transpose, tile rows [begin, end) of src */
+static void square_range(void* arg, int begin, int end)
+{
+   four_step_job* job = (four_step_job*)arg;
+   complex* a = job->src;
+   int n = job->cols;
+   complex t;
+   int r0, c0, r, c;
+
+   for (r0 = begin * TILE; r0 < end * TILE; r0 += TILE)
+   {
+      /* Swap tile (r0, c0) with tile (c0, r0), diagonal tile with itself */
+      for (c0 = r0; c0 < n; c0 += TILE)
+      {
+         for (r = r0; r < r0 + TILE; r++)
+         {
+            for (c = (c0 == r0) ? r + 1 : c0; c < c0 + TILE; c++)
+            {
+               t = a[(size_t)r * n + c];
+               a[(size_t)r * n + c] = a[(size_t)c * n + r];
+               a[(size_t)c * n + r] = t;
+            }
+         }
+      }
+   }
+}
+
+/*
+** columns_range
+**
+** Columns [begin*COLS, end*COLS) of the n1 x n2 matrix: COLS columns at
+** a time are gathered into contiguous rows of plan->work (each column 
+** has its own slot, so threads never share one), transformed (length 
+** n1), multiplied by w_n^(j2*k1) and scattered back. Reading COLS 
+** neighbours per matrix row keeps whole cache lines in use. The 
+** exponent e = j2*k1 < n is split into w_n^(h*2^lo_bits) * w_n^l, so 
+** both twiddle tables are about sqrt(n) long.
+*/
+static void columns_range(void* arg, int begin, int end)
+{
+   four_step_job* job = (four_step_job*)arg;
+   fft_plan* plan = job->plan;
+   complex* a = job->src;
+   int n1 = job->rows, n2 = job->cols;
+   int mask = (1 << plan->lo_bits) - 1;
+   complex* col;
+   complex w;
+   int c0, j1, j2, k1, e;
+
+   for (c0 = begin * COLS; c0 < end * COLS; c0 += COLS)
+   {
+      col = plan->work + (size_t)c0 * n1;
+      for (j1 = 0; j1 < n1; j1++)
+      {
+         for (j2 = 0; j2 < COLS; j2++)
+            col[(size_t)j2 * n1 + j1] = a[(size_t)j1 * n2 + c0 + j2];
+      }
+
+      for (j2 = 0; j2 < COLS; j2++)
+      {
+         fft_execute(plan->rows, col + (size_t)j2 * n1);
+
+         for (k1 = 1, e = c0 + j2; k1 < n1; k1++, e += c0 + j2)
+         {
+            w = cmul(plan->tw_hi[e >> plan->lo_bits], plan->tw_lo[e & mask]);
+            col[(size_t)j2 * n1 + k1] = cmul(col[(size_t)j2 * n1 + k1], w);
+         }
+      }
+
+      for (j1 = 0; j1 < n1; j1++)
+      {
+         for (j2 = 0; j2 < COLS; j2++)
+            a[(size_t)j1 * n2 + c0 + j2] = col[(size_t)j2 * n1 + j1];
+      }
+   }
+}
+
+/* rows_range - length n2 transforms of rows [begin, end) */
+static void rows_range(void* arg, int begin, int end)
+{
+   four_step_job* job = (four_step_job*)arg;
+   int j;
+
+   for (j = begin; j < end; j++)
+      fft_execute(job->plan->cols, job->src + (size_t)j * job->cols);
+}
+
+/*
+** four_step_execute
+**
+** With x[j1*n2 + j2] viewed as an n1 x n2 matrix:
+**
+**    1. n2 column transforms of length n1, times w_n^(j2*k1)
+**    2. n1 row transforms of length n2 (in place)
+**    3. transpose: X[k1 + n1*k2] is at k1*n2 + k2, moves to k2*n1 + k1
+**
+** Every transform fits in cache, and the only whole-array passes besides
+** them are the column gathers and one tiled transpose (in place when 
+** n1 = n2), so the cost stays close to n log n for huge n. Columns and
+** rows are spread over the thread pool.
+*/
+static void four_step_execute(fft_plan* plan, complex* a)
+{
+   four_step_job job;
+   int n1 = plan->rows->n;
+   int n2 = plan->cols->n;
+
+   job.plan = plan;
+   job.src = a;
+   job.dst = plan->work;
+   job.rows = n1;
+   job.cols = n2;
+
+   tp_parallel_for(n2 / COLS, (GRAIN / (COLS * n1) > 0) ? 
+                   GRAIN / (COLS * n1) : 1, columns_range, &job);
+   tp_parallel_for(n1, (GRAIN / n2 > 0) ? GRAIN / n2 : 1, rows_range, &job);
+
+   if (n1 == n2)
+      tp_parallel_for(n1 / TILE, 1, square_range, &job);
+   else
+   {
+      tp_parallel_for(n1 / TILE, 1, transpose_range, &job);
+      memcpy(a, plan->work, (size_t)plan->n * sizeof(complex));
+   }
+}
+
+/* fft_execute - see common_defs.h for more details */
+void fft_execute(fft_plan* plan, complex* a)
+{
+   fft_block_job job;
+   int half;
+
+   if (plan->num_factors > 0)
+   {
+      mixed_execute(plan, a);
+      return;
+   }
+
+   if (plan->rows)
+   {
+      /* Make sure the SIMD level is picked before any thread asks for it */
+      fft_simd_level();
+      four_step_execute(plan, a);
+      return;
+   }
+
+   job.plan = plan;
+   job.a = a;
+   job.n = plan->n;
+
+   /* Large transforms are spread over the thread pool */
+   if (plan->n >= PARALLEL_MIN && tp_num_threads() > 1)
+   {
+      /* Make sure the SIMD level is picked before any thread asks for it */
+      fft_simd_level();
+
+      tp_parallel_for(plan->n, GRAIN, bit_reverse_range, &job);
+      fft_block(&job);
+      return;
+   }
+
+   /* Bit-reverse permutation from the precomputed indices */
+   bit_reverse_range(&job, 0, plan->n);
+
+   /* lg(n) butterfly passes using the per-stage twiddle tables */
+   for (half = 1; half < plan->n; half <<= 1)
+      fft_butterfly_pass(a, plan->n, half, plan->twiddle + (half - 1));
+}
+
+/* fft_plan_get - see common_defs.h for more details */
+fft_plan* fft_plan_get(int n, int inv)
+{
+   int lg_n = 0;
+   int i;
+   int oldest;
+   fft_plan* plan;
+
+   if (n < 1)
+      return NULL;
+
+   while (lg_n < MAX_LG_N && (1 << lg_n) < n)
+      lg_n++;
+
+   /*
+   ** Mixed radix sizes live in a small LRU cache. A hit refreshes the
+   ** plan, so the plan a caller fetched just before (the forward plan
+   ** of a fwd/inv pair) is never the one a miss replaces.
+   */
+   if (lg_n >= MAX_LG_N || (1 << lg_n) != n)
+   {
+      mixed_clock++;
+      oldest = 0;
+      for (i = 0; i < MAX_MIXED_PLANS; i++)
+      {
+         if (mixed_cache[i] && mixed_cache[i]->n == n && 
+             mixed_cache[i]->inv == (inv ? 1 : 0))
+         {
+            mixed_used[i] = mixed_clock;
+            return mixed_cache[i];
+         }
+         if (mixed_used[i] < mixed_used[oldest])
+            oldest = i;
+      }
+
+      /* Unsupported lengths fail without evicting a plan */
+      plan = fft_plan_create(n, inv ? 1 : 0);
+      if (!plan)
+         return NULL;
+
+      fft_plan_destroy(mixed_cache[oldest]);
+      mixed_cache[oldest] = plan;
+      mixed_used[oldest] = mixed_clock;
+      return plan;
+   }
+
+   inv = inv ? 1 : 0;
+   if (!plan_cache[inv][lg_n])
+      plan_cache[inv][lg_n] = fft_plan_create(n, inv);
+
+   return plan_cache[inv][lg_n];
+}
+
+/* fft_plan_cache_clear - see common_defs.h for more details */
+void fft_plan_cache_clear(void)
+{
+   int inv, lg_n, i;
+
+   for (i = 0; i < MAX_MIXED_PLANS; i++)
+   {
+      fft_plan_destroy(mixed_cache[i]);
+      mixed_cache[i] = NULL;
+      mixed_used[i] = 0;
+   }
+   mixed_clock = 0;
+
+   for (inv = 0; inv < 2; inv++)
+   {
+      for (lg_n = 0; lg_n < MAX_LG_N; lg_n++)
+      {
+         fft_plan_destroy(plan_cache[inv][lg_n]);
+         plan_cache[inv][lg_n] = NULL;
+      }
+   }
+}
+
+/* fft_good_size - see common_defs.h for more details */
+int fft_good_size(int n)
+{
+   long long best, p35, p5, m;
+
+   /* A power of 2 always works; look for a smaller 2^a * 3^b * 5^c */
+   best = 1;
+   while (best < n)
+      best <<= 1;
+
+   for (p5 = 1; p5 < best; p5 *= 5)
+   {
+      for (p35 = p5; p35 < best; p35 *= 3)
+      {
+         m = p35;
+         while (m < n)
+            m <<= 1;
+         if (m < best)
+            best = m;
+      }
+   }
+
+   return (int)best;
+}
@@ -0,0 +1,299 @@
+#include <stdlib.h>
+#include <string.h>
+#include "common_defs.h"
+
+/*
+** Vectorized butterfly and pointwise multiply kernels.
+**
+** complex is laid out as {r, i} pairs, so a 256-bit register holds two
+** complex numbers and a 512-bit register holds four. Complex products
+** are done on the interleaved data with shuffles:
+**
+**    (vr, vi) * (wr, wi) = fmaddsub((vr, vi), (wr, wr), (vi, vr)*(wi, wi))
+**
+** The ISA specific kernels are compiled with target attributes, so the
+** rest of the build doesn't need -mavx2. The kernel used is picked once
+** at run time from what the CPU supports (see fft_simd_level).
+*/
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* Selected SIMD level, -1 until the first kernel call */
+static int simd_level = -1;
+
+/* butterflies_scalar - portable butterflies on top[j], bot[j] */
+static void butterflies_scalar(complex* top, complex* bot, const complex* w,
+                               int count)
+{
+   complex t, u, v;
+   int j;
+
+   for (j = 0; j < count; j++)
+   {
+      v = bot[j];
+      t.r = w[j].r * v.r - w[j].i * v.i;
+      t.i = w[j].r * v.i + w[j].i * v.r;
+      u = top[j];
+      top[j].r = u.r + t.r;
+      top[j].i = u.i + t.i;
+      bot[j].r = u.r - t.r;
+      bot[j].i = u.i - t.i;
+   }
+}
+
+/* butterfly_pass_scalar - portable butterfly pass */
+static void butterfly_pass_scalar(complex* a, int n, int half, 
+                                  const complex* w)
+{
+   int k;
+
+   for (k = 0; k < n; k += 2*half)
+      butterflies_scalar(a + k, a + k + half, w, half);
+}
+
+/* complex_mul_array_scalar - portable pointwise multiply */
+static void complex_mul_array_scalar(complex* a, const complex* b, int n)
+{
+   complex t;
+   int j;
+
+   for (j = 0; j < n; j++)
+   {
+      t.r = a[j].r * b[j].r - a[j].i * b[j].i;
+      t.i = a[j].r * b[j].i + a[j].i * b[j].r;
+      a[j] = t;
+   }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* cmul_avx2 - two complex products per register */
+__attribute__((target("avx2,fma")))
+static inline __m256d cmul_avx2(__m256d v, __m256d w)
+{
+   __m256d wr = _mm256_movedup_pd(w);
+   __m256d wi = _mm256_permute_pd(w, 0xF);
+   __m256d vs = _mm256_permute_pd(v, 0x5);
+
+   return _mm256_fmaddsub_pd(v, wr, _mm256_mul_pd(vs, wi));
+}
+
+/* butterflies_avx2 - 2 butterflies per iteration */
+__attribute__((target("avx2,fma")))
+static void butterflies_avx2(complex* top, complex* bot, const complex* w,
+                             int count)
+{
+   __m256d u, v, t;
+   int j;
+
+   for (j = 0; j + 2 <= count; j += 2)
+   {
+      u = _mm256_loadu_pd(&top[j].r);
+      v = _mm256_loadu_pd(&bot[j].r);
+      t = cmul_avx2(v, _mm256_loadu_pd(&w[j].r));
+      _mm256_storeu_pd(&top[j].r, _mm256_add_pd(u, t));
+      _mm256_storeu_pd(&bot[j].r, _mm256_sub_pd(u, t));
+   }
+
+   if (j < count)
+      butterflies_scalar(top + j, bot + j, w + j, count - j);
+}
+
+/* butterfly_pass_avx2 - butterfly pass, 2 butterflies per iteration */
+__attribute__((target("avx2,fma")))
+static void butterfly_pass_avx2(complex* a, int n, int half, 
+                                const complex* w)
+{
+   int k;
+
+   /* Need at least two butterflies sharing a block */
+   if (half < 2)
+   {
+      butterfly_pass_scalar(a, n, half, w);
+      return;
+   }
+
+   for (k = 0; k < n; k += 2*half)
+      butterflies_avx2(a + k, a + k + half, w, half);
+}
+
+/* complex_mul_array_avx2 - pointwise multiply, 2 products per iteration */
+__attribute__((target("avx2,fma")))
+static void complex_mul_array_avx2(complex* a, const complex* b, int n)
+{
+   int j;
+
+   for (j = 0; j + 2 <= n; j += 2)
+   {
+      _mm256_storeu_pd(&a[j].r, cmul_avx2(_mm256_loadu_pd(&a[j].r), 
+                                          _mm256_loadu_pd(&b[j].r)));
+   }
+
+   if (j < n)
+      complex_mul_array_scalar(a + j, b + j, n - j);
+}
+
+/* cmul_avx512 - four complex products per register */
+__attribute__((target("avx512f")))
+static inline __m512d cmul_avx512(__m512d v, __m512d w)
+{
+   __m512d wr = _mm512_movedup_pd(w);
+   __m512d wi = _mm512_permute_pd(w, 0xFF);
+   __m512d vs = _mm512_permute_pd(v, 0x55);
+
+   return _mm512_fmaddsub_pd(v, wr, _mm512_mul_pd(vs, wi));
+}
+
+/* butterflies_avx512 - 4 butterflies per iteration */
+__attribute__((target("avx512f,avx2,fma")))
+static void butterflies_avx512(complex* top, complex* bot, const complex* w,
+                               int count)
+{
+   __m512d u, v, t;
+   int j;
+
+   for (j = 0; j + 4 <= count; j += 4)
+   {
+      u = _mm512_loadu_pd(&top[j].r);
+      v = _mm512_loadu_pd(&bot[j].r);
+      t = cmul_avx512(v, _mm512_loadu_pd(&w[j].r));
+      _mm512_storeu_pd(&top[j].r, _mm512_add_pd(u, t));
+      _mm512_storeu_pd(&bot[j].r, _mm512_sub_pd(u, t));
+   }
+
+   if (j < count)
+      butterflies_avx2(top + j, bot + j, w + j, count - j);
+}
+
+/* butterfly_pass_avx512 - butterfly pass, 4 butterflies per iteration */
+__attribute__((target("avx512f,avx2,fma")))
+static void butterfly_pass_avx512(complex* a, int n, int half, 
+                                  const complex* w)
+{
+   int k;
+
+   /* Small stages don't fill a 512-bit register */
+   if (half < 4)
+   {
+      butterfly_pass_avx2(a, n, half, w);
+      return;
+   }
+
+   for (k = 0; k < n; k += 2*half)
+      butterflies_avx512(a + k, a + k + half, w, half);
+}
+
+/* complex_mul_array_avx512 - pointwise multiply, 4 products per iteration */
+__attribute__((target("avx512f,avx2,fma")))
+static void complex_mul_array_avx512(complex* a, const complex* b, int n)
+{
+   int j;
+
+   for (j = 0; j + 4 <= n; j += 4)
+   {
+      _mm512_storeu_pd(&a[j].r, cmul_avx512(_mm512_loadu_pd(&a[j].r), 
+                                            _mm512_loadu_pd(&b[j].r)));
+   }
+
+   if (j < n)
+      complex_mul_array_avx2(a + j, b + j, n - j);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* cpu_simd_level - best level supported by this CPU */
+static int cpu_simd_level(void)
+{
+#ifdef HAVE_X86_SIMD
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx512f"))
+      return FFT_SIMD_AVX512;
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return FFT_SIMD_AVX2;
+#endif
+   return FFT_SIMD_SCALAR;
+}
+
+/* fft_simd_level - see common_defs.h for more details */
+int fft_simd_level(void)
+{
+   char* env;
+
+   if (simd_level < 0)
+   {
+      simd_level = cpu_simd_level();
+
+      /* FFT_SIMD environment variable can lower the level */
+      env = getenv("FFT_SIMD");
+      if (env && strcmp(env, "scalar") == 0)
+         fft_simd_set_level(FFT_SIMD_SCALAR);
+      else if (env && strcmp(env, "avx2") == 0)
+         fft_simd_set_level(FFT_SIMD_AVX2);
+   }
+
+   return simd_level;
+}
+
+/* fft_simd_set_level - see common_defs.h for more details */
+void fft_simd_set_level(int level)
+{
+   int max_level = cpu_simd_level();
+
+   simd_level = (level < max_level) ? level : max_level;
+   if (simd_level < FFT_SIMD_SCALAR)
+      simd_level = FFT_SIMD_SCALAR;
+}
+
+/* fft_butterfly_pass - see common_defs.h for more details */
+void fft_butterfly_pass(complex* a, int n, int half, const complex* w)
+{
+#ifdef HAVE_X86_SIMD
+   switch (fft_simd_level())
+   {
+      case FFT_SIMD_AVX512:
+         butterfly_pass_avx512(a, n, half, w);
+         return;
+      case FFT_SIMD_AVX2:
+         butterfly_pass_avx2(a, n, half, w);
+         return;
+   }
+#endif
+   butterfly_pass_scalar(a, n, half, w);
+}
+
+/* fft_butterflies - see common_defs.h for more details */
+void fft_butterflies(complex* top, complex* bot, const complex* w, int count)
+{
+#ifdef HAVE_X86_SIMD
+   switch (fft_simd_level())
+   {
+      case FFT_SIMD_AVX512:
+         butterflies_avx512(top, bot, w, count);
+         return;
+      case FFT_SIMD_AVX2:
+         butterflies_avx2(top, bot, w, count);
+         return;
+   }
+#endif
+   butterflies_scalar(top, bot, w, count);
+}
+
+/* complex_mul_array - see common_defs.h for more details */
+void complex_mul_array(complex* a, const complex* b, int n)
+{
+#ifdef HAVE_X86_SIMD
+   switch (fft_simd_level())
+   {
+      case FFT_SIMD_AVX512:
+         complex_mul_array_avx512(a, b, n);
+         return;
+      case FFT_SIMD_AVX2:
+         complex_mul_array_avx2(a, b, n);
+         return;
+   }
+#endif
+   complex_mul_array_scalar(a, b, n);
+}
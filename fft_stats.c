@@ -0,0 +1,277 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "fft_stats.h"
+
+/*
+** Each thread opens its own perf event group (cycles leading the
+** others) on its first probe, counting user space only so the default
+** perf_event_paranoid setting allows it. A probe reads the whole group
+** with one read() at begin and end.
+*/
+
+/* Group read layout (PERF_FORMAT_GROUP without ids) */
+typedef struct
+{
+   unsigned long long nr;
+   unsigned long long values[FFT_NUM_HW];
+} hw_group;
+
+int fft_stats_enabled = 0;
+
+static fft_phase_stats totals[FFT_NUM_PHASES];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* phase_names[FFT_NUM_PHASES] =
+{
+   "forward", "pointwise", "inverse", "scale", "alloc", "schoolbook",
+   "karatsuba", "float", "spectrum", "ntt"
+};
+
+/* Per thread group: leader fd (-1 if none), fd and slot of each counter */
+static __thread int hw_opened = 0;
+static __thread int hw_leader = -1;
+static __thread int hw_fd[FFT_NUM_HW];
+static __thread int hw_slot[FFT_NUM_HW];
+
+/* Thread exit hook that closes the group (see close_group) */
+static pthread_key_t hw_key;
+static pthread_once_t hw_key_once = PTHREAD_ONCE_INIT;
+
+/* now_sec - monotonic wall clock in seconds */
+static double now_sec(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* open_event - one counter of the calling thread, -1 if not allowed */
+static int open_event(unsigned int type, unsigned long long config, int group)
+{
+   struct perf_event_attr attr;
+
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = type;
+   attr.config = config;
+   attr.disabled = (group < 0);
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   attr.read_format = PERF_FORMAT_GROUP;
+
+   return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+/* close_group - close the counters of the exiting thread */
+static void close_group(void* unused)
+{
+   int k;
+
+   (void)unused;
+   for (k = 0; k < FFT_NUM_HW; k++)
+   {
+      if (hw_fd[k] >= 0)
+         close(hw_fd[k]);
+      hw_fd[k] = -1;
+   }
+   hw_leader = -1;
+}
+
+/* make_key - thread exit hook of the counter groups (pthread_once) */
+static void make_key(void)
+{
+   pthread_key_create(&hw_key, close_group);
+}
+
+/* open_group - counter group of the calling thread (first probe only) */
+static void open_group(void)
+{
+   static const unsigned int types[FFT_NUM_HW] =
+   {
+      PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+      PERF_TYPE_HW_CACHE
+   };
+   static const unsigned long long configs[FFT_NUM_HW] =
+   {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+   };
+   int count = 0;
+   int k;
+
+   hw_opened = 1;
+   for (k = 0; k < FFT_NUM_HW; k++)
+   {
+      hw_slot[k] = -1;
+      hw_fd[k] = open_event(types[k], configs[k], hw_leader);
+      if (hw_fd[k] < 0)
+         continue;
+
+      if (hw_leader < 0)
+         hw_leader = hw_fd[k];
+      hw_slot[k] = count++;
+   }
+
+   if (hw_leader >= 0)
+   {
+      /* Any non-NULL value makes the key run close_group at thread exit */
+      pthread_once(&hw_key_once, make_key);
+      pthread_setspecific(hw_key, &hw_leader);
+
+      ioctl(hw_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(hw_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+   }
+}
+
+/* read_hw - current counter values, -1 for unavailable ones */
+static void read_hw(long long* hw)
+{
+   hw_group g;
+   int k;
+
+   if (!hw_opened)
+      open_group();
+
+   memset(&g, 0, sizeof(g));
+   if (hw_leader >= 0 && read(hw_leader, &g, sizeof(g)) <= 0)
+      g.nr = 0;
+
+   for (k = 0; k < FFT_NUM_HW; k++)
+   {
+      if (hw_slot[k] >= 0 && (unsigned long long)hw_slot[k] < g.nr)
+         hw[k] = (long long)g.values[hw_slot[k]];
+      else
+         hw[k] = -1;
+   }
+}
+
+/* fft_probe_start - see fft_stats.h for more details */
+void fft_probe_start(fft_probe* p)
+{
+   read_hw(p->hw);
+   p->start = now_sec();
+}
+
+/* fft_probe_stop - see fft_stats.h for more details */
+void fft_probe_stop(fft_probe* p, int phase, double bytes)
+{
+   fft_phase_stats* t;
+   long long hw[FFT_NUM_HW];
+   double elapsed;
+   int k;
+
+   elapsed = now_sec() - p->start;
+   read_hw(hw);
+
+   pthread_mutex_lock(&lock);
+   t = &totals[phase];
+   t->calls++;
+   t->seconds += elapsed;
+   t->bytes += bytes;
+   for (k = 0; k < FFT_NUM_HW; k++)
+   {
+      if (hw[k] < 0 || p->hw[k] < 0)
+         t->hw[k] = -1;
+      else if (t->hw[k] >= 0)
+         t->hw[k] += hw[k] - p->hw[k];
+   }
+   pthread_mutex_unlock(&lock);
+}
+
+/* fft_stats_enable - see fft_stats.h for more details */
+void fft_stats_enable(int on)
+{
+   fft_stats_enabled = on;
+}
+
+/* fft_stats_get - see fft_stats.h for more details */
+int fft_stats_get(int phase, fft_phase_stats* stats)
+{
+   if (phase < 0 || phase >= FFT_NUM_PHASES)
+      return -1;
+
+   pthread_mutex_lock(&lock);
+   *stats = totals[phase];
+   pthread_mutex_unlock(&lock);
+
+   return 0;
+}
+
+/* fft_stats_reset - see fft_stats.h for more details */
+void fft_stats_reset(void)
+{
+   pthread_mutex_lock(&lock);
+   memset(totals, 0, sizeof(totals));
+   pthread_mutex_unlock(&lock);
+}
+
+/* fft_phase_name - see fft_stats.h for more details */
+const char* fft_phase_name(int phase)
+{
+   return (phase >= 0 && phase < FFT_NUM_PHASES) ? phase_names[phase] : "?";
+}
+
+/* print_count - counter column, "n/a" when unavailable */
+static void print_count(FILE* fp, long long value)
+{
+   if (value < 0)
+      fprintf(fp, " %14s", "n/a");
+   else
+      fprintf(fp, " %14lld", value);
+}
+
+/* fft_stats_print - see fft_stats.h for more details */
+void fft_stats_print(FILE* fp)
+{
+   fft_phase_stats t;
+   int phase;
+
+   fprintf(fp, "%-10s %10s %12s %9s %14s %14s %6s %14s %14s\n", "phase",
+           "calls", "seconds", "GB/s", "cycles", "instructions", "IPC",
+           "cache-miss", "dtlb-miss");
+
+   for (phase = 0; phase < FFT_NUM_PHASES; phase++)
+   {
+      fft_stats_get(phase, &t);
+      fprintf(fp, "%-10s %10ld %12.6f %9.3f", phase_names[phase], t.calls,
+              t.seconds, (t.seconds > 0.0) ? t.bytes / t.seconds * 1e-9 : 0.0);
+      print_count(fp, t.calls ? t.hw[FFT_HW_CYCLES] : 0);
+      print_count(fp, t.calls ? t.hw[FFT_HW_INSTRUCTIONS] : 0);
+      if (t.calls && t.hw[FFT_HW_CYCLES] > 0 && t.hw[FFT_HW_INSTRUCTIONS] >= 0)
+         fprintf(fp, " %6.2f", (double)t.hw[FFT_HW_INSTRUCTIONS] / t.hw[FFT_HW_CYCLES]);
+      else
+         fprintf(fp, " %6s", "-");
+      print_count(fp, t.calls ? t.hw[FFT_HW_CACHE_MISSES] : 0);
+      print_count(fp, t.calls ? t.hw[FFT_HW_DTLB_MISSES] : 0);
+      fprintf(fp, "\n");
+   }
+}
+
+/* dump_at_exit - FFT_STATS summary */
+static void dump_at_exit(void)
+{
+   fft_stats_print(stderr);
+}
+
+/* load_env - FFT_STATS=1 turns statistics on and dumps them at exit */
+__attribute__((constructor))
+static void load_env(void)
+{
+   char* env = getenv("FFT_STATS");
+
+   if (env && atoi(env) != 0)
+   {
+      fft_stats_enable(1);
+      atexit(dump_at_exit);
+   }
+}
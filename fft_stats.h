@@ -0,0 +1,131 @@
+#ifndef FFT_STATS_H
+#define FFT_STATS_H
+
+#include <stdio.h>
+
+/*
+** Per-phase instrumentation of the multiply hot path. Each phase of
+** poly_mul/poly_mul_real (and every fft_malloc/fft_free) is wrapped in
+** an fft_probe, and so is every whole multiply of the other engines
+** poly_mul_auto picks from. While statistics are off a probe is one test of a
+** global flag; while on it records wall time, calls, bytes touched and,
+** through perf_event_open, hardware counters of the calling thread.
+**
+** FFT_STATS=1 in the environment turns statistics on at start-up and
+** prints the summary (fft_stats_print) to stderr at exit.
+*/
+
+/* Phases */
+#define FFT_PHASE_FORWARD    0     /* forward transforms */
+#define FFT_PHASE_POINTWISE  1     /* spectrum products */
+#define FFT_PHASE_INVERSE    2     /* inverse transforms */
+#define FFT_PHASE_SCALE      3     /* 1/n scaling and unpacking */
+#define FFT_PHASE_ALLOC      4     /* fft_malloc/fft_free */
+#define FFT_PHASE_SCHOOLBOOK 5     /* poly_mul_schoolbook */
+#define FFT_PHASE_KARATSUBA  6     /* Karatsuba, balanced or chunked */
+#define FFT_PHASE_FLOAT      7     /* poly_mul_float */
+#define FFT_PHASE_SPECTRUM   8     /* poly_mul_spectrum (blocked, stream) */
+#define FFT_PHASE_NTT        9     /* poly_mul_ntt/poly_mul_ntt32 */
+#define FFT_NUM_PHASES       10
+
+/* Hardware counters (-1 in fft_phase_stats when not available) */
+#define FFT_HW_CYCLES        0
+#define FFT_HW_INSTRUCTIONS  1
+#define FFT_HW_CACHE_MISSES  2
+#define FFT_HW_DTLB_MISSES   3
+#define FFT_NUM_HW           4
+
+/*
+** fft_phase_stats
+**
+** Totals for one phase. Phases can nest (an allocation made inside
+** a transform counts for both, and the transforms of a blocked
+** multiply count in forward/inverse as well as in spectrum). The
+** whole-multiply phases count the operands and the product as bytes.
+*/
+typedef struct
+{
+   long calls;                   /* completed probes */
+   double seconds;               /* wall time */
+   double bytes;                 /* bytes read plus bytes written */
+   long long hw[FFT_NUM_HW];     /* counter totals, -1 if unavailable */
+} fft_phase_stats;
+
+/* One timed region (lives on the caller's stack) */
+typedef struct
+{
+   int active;                   /* 1 if statistics were on at begin */
+   double start;                 /* wall clock at begin */
+   long long hw[FFT_NUM_HW];     /* counters at begin */
+} fft_probe;
+
+/* Non-zero while statistics are recorded (see fft_stats_enable) */
+extern int fft_stats_enabled;
+
+/* fft_probe_start / fft_probe_stop - slow paths of the inline probes */
+void fft_probe_start(fft_probe* p);
+void fft_probe_stop(fft_probe* p, int phase, double bytes);
+
+/* fft_probe_begin - start a region if statistics are on */
+static inline void fft_probe_begin(fft_probe* p)
+{
+   p->active = fft_stats_enabled;
+   if (p->active)
+      fft_probe_start(p);
+}
+
+/* fft_probe_end - add a region started by fft_probe_begin to a phase */
+static inline void fft_probe_end(fft_probe* p, int phase, double bytes)
+{
+   if (p->active)
+      fft_probe_stop(p, phase, bytes);
+}
+
+/*---------------------------------------------------------
+** NAME: fft_stats_enable
+**
+** PURPOSE:
+**    Turn statistics on or off. The hardware counters are
+**    opened per thread on its first probe and closed when
+**    the thread exits; when perf_event_open is not allowed
+**    (or the CPU has no such event) that counter reads -1. Counters only see
+**    the thread that runs the probe, so work handed to
+**    pool threads shows in wall time but not in them.
+**
+** INPUTS:
+**    on    1 to record, 0 to stop
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void fft_stats_enable(int on);
+
+/*---------------------------------------------------------
+** NAME: fft_stats_get
+**
+** PURPOSE:
+**    Copy the totals of one phase.
+**
+** INPUTS:
+**    phase FFT_PHASE_FORWARD .. FFT_PHASE_NTT
+**
+** OUTPUTS:
+**    stats Totals since start-up or fft_stats_reset
+**
+** RETURNS: 0, or -1 if phase is out of range
+**
+**-------------------------------------------------------*/
+int fft_stats_get(int phase, fft_phase_stats* stats);
+
+/* fft_stats_reset - zero the totals of every phase */
+void fft_stats_reset(void);
+
+/* fft_stats_print - table of every phase (time, GB/s, IPC, misses) */
+void fft_stats_print(FILE* fp);
+
+/* fft_phase_name - short name of a phase ("forward", ...) */
+const char* fft_phase_name(int phase);
+
+#endif /* FFT_STATS_H */
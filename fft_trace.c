@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "fft_trace.h"
+
+/*
+** Rings are created by their thread on its first event and pushed on a
+** lock-free list (compare and swap on the head), so recording never
+** takes a lock. The time stamp counter is calibrated against the
+** monotonic clock between fft_trace_start and the write.
+*/
+
+#define DEFAULT_EVENTS   (1 << 20)
+#define DEFAULT_MIN_N    8
+
+int fft_trace_enabled = 0;
+uint32_t fft_trace_min_n = DEFAULT_MIN_N;
+int fft_trace_butterflies = 0;
+
+static _Atomic(fft_trace_ring*) rings = NULL;
+static atomic_uint next_thread;
+static uint64_t ring_events = DEFAULT_EVENTS;
+
+/* Calibration points and output file */
+static uint64_t start_tsc;
+static double start_ns;
+static char* out_path = NULL;
+
+/* mono_ns - monotonic clock in ns */
+static double mono_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* fft_trace_clock - ns time stamps where there is no rdtsc */
+uint64_t fft_trace_clock(void)
+{
+   return (uint64_t)mono_ns();
+}
+
+/* fft_trace_ring_get - see fft_trace.h for more details */
+fft_trace_ring* fft_trace_ring_get(void)
+{
+   static __thread fft_trace_ring* ring = NULL;
+   fft_trace_ring* head;
+
+   if (ring)
+      return ring;
+
+   ring = (fft_trace_ring*)calloc(1, sizeof(fft_trace_ring));
+   if (ring)
+      ring->events = (fft_trace_event*)calloc(ring_events, 
+                                              sizeof(fft_trace_event));
+   if (!ring || !ring->events)
+   {
+      fprintf(stderr, "fft_trace: no memory for a ring of %llu events, "
+              "tracing off\n", (unsigned long long)ring_events);
+      fft_trace_enabled = 0;
+      fft_trace_butterflies = 0;
+      free(ring);
+      ring = NULL;
+      return NULL;
+   }
+   ring->mask = ring_events - 1;
+   ring->thread = atomic_fetch_add(&next_thread, 1);
+
+   head = atomic_load(&rings);
+   do
+   {
+      ring->next = head;
+   } while (!atomic_compare_exchange_weak(&rings, &head, ring));
+
+   return ring;
+}
+
+/* fft_trace_write - see fft_trace.h for more details */
+int fft_trace_write(const char* path)
+{
+   fft_trace_header hdr;
+   fft_trace_thread th;
+   fft_trace_ring* r;
+   uint64_t first, end_tsc, i;
+   FILE* fp;
+
+   end_tsc = fft_trace_tsc();
+   memset(&hdr, 0, sizeof(hdr));
+   hdr.magic = FFT_TRACE_MAGIC;
+   hdr.version = FFT_TRACE_VERSION;
+   hdr.ns_per_tick = (end_tsc > start_tsc) ?
+                     (mono_ns() - start_ns) / (double)(end_tsc - start_tsc) : 1.0;
+   hdr.tsc_start = start_tsc;
+   for (r = atomic_load(&rings); r; r = r->next)
+      hdr.threads++;
+
+   fp = fopen(path, "wb");
+   if (!fp)
+   {
+      fprintf(stderr, "fft_trace: cannot create %s\n", path);
+      return -1;
+   }
+
+   fwrite(&hdr, sizeof(hdr), 1, fp);
+   for (r = atomic_load(&rings); r; r = r->next)
+   {
+      memset(&th, 0, sizeof(th));
+      th.thread = r->thread;
+      th.written = r->head;
+      th.count = (r->head > r->mask) ? r->mask + 1 : r->head;
+      fwrite(&th, sizeof(th), 1, fp);
+
+      /* Oldest first: the ring may have wrapped */
+      first = r->head - th.count;
+      for (i = first; i < r->head; i++)
+         fwrite(&r->events[i & r->mask], sizeof(fft_trace_event), 1, fp);
+   }
+
+   if (fclose(fp) != 0)
+   {
+      fprintf(stderr, "fft_trace: error writing %s\n", path);
+      return -1;
+   }
+
+   return 0;
+}
+
+/* write_at_exit - FFT_TRACE output */
+static void write_at_exit(void)
+{
+   fft_trace_enabled = 0;
+   fft_trace_butterflies = 0;
+   if (out_path)
+      fft_trace_write(out_path);
+}
+
+/* fft_trace_start - see fft_trace.h for more details */
+void fft_trace_start(const char* path)
+{
+   char* env;
+   uint64_t size;
+
+   env = getenv("FFT_TRACE_EVENTS");
+   if (env && atol(env) > 0)
+   {
+      /* Round up to a power of 2 */
+      for (size = 1; size < (uint64_t)atol(env); size <<= 1)
+         ;
+      ring_events = size;
+   }
+   env = getenv("FFT_TRACE_MIN_N");
+   if (env && atol(env) > 0)
+      fft_trace_min_n = (uint32_t)atol(env);
+   env = getenv("FFT_TRACE_BUTTERFLY");
+
+   if (!out_path)
+      atexit(write_at_exit);
+   free(out_path);
+   out_path = strdup(path);
+
+   start_ns = mono_ns();
+   start_tsc = fft_trace_tsc();
+   fft_trace_butterflies = (env && atoi(env) != 0);
+   fft_trace_enabled = 1;
+}
+
+/* load_env - FFT_TRACE=<file> starts recording */
+__attribute__((constructor))
+static void load_env(void)
+{
+   char* env = getenv("FFT_TRACE");
+
+   if (env && *env)
+      fft_trace_start(env);
+}
@@ -0,0 +1,179 @@
+#ifndef FFT_TRACE_H
+#define FFT_TRACE_H
+
+#include <stdint.h>
+
+/*
+** Binary event trace of the FFT recursion. Each thread appends fixed
+** size events to its own ring buffer (no locks, no atomics on the hot
+** path; the oldest events are overwritten when a ring is full), and
+** the rings are written to a file at exit for trace_decode.
+**
+** Recording is compiled in with -DDEBUG_TRACE (the recursive_fft
+** build) and switched on at run time by FFT_TRACE=<file>. Optional:
+**
+**    FFT_TRACE_EVENTS     ring size per thread (default 1M events)
+**    FFT_TRACE_MIN_N      only record sub-transforms of at least this
+**                         length (default 8; 1 records every leaf, at
+**                         about 5 times the overhead)
+**    FFT_TRACE_BUTTERFLY  1 to also record every butterfly (large!)
+**
+** File layout (native byte order):
+**
+**    fft_trace_header
+**    per thread: fft_trace_thread, then count events, oldest first
+*/
+#define FFT_TRACE_MAGIC     0x43525446u   /* "FTRC" */
+#define FFT_TRACE_VERSION   1
+
+/* Event types */
+#define FFT_TRACE_ENTER     1     /* sub-transform starts, arg = n */
+#define FFT_TRACE_EXIT      2     /* sub-transform ends, arg = n */
+#define FFT_TRACE_BUTTERFLY 3     /* butterfly k of the current level */
+
+/* One event (16 bytes) */
+typedef struct
+{
+   uint64_t tsc;        /* time stamp counter */
+   uint32_t arg;        /* n, or the butterfly index */
+   uint8_t type;        /* FFT_TRACE_ENTER, ... */
+   uint8_t level;       /* recursion depth (0 = outermost transform) */
+   uint16_t flags;      /* 1 = inverse transform */
+} fft_trace_event;
+
+/* File header */
+typedef struct
+{
+   uint32_t magic;      /* FFT_TRACE_MAGIC */
+   uint32_t version;    /* FFT_TRACE_VERSION */
+   uint32_t threads;    /* thread blocks that follow */
+   uint32_t reserved;
+   double ns_per_tick;  /* time stamp counter period */
+   uint64_t tsc_start;  /* counter when tracing started */
+} fft_trace_header;
+
+/* Per thread block header */
+typedef struct
+{
+   uint32_t thread;     /* 0 = first thread to record */
+   uint32_t reserved;
+   uint64_t written;    /* events recorded (including overwritten) */
+   uint64_t count;      /* events that follow */
+} fft_trace_thread;
+
+/* Per thread ring (see fft_trace.c) */
+typedef struct fft_trace_ring
+{
+   fft_trace_event* events;
+   uint64_t mask;       /* capacity - 1 (capacity is a power of 2) */
+   uint64_t head;       /* events written so far */
+   uint32_t thread;
+   uint8_t depth;       /* current recursion depth */
+   struct fft_trace_ring* next;
+} fft_trace_ring;
+
+/* Non-zero while recording; minimum n and butterfly switch */
+extern int fft_trace_enabled;
+extern uint32_t fft_trace_min_n;
+extern int fft_trace_butterflies;
+
+/* fft_trace_ring_get - calling thread's ring, created on first use (NULL
+   and tracing turned off if there is no memory for it) */
+fft_trace_ring* fft_trace_ring_get(void);
+
+/* fft_trace_tsc - time stamp counter (or ns on other CPUs) */
+static inline uint64_t fft_trace_tsc(void)
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+   return __builtin_ia32_rdtsc();
+#else
+   extern uint64_t fft_trace_clock(void);
+   return fft_trace_clock();
+#endif
+}
+
+/* fft_trace_record - append one event to the calling thread's ring */
+static inline void fft_trace_record(int type, uint32_t arg, int inv)
+{
+   static __thread fft_trace_ring* ring = 0;
+   fft_trace_event* e;
+
+   if (!ring)
+   {
+      ring = fft_trace_ring_get();
+      if (!ring)
+         return;
+   }
+
+   /* An exit whose entry was not recorded (tracing turned on inside a
+      sub-transform) must not wrap the depth around */
+   if (type == FFT_TRACE_EXIT && ring->depth > 0)
+      ring->depth--;
+
+   e = &ring->events[ring->head & ring->mask];
+   e->tsc = fft_trace_tsc();
+   e->arg = arg;
+   e->type = (uint8_t)type;
+   e->level = ring->depth;
+   e->flags = (uint16_t)(inv ? 1 : 0);
+   ring->head++;
+
+   if (type == FFT_TRACE_ENTER && ring->depth < UINT8_MAX)
+      ring->depth++;
+}
+
+/*
+** Trace points. They compile to nothing without DEBUG_TRACE, and to a
+** test of fft_trace_enabled (plus the n filter) when it is off.
+*/
+#ifdef DEBUG_TRACE
+#define FFT_TRACE_ENTER_N(n, inv) \
+   do { if (fft_trace_enabled && (uint32_t)(n) >= fft_trace_min_n) \
+           fft_trace_record(FFT_TRACE_ENTER, (uint32_t)(n), (inv)); } while (0)
+#define FFT_TRACE_EXIT_N(n, inv) \
+   do { if (fft_trace_enabled && (uint32_t)(n) >= fft_trace_min_n) \
+           fft_trace_record(FFT_TRACE_EXIT, (uint32_t)(n), (inv)); } while (0)
+#define FFT_TRACE_BUTTERFLY_K(n, k, inv) \
+   do { if (fft_trace_butterflies && (uint32_t)(n) >= fft_trace_min_n) \
+           fft_trace_record(FFT_TRACE_BUTTERFLY, (uint32_t)(k), (inv)); } while (0)
+#else
+#define FFT_TRACE_ENTER_N(n, inv)         do { } while (0)
+#define FFT_TRACE_EXIT_N(n, inv)          do { } while (0)
+#define FFT_TRACE_BUTTERFLY_K(n, k, inv)  do { } while (0)
+#endif
+
+/*---------------------------------------------------------
+** NAME: fft_trace_start
+**
+** PURPOSE:
+**    Start recording and write every ring to path at exit
+**    (also done automatically when FFT_TRACE is set).
+**
+** INPUTS:
+**    path  Output file for fft_trace_write
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void fft_trace_start(const char* path);
+
+/*---------------------------------------------------------
+** NAME: fft_trace_write
+**
+** PURPOSE:
+**    Write all rings to a trace file. The threads that own
+**    them must not be recording at the time.
+**
+** INPUTS:
+**    path  Output file
+**
+** OUTPUTS: none
+**
+** RETURNS: 0 on success, -1 on error (message on stderr)
+**
+**-------------------------------------------------------*/
+int fft_trace_write(const char* path);
+
+#endif /* FFT_TRACE_H */
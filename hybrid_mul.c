@@ -0,0 +1,461 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common_defs.h"
+#include "fft_stats.h"
+
+/*
+** Size-aware polynomial multiplication. For small n the O(n^2) loop has
+** no padding and no transforms, Karatsuba wins in the middle, and the
+** FFT (poly_mul_real) takes over for large n. When one operand is much
+** shorter than the other, the long one is cut into blocks so the cost
+** grows with the long length times a function of the short one.
+*/
+
+/* Default crossovers (override with poly_mul_set_thresholds/env vars) */
+#define DEFAULT_KARATSUBA_MIN  16
+#define DEFAULT_FFT_MIN        1024
+
+/* Use the blocked FFT when the long operand is this many times longer */
+#define BLOCK_RATIO            4
+
+/* Blocked FFT length is about BLOCK_FACTOR times the short operand */
+#define BLOCK_FACTOR           4
+#define BLOCK_MIN_SIZE         64
+
+static int karatsuba_min = -1;   /* -1 until read from the environment */
+static int fft_min = -1;
+
+/* Precision mode and how often each precision was used */
+static int precision = POLY_PRECISION_AUTO;
+static long float_count = 0;
+static long double_count = 0;
+
+/* Float products must be off by less than this to round exactly */
+#define FLOAT_EXACT_BOUND      0.5
+
+/* Below this short length Karatsuba beats the float FFT (auto mode) */
+#define FLOAT_MIN              64
+
+/* Scratch shared by the Karatsuba and FFT paths (grow only) */
+static fft_arena work = { NULL, 0 };
+
+/* load_thresholds - defaults, overridden by POLYMUL_KARATSUBA_MIN/FFT_MIN */
+static void load_thresholds(void)
+{
+   char* env;
+
+   if (karatsuba_min >= 0)
+      return;
+
+   karatsuba_min = DEFAULT_KARATSUBA_MIN;
+   fft_min = DEFAULT_FFT_MIN;
+
+   env = getenv("POLYMUL_KARATSUBA_MIN");
+   if (env)
+      karatsuba_min = atoi(env);
+   env = getenv("POLYMUL_FFT_MIN");
+   if (env)
+      fft_min = atoi(env);
+
+   env = getenv("POLYMUL_PRECISION");
+   if (env && strcmp(env, "double") == 0)
+      precision = POLY_PRECISION_DOUBLE;
+   else if (env && strcmp(env, "float") == 0)
+      precision = POLY_PRECISION_FLOAT;
+}
+
+/* work_doubles - scratch of at least count doubles */
+static double* work_doubles(int count)
+{
+   fft_arena_reserve(&work, (count + 1) / 2);
+   return (double*)work.buf;
+}
+
+/* schoolbook - O(na*nb) product (also the base case of karatsuba) */
+static void schoolbook(const double* a, int na, const double* b, int nb,
+                       double* c)
+{
+   int i, j;
+
+   for (i = 0; i < (na + nb - 1); i++)
+      c[i] = 0.0;
+
+   for (i = 0; i < na; i++)
+   {
+      for (j = 0; j < nb; j++)
+         c[i+j] += a[i] * b[j];
+   }
+}
+
+/* poly_mul_schoolbook - see common_defs.h for more details */
+void poly_mul_schoolbook(const double* a, int na, const double* b, int nb,
+                         double* c)
+{
+   fft_probe probe;
+
+   fft_probe_begin(&probe);
+   schoolbook(a, na, b, nb, c);
+   fft_probe_end(&probe, FFT_PHASE_SCHOOLBOOK, 8.0*(2*(na + nb) - 1));
+}
+
+/*
+** karatsuba
+**
+** With h = ceil(n/2), a = a0 + x^h*a1 and b = b0 + x^h*b1:
+**
+**    z0 = a0*b0,  z2 = a1*b1,  z1 = (a0+a1)*(b0+b1) - z0 - z2
+**    a*b = z0 + x^h*z1 + x^2h*z2
+**
+** z0 and z2 go straight into c. scratch holds the sums and z1 and is 
+** reused by the recursion (about 4n doubles in total).
+*/
+static void karatsuba(const double* a, const double* b, double* c, int n,
+                      double* scratch, int base)
+{
+   double* sa;
+   double* sb;
+   double* z1;
+   int h, l, i;
+
+   if (n <= base || n < 2)
+   {
+      schoolbook(a, n, b, n, c);
+      return;
+   }
+
+   h = (n + 1)/2;
+   l = n - h;
+
+   /* z0 in c[0, 2h-1), z2 in c[2h, 2n-1), with c[2h-1] in between */
+   karatsuba(a, b, c, h, scratch, base);
+   karatsuba(a + h, b + h, c + 2*h, l, scratch, base);
+   c[2*h - 1] = 0.0;
+
+   sa = scratch;
+   sb = scratch + h;
+   z1 = scratch + 2*h;
+   for (i = 0; i < h; i++)
+   {
+      sa[i] = a[i] + ((i < l) ? a[h+i] : 0.0);
+      sb[i] = b[i] + ((i < l) ? b[h+i] : 0.0);
+   }
+   karatsuba(sa, sb, z1, h, scratch + 4*h, base);
+
+   for (i = 0; i < (2*h - 1); i++)
+      z1[i] -= c[i];
+   for (i = 0; i < (2*l - 1); i++)
+      z1[i] -= c[2*h + i];
+   for (i = 0; i < (2*h - 1); i++)
+      c[h + i] += z1[i];
+}
+
+/* poly_mul_karatsuba - see common_defs.h for more details */
+void poly_mul_karatsuba(const double* a, const double* b, double* c, int n)
+{
+   fft_probe probe;
+
+   load_thresholds();
+   fft_probe_begin(&probe);
+   karatsuba(a, b, c, n, work_doubles(4*n + 128), 
+             karatsuba_min > 1 ? karatsuba_min - 1 : 1);
+   fft_probe_end(&probe, FFT_PHASE_KARATSUBA, 8.0*(4*n - 1));
+}
+
+/* real_fft_size - smallest even length >= n with n/2 = 2^a * 3^b * 5^c */
+static int real_fft_size(int n)
+{
+   return 2 * fft_good_size((n + 1) / 2);
+}
+
+/* poly_mul_fft - real FFT path of poly_mul_auto */
+static void poly_mul_fft(const double* a, int na, const double* b, int nb,
+                         double* c)
+{
+   complex* fa;
+   complex* fb;
+   int size, j;
+
+   /* Transform size: smallest mixed radix size for all na+nb-1 terms */
+   size = real_fft_size(na + nb - 1);
+
+   fft_arena_reserve(&work, 2*size);
+   fa = work.buf;
+   fb = work.buf + size;
+
+   for (j = 0; j < size; j++)
+   {
+      fa[j].r = (j < na) ? a[j] : 0.0;
+      fa[j].i = 0.0;
+      fb[j].r = (j < nb) ? b[j] : 0.0;
+      fb[j].i = 0.0;
+   }
+
+   poly_mul_real(fa, fb, size);
+
+   for (j = 0; j < (na + nb - 1); j++)
+      c[j] = fa[j].r;
+}
+
+/*
+** poly_mul_chunked
+**
+** Karatsuba for unequal lengths: the long operand (nl coefficients) is 
+** cut into chunks of ns, each chunk times the short operand is a 
+** balanced product, and the results are added into c at their offsets.
+*/
+static void poly_mul_chunked(const double* l, int nl, const double* s, int ns,
+                             double* c)
+{
+   fft_probe probe;
+   double* chunk;
+   double* prod;
+   int o, len, j;
+
+   fft_probe_begin(&probe);
+
+   /* Karatsuba scratch goes after the chunk and its product */
+   chunk = work_doubles(ns + 2*ns + 4*ns + 128);
+   prod = chunk + ns;
+
+   for (j = 0; j < (nl + ns - 1); j++)
+      c[j] = 0.0;
+
+   for (o = 0; o < nl; o += ns)
+   {
+      len = (nl - o < ns) ? nl - o : ns;
+      for (j = 0; j < ns; j++)
+         chunk[j] = (j < len) ? l[o + j] : 0.0;
+
+      karatsuba(chunk, s, prod, ns, prod + 2*ns, 
+                karatsuba_min > 1 ? karatsuba_min - 1 : 1);
+
+      for (j = 0; j < (len + ns - 1); j++)
+         c[o + j] += prod[j];
+   }
+
+   fft_probe_end(&probe, FFT_PHASE_KARATSUBA, 8.0*(2*(nl + ns) - 1));
+}
+
+/*
+** poly_mul_blocked
+**
+** Overlap-add FFT for a short operand s (ns coefficients) against a long
+** one. The transform only has to hold a block of about (BLOCK_FACTOR-1)
+** * ns long coefficients times s, and s is transformed once for all the
+** blocks. Its spectrum is not put in the poly_spectrum cache: s is
+** usually a one-off operand and would push out the kernels callers
+** keep there (use poly_spectrum_get directly to reuse one).
+*/
+static void poly_mul_blocked(const double* l, int nl, const double* s, int ns,
+                             double* c)
+{
+   poly_spectrum* spec;
+   int size;
+
+   size = (BLOCK_FACTOR * ns > BLOCK_MIN_SIZE) ? BLOCK_FACTOR * ns : 
+                                                 BLOCK_MIN_SIZE;
+   spec = poly_spectrum_create(s, ns, size - ns + 1);
+   poly_mul_spectrum(l, nl, spec, c);
+   poly_spectrum_destroy(spec);
+}
+
+/*
+** use_float
+**
+** Precision choice of poly_mul_auto for a long operand l and short s: 
+** float when forced, or in auto mode when s is long enough for the FFT
+** to pay off and the product of these (integer) operands provably
+** rounds exactly. The bound is a rigorous worst case, so auto mode only
+** gets here for 0/1 operands of FLOAT_MIN to 128 terms; decimal
+** digits never pass it. Longer products need POLY_PRECISION_FLOAT.
+*/
+static int use_float(const double* l, int nl, const double* s, int ns)
+{
+   if (precision == POLY_PRECISION_FLOAT)
+      return 1;
+   if (precision == POLY_PRECISION_DOUBLE || ns < FLOAT_MIN)
+      return 0;
+
+   return (poly_mul_float_bound(l, nl, s, ns) < FLOAT_EXACT_BOUND);
+}
+
+/* poly_mul_auto - see common_defs.h for more details */
+void poly_mul_auto(const double* a, int na, const double* b, int nb, 
+                   double* c)
+{
+   const double* l = a;
+   const double* s = b;
+   int nl = na, ns = nb;
+   int j;
+
+   load_thresholds();
+
+   if (nb > na)
+   {
+      l = b;
+      s = a;
+      nl = nb;
+      ns = na;
+   }
+
+   if (ns < karatsuba_min)
+   {
+      poly_mul_schoolbook(l, nl, s, ns, c);
+      return;
+   }
+
+   /* Products too long for poly_mul_float are done in double */
+   if (use_float(l, nl, s, ns) && poly_mul_float(l, nl, s, ns, c) == 0)
+   {
+      float_count++;
+      if (precision == POLY_PRECISION_AUTO)
+      {
+         for (j = 0; j < (nl + ns - 1); j++)
+            c[j] = rint(c[j]);
+      }
+      return;
+   }
+   double_count++;
+
+   if (ns < fft_min)
+   {
+      if (nl == ns)
+         poly_mul_karatsuba(a, b, c, ns);
+      else
+         poly_mul_chunked(l, nl, s, ns, c);
+   }
+   else if (nl >= BLOCK_RATIO * ns)
+      poly_mul_blocked(l, nl, s, ns, c);
+   else
+      poly_mul_fft(l, nl, s, ns, c);
+}
+
+/* poly_mul_set_thresholds - see common_defs.h for more details */
+void poly_mul_set_thresholds(int karatsuba_n, int fft_n)
+{
+   load_thresholds();
+   karatsuba_min = karatsuba_n;
+   fft_min = fft_n;
+}
+
+/* poly_mul_get_thresholds - see common_defs.h for more details */
+void poly_mul_get_thresholds(int* karatsuba_n, int* fft_n)
+{
+   load_thresholds();
+   *karatsuba_n = karatsuba_min;
+   *fft_n = fft_min;
+}
+
+/* poly_mul_set_precision - see common_defs.h for more details */
+void poly_mul_set_precision(int mode)
+{
+   load_thresholds();
+   precision = mode;
+}
+
+/* poly_mul_precision_stats - see common_defs.h for more details */
+void poly_mul_precision_stats(long* floats, long* doubles)
+{
+   *floats = float_count;
+   *doubles = double_count;
+}
+
+/* schoolbook_n - balanced poly_mul_schoolbook (for time_mul) */
+static void schoolbook_n(const double* a, const double* b, double* c, int n)
+{
+   poly_mul_schoolbook(a, n, b, n, c);
+}
+
+/* fft_n - balanced poly_mul_fft (for time_mul) */
+static void fft_n(const double* a, const double* b, double* c, int n)
+{
+   poly_mul_fft(a, n, b, n, c);
+}
+
+/* now_sec - monotonic wall clock in seconds */
+static double now_sec(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+** time_mul
+**
+** Best-of-3 time per call of mul at size n. Each trial repeats the call
+** until about 2 ms have passed so small sizes are measurable.
+*/
+static double time_mul(void (*mul)(const double*, const double*, double*, int),
+                       const double* a, const double* b, double* c, int n)
+{
+   double best = 0.0, start, t;
+   int trial, reps;
+
+   for (trial = 0; trial < 3; trial++)
+   {
+      reps = 0;
+      start = now_sec();
+      do
+      {
+         mul(a, b, c, n);
+         reps++;
+         t = now_sec() - start;
+      } while (t < 2e-3);
+
+      t /= reps;
+      if (trial == 0 || t < best)
+         best = t;
+   }
+
+   return best;
+}
+
+/* poly_mul_autotune - see common_defs.h for more details */
+void poly_mul_autotune(void)
+{
+   double* a;
+   double* b;
+   double* c;
+   int max_n = 8192;
+   int n, j;
+
+   a = (double*)malloc(max_n * sizeof(double));
+   b = (double*)malloc(max_n * sizeof(double));
+   c = (double*)malloc(2 * max_n * sizeof(double));
+   for (j = 0; j < max_n; j++)
+   {
+      a[j] = rand() % 10;
+      b[j] = rand() % 10;
+   }
+
+   /*
+   ** Karatsuba crossover: smallest n where one Karatsuba level (with 
+   ** schoolbook halves) beats schoolbook at size 2n. The recursion stops
+   ** at karatsuba_min - 1, so n + 1 makes the halves of 2n schoolbook.
+   */
+   load_thresholds();
+   for (n = 4; n < max_n/2; n <<= 1)
+   {
+      karatsuba_min = n + 1;
+      if (time_mul(poly_mul_karatsuba, a, b, c, 2*n) < 
+          time_mul(schoolbook_n, a, b, c, 2*n))
+         break;
+   }
+   karatsuba_min = n;
+
+   /* FFT crossover: smallest size (in steps of 1/4 octave) where the FFT wins */
+   for (n = karatsuba_min; n < max_n; n += (n/4 > 0 ? n/4 : 1))
+   {
+      if (time_mul(fft_n, a, b, c, n) < 
+          time_mul(poly_mul_karatsuba, a, b, c, n))
+         break;
+   }
+   fft_min = n;
+
+   free(a);
+   free(b);
+   free(c);
+}
@@ -1,14 +1,75 @@
+#include <math.h>
 #include "common_defs.h"
 
+/*
+** bit_reverse_permute
+**
+** Permute array in place so that a[i] and a[rev(i)] trade places, where
+** rev(i) reverses the lg(n) low order bits of i. The reversed counter j
+** is advanced by "adding 1" from the most significant bit downwards.
+*/
+static void bit_reverse_permute(complex* a, int n)
+{
+   complex temp;
+   int i, j, k;
+
+   j = 0;
+   for (i = 0; i < (n-1); i++)
+   {
+      if (i < j)
+      {
+         temp = a[i];
+         a[i] = a[j];
+         a[j] = temp;
+      }
+
+      k = n >> 1;
+      while (k <= j)
+      {
+         j -= k;
+         k >>= 1;
+      }
+      j += k;
+   }
+}
+
 /* iterative_fft - see common_defs.h for more details */
-#if 0
 void iterative_fft(complex* a, int n, int inv)
 {
-   complex* A;
-   
-   A = (complex*)malloc(n * sizeof(complex));
-   bit_reverse_copy(a,A);
-   
-   free(A);
+   complex w, wm, t, u;
+   int m, k, j;
+
+   /* Put coefficients in the order the butterflies consume them */
+   bit_reverse_permute(a, n);
+
+   /* lg(n) butterfly passes, doubling the butterfly size each pass */
+   for (m = 2; m <= n; m <<= 1)
+   {
+      /* Principal mth root of unity (i.e. exp(2*PI*i/m)) */
+      if (inv)
+      {
+         wm.r = cos(-2*PI/(double)m);
+         wm.i = sin(-2*PI/(double)m);
+      }
+      else
+      {
+         wm.r = cos(2*PI/(double)m);
+         wm.i = sin(2*PI/(double)m);
+      }
+
+      for (k = 0; k < n; k += m)
+      {
+         w.r = 1.0;
+         w.i = 0.0;
+
+         for (j = 0; j < (m/2); j++)
+         {
+            t = complex_mul(w, a[k+j+m/2]);
+            u = a[k+j];
+            a[k+j]     = complex_add(u, t);
+            a[k+j+m/2] = complex_sub(u, t);
+            w = complex_mul(w, wm);
+         }
+      }
+   }
 }
-#endif
@@ -1,11 +1,562 @@
 #include <stdio.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 #include "common_defs.h"
+#include "fft_alloc.h"
+#include "thread_pool.h"
+#include "ntt.h"
+#include "poly_io.h"
+#include "text_io.h"
 
 #define MAX_COEFF    10
 #define MAX_N        (1<<20)
 
+/* Length of the short operand in the unbalanced timed test (-u) */
+#define SHORT_N      10
+
+/* Streaming mode (-s): coefficients per read */
+#define STREAM_CHUNK     4096
+
+/* Longest bad token quoted in an error message */
+#define MAX_TOKEN        32
+
+/* Most terms (na + nb - 1) of a product read from stdin */
+#define MAX_PRODUCT      (1<<30)
+
+#ifndef REC_FFT
+/* Buffered stdin/stdout for the text modes */
+static text_reader input;
+static text_writer output;
+
+/* 1 to print every product coefficient (-a), not just x^0 .. x^100 */
+static int print_all = 0;
+
+/* bad_coeff - report the token where a coefficient was expected */
+static void bad_coeff(void)
+{
+   char token[MAX_TOKEN];
+
+   text_peek_token(&input, token, sizeof(token));
+   if (token[0])
+      fprintf(stderr, "Bad coefficient \"%s\": not an integer or outside "
+                      "the 64-bit range\n", token);
+   else
+      fprintf(stderr, "Missing coefficient: input ended early\n");
+}
+
+/* read_coeff - next integer from stdin; 0 (and a message) if there is none */
+static int read_coeff(int64_t* v)
+{
+   if (text_read_int(&input, v))
+      return 1;
+
+   bad_coeff();
+   return 0;
+}
+
+/* read_coeffs - n integers from stdin; 0 (and a message) if they run out */
+static int read_coeffs(int64_t* v, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++)
+   {
+      if (!read_coeff(&v[i]))
+         return 0;
+   }
+
+   return 1;
+}
+
+/* read_size - next length from stdin, 1 .. MAX_PRODUCT; 0 (and a message)
+   if there is none */
+static int read_size(int* n)
+{
+   char token[MAX_TOKEN];
+   int64_t v;
+
+   if (!text_read_int(&input, &v))
+   {
+      text_peek_token(&input, token, sizeof(token));
+      if (token[0])
+         fprintf(stderr, "Bad length \"%s\": not an integer\n", token);
+      else
+         fprintf(stderr, "Missing length: input ended early\n");
+      return 0;
+   }
+
+   if (v < 1 || v > MAX_PRODUCT)
+   {
+      fprintf(stderr, "Bad length %lld: must be 1 to %d\n", (long long)v,
+              MAX_PRODUCT);
+      return 0;
+   }
+
+   *n = (int)v;
+   return 1;
+}
+
+/* read_sizes - "n" (both lengths) or, for -u, "na nb" from stdin; 0 (and
+   a message) if they are bad or the product would be too long */
+static int read_sizes(int unbalanced, int* na, int* nb)
+{
+   if (!read_size(na))
+      return 0;
+   *nb = *na;
+
+   if (unbalanced && !read_size(nb))
+      return 0;
+
+   /* 64-bit sum: two lengths near MAX_PRODUCT would overflow an int */
+   if ((int64_t)*na + *nb - 1 > MAX_PRODUCT)
+   {
+      fprintf(stderr, "Bad lengths %d and %d: the product has more than "
+                      "%d terms\n", *na, *nb, MAX_PRODUCT);
+      return 0;
+   }
+
+   return 1;
+}
+#endif
+
+/* elapsed - seconds since start on the monotonic clock */
+static double elapsed(const struct timespec* start)
+{
+   struct timespec end;
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+#ifndef REC_FFT
+/*---------------------------------------------------------
+** NAME: run_exact
+**
+** PURPOSE:
+**    Exact integer mode (-n). Same input and output as the
+**    default driver, but the polynomials are multiplied 
+**    with poly_mul_ntt, so large coefficients (anything
+**    that fits in int64) are not rounded. In the timed
+**    build, times the NTT on random polynomials of
+**    increasing size instead.
+**
+** INPUTS:
+**    timed_test  1 for the timed loop, 0 to read stdin
+**    unbalanced  1 if stdin gives separate lengths (-u)
+**
+** OUTPUTS: Prints the product coefficients (or timings)
+**
+** RETURNS: 0 on success, 1 on bad input or if the product
+**          could overflow
+**
+**-------------------------------------------------------*/
+static int run_exact(int timed_test, int unbalanced)
+{
+   int n, na, nb;
+   int i;
+   int shift_val;
+   int ret, ok;
+   struct timespec start;
+   double secs;
+   int64_t* a;
+   int64_t* b;
+   int64_t* c;
+   
+   if (timed_test)
+   {
+      srand(time(NULL));
+      
+      n = 1;
+      shift_val = 0;
+      while ((n = (n<<1)) <= MAX_N)
+      {
+         shift_val++;
+         
+         a = (int64_t*)fft_alloc(n * sizeof(int64_t));
+         b = (int64_t*)fft_alloc(n * sizeof(int64_t));
+         c = (int64_t*)fft_alloc(2 * n * sizeof(int64_t));
+         
+         for (i = 0; i < n; i++)
+         {
+            a[i] = rand()%MAX_COEFF;
+            b[i] = rand()%MAX_COEFF;
+         }
+         
+         clock_gettime(CLOCK_MONOTONIC, &start);
+         poly_mul_ntt(a, n, b, n, c);
+         secs = elapsed(&start);
+         
+         fft_alloc_free(a);
+         fft_alloc_free(b);
+         fft_alloc_free(c);
+         
+         printf("[N = 2^%-2d = %-7d] Time elapsed: %.9f sec\n", 
+            shift_val, n, secs);
+      }
+      
+      return 0;
+   }
+   
+   /* Read sizes of coefficient arrays and coefficients from stdin */
+   if (!read_sizes(unbalanced, &na, &nb))
+      return 1;
+   
+   a = (int64_t*)fft_alloc(na * sizeof(int64_t));
+   b = (int64_t*)fft_alloc(nb * sizeof(int64_t));
+   c = (int64_t*)fft_alloc((na + nb) * sizeof(int64_t));
+   
+   ok = read_coeffs(a, na) && read_coeffs(b, nb);
+   if (ok)
+   {
+      ret = poly_mul_ntt(a, na, b, nb, c);
+      if (ret != NTT_OK)
+      {
+         fprintf(stderr, "Exact multiply failed: %s\n", ntt_strerror(ret));
+         ok = 0;
+      }
+   }
+   if (!ok)
+   {
+      fft_alloc_free(a);
+      fft_alloc_free(b);
+      fft_alloc_free(c);
+      return 1;
+   }
+   
+   text_write_str(&output, "\nPrinting coefficients for x^k:\n");
+   for (i = 0; i < (na + nb - 1); i++)
+   {
+      if (i > 100 && !print_all)
+         break;
+      
+      text_write_coeff(&output, i, c[i]);
+   }
+   
+   fft_alloc_free(a);
+   fft_alloc_free(b);
+   fft_alloc_free(c);
+   
+   return 0;
+}
+
+/*---------------------------------------------------------
+** NAME: run_auto
+**
+** PURPOSE:
+**    Default driver mode. Multiplies the real polynomials
+**    with poly_mul_auto, which picks schoolbook, Karatsuba
+**    or the real FFT by size. In the timed build, times it
+**    on random polynomials of increasing size instead (with
+**    -u, against a fixed SHORT_N coefficient polynomial).
+**
+** INPUTS:
+**    timed_test  1 for the timed loop, 0 to read stdin
+**    unbalanced  1 for separate operand lengths (-u)
+**
+** OUTPUTS: Prints the product coefficients (or timings)
+**
+** RETURNS: 0 on success, 1 on bad input
+**
+**-------------------------------------------------------*/
+static int run_auto(int timed_test, int unbalanced)
+{
+   int n, na, nb;
+   int i;
+   int shift_val;
+   int64_t value;
+   long allocs;
+   struct timespec start;
+   double secs;
+   double* a;
+   double* b;
+   double* c;
+   
+   if (timed_test)
+   {
+      srand(time(NULL));
+      
+      n = 1;
+      shift_val = 0;
+      while ((n = (n<<1)) <= MAX_N)
+      {
+         shift_val++;
+         
+         nb = (unbalanced && n > SHORT_N) ? SHORT_N : n;
+         a = (double*)fft_alloc(n * sizeof(double));
+         b = (double*)fft_alloc(nb * sizeof(double));
+         c = (double*)fft_alloc((n + nb) * sizeof(double));
+         
+         /* Randomize polynomials to multiply */
+         for (i = 0; i < n; i++)
+            a[i] = rand()%MAX_COEFF;
+         for (i = 0; i < nb; i++)
+            b[i] = rand()%MAX_COEFF;
+         
+         allocs = fft_alloc_count();
+         clock_gettime(CLOCK_MONOTONIC, &start);
+         poly_mul_auto(a, n, b, nb, c);
+         secs = elapsed(&start);
+         allocs = fft_alloc_count() - allocs;
+         
+         fft_alloc_free(a);
+         fft_alloc_free(b);
+         fft_alloc_free(c);
+         
+         printf("[N = 2^%-2d = %-7d] Time elapsed: %.9f sec (%ld allocations)\n", 
+            shift_val, n, secs, allocs);
+      }
+      
+      return 0;
+   }
+   
+   /* Read sizes of coefficient arrays and coefficients from stdin */
+   if (!read_sizes(unbalanced, &na, &nb))
+      return 1;
+   
+   a = (double*)fft_alloc(na * sizeof(double));
+   b = (double*)fft_alloc(nb * sizeof(double));
+   c = (double*)fft_alloc((na + nb) * sizeof(double));
+   
+   for (i = 0; i < (na + nb); i++)
+   {
+      if (!read_coeff(&value))
+         break;
+      if (i < na)
+         a[i] = (double)value;
+      else
+         b[i - na] = (double)value;
+   }
+   if (i < (na + nb))
+   {
+      fft_alloc_free(a);
+      fft_alloc_free(b);
+      fft_alloc_free(c);
+      return 1;
+   }
+   
+   poly_mul_auto(a, na, b, nb, c);
+   
+   text_write_str(&output, "\nPrinting coefficients for x^k:\n");
+   for (i = 0; i < (na + nb - 1); i++)
+   {
+      if (i > 100 && !print_all)
+         break;
+      
+      text_write_coeff_double(&output, i, c[i]);
+   }
+   
+   fft_alloc_free(a);
+   fft_alloc_free(b);
+   fft_alloc_free(c);
+   
+   return 0;
+}
+
+/* print_coeffs - poly_stream callback, prints "[k] = c" lines */
+static void print_coeffs(const double* c, int count, void* arg)
+{
+   long* k = (long*)arg;
+   int i;
+
+   for (i = 0; i < count; i++)
+      text_write_coeff_double(&output, (*k)++, c[i]);
+}
+
+/*---------------------------------------------------------
+** NAME: run_stream
+**
+** PURPOSE:
+**    Streaming mode (-s). Reads the kernel size and kernel
+**    coefficients from stdin, then multiplies it by the 
+**    coefficients that follow until end of input, printing
+**    every product coefficient as soon as it is final.
+**    (The bench program measures its throughput.)
+**
+** INPUTS:
+**    block Input coefficients per transform (0 for the 
+**          default)
+**
+** OUTPUTS: Prints the product coefficients
+**
+** RETURNS: 0 on success, 1 on bad input
+**
+**-------------------------------------------------------*/
+static int run_stream(int block)
+{
+   poly_stream* s;
+   double* kernel;
+   double* chunk;
+   long k;
+   int64_t value;
+   char token[MAX_TOKEN];
+   int nk, count, i;
+
+   /* Kernel first, then the long polynomial until end of input */
+   if (!read_size(&nk))
+      return 1;
+
+   kernel = (double*)fft_alloc(nk * sizeof(double));
+   for (i = 0; i < nk; i++)
+   {
+      if (!read_coeff(&value))
+      {
+         fft_alloc_free(kernel);
+         return 1;
+      }
+      kernel[i] = (double)value;
+   }
+
+   text_write_str(&output, "\nPrinting coefficients for x^k:\n");
+
+   k = 0;
+   s = poly_stream_create(kernel, nk, block, print_coeffs, &k);
+   chunk = (double*)fft_alloc(STREAM_CHUNK * sizeof(double));
+   token[0] = '\0';
+   do
+   {
+      for (count = 0; count < STREAM_CHUNK; count++)
+      {
+         if (!text_read_int(&input, &value))
+         {
+            /* End of input, unless there is text left over */
+            text_peek_token(&input, token, sizeof(token));
+            break;
+         }
+         chunk[count] = (double)value;
+      }
+      poly_stream_push(s, chunk, count);
+   } while (count == STREAM_CHUNK);
+
+   if (token[0])
+      bad_coeff();
+   else
+      poly_stream_finish(s);
+   poly_stream_destroy(s);
+   fft_alloc_free(kernel);
+   fft_alloc_free(chunk);
+
+   return token[0] ? 1 : 0;
+}
+
+/*---------------------------------------------------------
+** NAME: run_convert
+**
+** PURPOSE:
+**    Text to binary (-c). Reads polynomials in the stdin
+**    format (with -u, separate lengths) and writes them as
+**    an int64 polynomial file for -f. On bad input the file
+**    is removed.
+**
+** INPUTS:
+**    unbalanced  1 if stdin gives separate lengths (-u)
+**    out_path    Binary file to write
+**
+** OUTPUTS: Writes out_path
+**
+** RETURNS: 0 on success, 1 on bad input or I/O error
+**
+**-------------------------------------------------------*/
+static int run_convert(int unbalanced, const char* out_path)
+{
+   poly_file f;
+   int na, nb, ok;
+
+   if (!read_sizes(unbalanced, &na, &nb))
+      return 1;
+
+   if (poly_file_create(out_path, POLY_INT64, na, nb, &f) != 0)
+      return 1;
+
+   ok = read_coeffs((int64_t*)f.a, na) && read_coeffs((int64_t*)f.b, nb);
+
+   poly_file_close(&f);
+   if (!ok)
+      remove(out_path);
+   return ok ? 0 : 1;
+}
+
+/*---------------------------------------------------------
+** NAME: run_dump
+**
+** PURPOSE:
+**    Print the coefficients of a native byte order binary
+**    polynomial file (-d), e.g. the output of -f.
+**
+** INPUTS:
+**    path  Binary file to print
+**
+** OUTPUTS: Prints "[k] = c" for every coefficient
+**
+** RETURNS: 0 on success, 1 on error
+**
+**-------------------------------------------------------*/
+static int run_dump(const char* path)
+{
+   poly_file f;
+   int64_t k;
+
+   if (poly_file_open(path, &f) != 0)
+      return 1;
+
+   if (f.swapped)
+   {
+      fprintf(stderr, "%s: written with the other byte order\n", path);
+      poly_file_close(&f);
+      return 1;
+   }
+
+   for (k = 0; k < (f.na + f.nb); k++)
+   {
+      if (f.type == POLY_INT32)
+         text_write_coeff(&output, k, ((int32_t*)f.a)[k]);
+      else if (f.type == POLY_INT64)
+         text_write_coeff(&output, k, ((int64_t*)f.a)[k]);
+      else
+         text_write_coeff_double(&output, k, ((double*)f.a)[k]);
+   }
+
+   poly_file_close(&f);
+   return 0;
+}
+
+/*---------------------------------------------------------
+** NAME: run_file
+**
+** PURPOSE:
+**    Binary mode (-f). Multiplies the polynomials of a
+**    binary file into another one with poly_file_mul. The
+**    timed build also prints how long it took.
+**
+** INPUTS:
+**    timed_test  1 to print the elapsed time
+**    in_path     Input file
+**    out_path    Output file
+**
+** OUTPUTS: Writes out_path
+**
+** RETURNS: 0 on success, 1 on error
+**
+**-------------------------------------------------------*/
+static int run_file(int timed_test, const char* in_path, const char* out_path)
+{
+   struct timespec start, end;
+   int ret;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   ret = poly_file_mul(in_path, out_path);
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   if (timed_test && ret == 0)
+   {
+      printf("%s -> %s Time elapsed: %.9f sec\n", in_path, out_path,
+         (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);
+   }
+
+   return (ret == 0) ? 0 : 1;
+}
+#endif
+
 int main(int argc, char* argv[])
 {
    int n;
@@ -15,6 +566,21 @@ int main(int argc, char* argv[])
    int shift_val;
    int coeff;
    int ret_val;
+   int real_path;
+   int exact;
+   int unbalanced;
+   int stream_block;
+   char* file_in;
+   char* file_out;
+   char* convert_out;
+   char* dump_in;
+   int karatsuba_n;
+   int fft_n;
+   int show_precision;
+   long floats, doubles;
+   long allocs;
+   struct timespec start;
+   double secs;
    complex* a;
    complex* b;
    
@@ -24,6 +590,145 @@ int main(int argc, char* argv[])
       timed_test = 0;
 #endif
 
+   /* 
+   ** Command line options. Coefficients are real, so poly_mul_auto is
+   ** used unless a complex FFT engine is requested.
+   */
+   real_path = 1;
+   exact = 0;
+   unbalanced = 0;
+   stream_block = -1;
+   file_in = NULL;
+   file_out = NULL;
+   convert_out = NULL;
+   dump_in = NULL;
+   show_precision = 0;
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-r") == 0)
+      {
+         poly_mul_set_engine(FFT_ENGINE_RECURSIVE);
+         real_path = 0;
+      }
+      else if (strcmp(argv[i], "-i") == 0)
+      {
+         poly_mul_set_engine(FFT_ENGINE_ITERATIVE);
+         real_path = 0;
+      }
+      else if (strcmp(argv[i], "-p") == 0)
+      {
+         poly_mul_set_engine(FFT_ENGINE_PLAN);
+         real_path = 0;
+      }
+      else if (strcmp(argv[i], "-n") == 0)
+         exact = 1;
+      else if (strcmp(argv[i], "-u") == 0)
+         unbalanced = 1;
+      else if (strcmp(argv[i], "-s") == 0 && (i + 1) < argc)
+         stream_block = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-f") == 0 && (i + 2) < argc)
+      {
+         file_in = argv[++i];
+         file_out = argv[++i];
+      }
+      else if (strcmp(argv[i], "-c") == 0 && (i + 1) < argc)
+         convert_out = argv[++i];
+      else if (strcmp(argv[i], "-d") == 0 && (i + 1) < argc)
+         dump_in = argv[++i];
+#ifndef REC_FFT
+      else if (strcmp(argv[i], "-a") == 0)
+         print_all = 1;
+#endif
+      else if (strcmp(argv[i], "-P") == 0 && (i + 1) < argc)
+      {
+         i++;
+         if (strcmp(argv[i], "float") == 0)
+            poly_mul_set_precision(POLY_PRECISION_FLOAT);
+         else if (strcmp(argv[i], "double") == 0)
+            poly_mul_set_precision(POLY_PRECISION_DOUBLE);
+         else
+            poly_mul_set_precision(POLY_PRECISION_AUTO);
+         show_precision = 1;
+      }
+      else if (strcmp(argv[i], "-T") == 0)
+      {
+         /* Autotune poly_mul_auto crossovers and report them */
+         poly_mul_autotune();
+         poly_mul_get_thresholds(&karatsuba_n, &fft_n);
+         printf("POLYMUL_KARATSUBA_MIN=%d POLYMUL_FFT_MIN=%d\n", 
+            karatsuba_n, fft_n);
+      }
+      else if (strcmp(argv[i], "-t") == 0 && (i + 1) < argc)
+         tp_init(atoi(argv[++i]));
+      else
+      {
+         fprintf(stderr, "usage: %s [-r | -i | -p | -n] [-u] [-s block]\n"
+                         "       [-f in out | -c out | -d file] [-a] [-P precision] [-T]\n"
+                         "       [-t threads]\n", argv[0]);
+         fprintf(stderr, "   -r   complex poly_mul, recursive FFT engine\n");
+         fprintf(stderr, "   -i   complex poly_mul, iterative FFT engine\n");
+         fprintf(stderr, "   -p   complex poly_mul, planned iterative FFT engine\n");
+         fprintf(stderr, "   -n   exact integer multiply (NTT)\n");
+         fprintf(stderr, "   (default is poly_mul_auto: schoolbook/Karatsuba/real FFT)\n");
+         fprintf(stderr, "   -u   operands have different lengths (input: na nb a... b...)\n");
+         fprintf(stderr, "   -s   stream stdin (nk, kernel, then input until EOF) in blocks (0: default)\n");
+         fprintf(stderr, "   -f   multiply the binary polynomial file in, write the product to out\n");
+         fprintf(stderr, "   -c   convert stdin polynomials to a binary file for -f\n");
+         fprintf(stderr, "   -d   print the coefficients of a binary file\n");
+         fprintf(stderr, "   -a   print all coefficients (default: x^0 .. x^100)\n");
+         fprintf(stderr, "   -P   auto (float when provably exact: in practice only\n"
+                         "        short 0/1 inputs), float or double; prints how\n"
+                         "        often each precision was used\n");
+         fprintf(stderr, "   -T   autotune the poly_mul_auto crossovers first\n");
+         fprintf(stderr, "   -t   number of threads (default: FFT_THREADS or all CPUs)\n");
+         return 1;
+      }
+   }
+
+#ifndef REC_FFT
+   text_reader_init(&input, stdin);
+   text_writer_init(&output, stdout);
+
+   ret_val = -1;
+   if (file_in)
+      ret_val = run_file(timed_test, file_in, file_out);
+   else if (convert_out)
+      ret_val = run_convert(unbalanced, convert_out);
+   else if (dump_in)
+      ret_val = run_dump(dump_in);
+   else if (stream_block >= 0)
+      ret_val = run_stream(stream_block);
+   else if (exact)
+      ret_val = run_exact(timed_test, unbalanced);
+   else if (real_path)
+      ret_val = run_auto(timed_test, unbalanced);
+
+   /* The complex engines below still use stdio directly */
+   text_writer_close(&output);
+   text_reader_free(&input);
+
+   if (show_precision)
+   {
+      poly_mul_precision_stats(&floats, &doubles);
+      fprintf(stderr, "Precision: float %ld, double %ld\n", floats, doubles);
+   }
+   if (ret_val >= 0)
+      return ret_val;
+#else
+   /* The recursive trace build only runs the complex engines */
+   (void)exact;
+   (void)real_path;
+   (void)unbalanced;
+   (void)stream_block;
+   (void)file_in;
+   (void)file_out;
+   (void)convert_out;
+   (void)dump_in;
+   (void)show_precision;
+   (void)floats;
+   (void)doubles;
+#endif
+
    if (timed_test)
    {
       srand(time(NULL));
@@ -33,10 +738,9 @@ int main(int argc, char* argv[])
       while ((n = (n<<1)) <= MAX_N)
       {
          shift_val++;
-         clock_t start = clock();
          
-         a = (complex*)malloc(2 * n * sizeof(complex));
-         b = (complex*)malloc(2 * n * sizeof(complex));
+         a = (complex*)fft_alloc(2 * n * sizeof(complex));
+         b = (complex*)fft_alloc(2 * n * sizeof(complex));
          
          /* Randomize polynomials to multiply */
          for (i = 0; i < (2*n); i++)
@@ -54,13 +758,17 @@ int main(int argc, char* argv[])
          }
          
          /* Perform polynomial multiplication and place results in a */
+         allocs = fft_alloc_count();
+         clock_gettime(CLOCK_MONOTONIC, &start);
          poly_mul(a, b, 2*n);
+         secs = elapsed(&start);
+         allocs = fft_alloc_count() - allocs;
          
-         free(a);
-         free(b);
+         fft_alloc_free(a);
+         fft_alloc_free(b);
          
-         printf("[N = 2^%-2d = %-7d] Time elapsed: %.9f sec\n", 
-            shift_val, n, ((double)clock() - start) / CLOCKS_PER_SEC);
+         printf("[N = 2^%-2d = %-7d] Time elapsed: %.9f sec (%ld allocations)\n", 
+            shift_val, n, secs, allocs);
       }
    }
    else
@@ -74,8 +782,8 @@ int main(int argc, char* argv[])
          next_power_of_2 <<= 1;
       
       /* Allocate space for polynomials */
-      a = (complex*)malloc(2 * next_power_of_2 * sizeof(complex));
-      b = (complex*)malloc(2 * next_power_of_2 * sizeof(complex));
+      a = (complex*)fft_alloc(2 * next_power_of_2 * sizeof(complex));
+      b = (complex*)fft_alloc(2 * next_power_of_2 * sizeof(complex));
       
       /* Read coefficients from stdin */
       for (i = 0; i < n; i++)
@@ -133,8 +841,8 @@ int main(int argc, char* argv[])
       }
 #endif
 
-      free(a);
-      free(b);
+      fft_alloc_free(a);
+      fft_alloc_free(b);
    }
 
    return 0;
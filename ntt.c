@@ -0,0 +1,396 @@
+#include <stdlib.h>
+#include "common_defs.h"
+#include "ntt.h"
+#include "fft_stats.h"
+
+/*
+** Arithmetic is done in Montgomery form (x*2^32 mod p) so the modular
+** products need no division. The forward transform is decimation in
+** frequency (natural order in, bit-reversed out) and the inverse is
+** decimation in time (bit-reversed in, natural out). The pointwise
+** multiply doesn't care about order, so no bit-reversal pass is needed.
+*/
+
+#define NUM_PRIMES  3
+#define MAX_LG_N    27
+
+/* An NTT-friendly prime p = c*2^k + 1 */
+typedef struct
+{
+   uint32_t p;          /* the prime */
+   uint32_t g;          /* primitive root mod p */
+   int max_lg_n;        /* k: longest transform is 2^k */
+} ntt_prime;
+
+/* Largest transform first; product is about 2^85 */
+static const ntt_prime primes[NUM_PRIMES] =
+{
+   { 469762049u,  3, 26 },   /*  7*2^26 + 1 */
+   { 167772161u,  3, 25 },   /*  5*2^25 + 1 */
+   { 754974721u, 11, 24 },   /* 45*2^24 + 1 */
+};
+
+/* Per prime Montgomery constants and cached twiddle tables */
+typedef struct
+{
+   uint32_t p;
+   uint32_t p_inv;       /* -p^-1 mod 2^32 */
+   uint32_t r2;          /* 2^64 mod p */
+   uint32_t* fwd[MAX_LG_N];   /* forward twiddles per size, n-1 entries */
+   uint32_t* inv[MAX_LG_N];   /* inverse twiddles per size */
+} ntt_field;
+
+static ntt_field fields[NUM_PRIMES];
+static int fields_ready = 0;
+
+/* Work buffers (grow only): 2 transforms plus NUM_PRIMES residues */
+static uint32_t* work = NULL;
+static size_t work_size = 0;
+
+/* mont_reduce - T * 2^-32 mod p, for T < p*2^32 */
+static inline uint32_t mont_reduce(const ntt_field* f, uint64_t t)
+{
+   uint32_t m = (uint32_t)t * f->p_inv;
+   uint32_t r = (uint32_t)((t + (uint64_t)m * f->p) >> 32);
+
+   return (r >= f->p) ? r - f->p : r;
+}
+
+/* mont_mul - a*b*2^-32 mod p */
+static inline uint32_t mont_mul(const ntt_field* f, uint32_t a, uint32_t b)
+{
+   return mont_reduce(f, (uint64_t)a * b);
+}
+
+/* mod_add / mod_sub - a +/- b mod p for a, b < p */
+static inline uint32_t mod_add(uint32_t a, uint32_t b, uint32_t p)
+{
+   uint32_t s = a + b;
+   return (s >= p) ? s - p : s;
+}
+
+static inline uint32_t mod_sub(uint32_t a, uint32_t b, uint32_t p)
+{
+   return (a >= b) ? a - b : a + p - b;
+}
+
+/* pow_mod - b^e mod p (plain, not Montgomery) */
+static uint32_t pow_mod(uint32_t b, uint64_t e, uint32_t p)
+{
+   uint64_t r = 1, x = b % p;
+
+   while (e)
+   {
+      if (e & 1)
+         r = r * x % p;
+      x = x * x % p;
+      e >>= 1;
+   }
+
+   return (uint32_t)r;
+}
+
+/* init_fields - Montgomery constants for every prime */
+static void init_fields(void)
+{
+   ntt_field* f;
+   uint32_t inv;
+   uint64_t r;
+   int i, k;
+
+   for (i = 0; i < NUM_PRIMES; i++)
+   {
+      f = &fields[i];
+      f->p = primes[i].p;
+
+      /* Newton iteration for p^-1 mod 2^32 */
+      inv = f->p;
+      for (k = 0; k < 5; k++)
+         inv *= 2 - f->p * inv;
+      f->p_inv = (uint32_t)(0u - inv);
+
+      r = ((uint64_t)1 << 32) % f->p;
+      f->r2 = (uint32_t)(r * r % f->p);
+   }
+
+   fields_ready = 1;
+}
+
+/* twiddles - per-stage twiddle table (same layout as fft_plan) */
+static uint32_t* twiddles(int prime, int lg_n, int inv)
+{
+   const ntt_prime* q = &primes[prime];
+   ntt_field* f = &fields[prime];
+   uint32_t** cache = inv ? f->inv : f->fwd;
+   uint32_t* table;
+   uint32_t* top;
+   uint32_t w, x;
+   int n = 1 << lg_n;
+   int j, m;
+
+   if (cache[lg_n])
+      return cache[lg_n];
+
+   table = (uint32_t*)fft_malloc((n > 1 ? n-1 : 1) * sizeof(uint32_t));
+
+   /* Principal nth root of unity, in Montgomery form */
+   w = pow_mod(q->g, (q->p - 1) >> lg_n, q->p);
+   if (inv)
+      w = pow_mod(w, q->p - 2, q->p);
+   w = mont_mul(f, w, f->r2);
+
+   /* Largest stage directly, smaller stages subsample it (n = 1 has none) */
+   if (n >= 2)
+   {
+      top = table + (n/2 - 1);
+      x = mont_mul(f, 1, f->r2);
+      for (j = 0; j < (n/2); j++)
+      {
+         top[j] = x;
+         x = mont_mul(f, x, w);
+      }
+      for (m = 2; m < n; m <<= 1)
+      {
+         for (j = 0; j < (m/2); j++)
+            table[m/2 - 1 + j] = top[j * (n/m)];
+      }
+   }
+
+   cache[lg_n] = table;
+   return table;
+}
+
+/* ntt_dif - forward transform, natural order in, bit-reversed out */
+static void ntt_dif(const ntt_field* f, uint32_t* a, int n, const uint32_t* tw)
+{
+   const uint32_t* w;
+   uint32_t p = f->p;
+   uint32_t u, v;
+   int half, j, k;
+
+   for (half = n/2; half >= 1; half >>= 1)
+   {
+      w = tw + (half - 1);
+      for (k = 0; k < n; k += 2*half)
+      {
+         for (j = 0; j < half; j++)
+         {
+            u = a[k+j];
+            v = a[k+j+half];
+            a[k+j]      = mod_add(u, v, p);
+            a[k+j+half] = mont_mul(f, mod_sub(u, v, p), w[j]);
+         }
+      }
+   }
+}
+
+/* ntt_dit - inverse transform, bit-reversed in, natural order out */
+static void ntt_dit(const ntt_field* f, uint32_t* a, int n, const uint32_t* tw)
+{
+   const uint32_t* w;
+   uint32_t p = f->p;
+   uint32_t u, t;
+   int half, j, k;
+
+   for (half = 1; half < n; half <<= 1)
+   {
+      w = tw + (half - 1);
+      for (k = 0; k < n; k += 2*half)
+      {
+         for (j = 0; j < half; j++)
+         {
+            u = a[k+j];
+            t = mont_mul(f, a[k+j+half], w[j]);
+            a[k+j]      = mod_add(u, t, p);
+            a[k+j+half] = mod_sub(u, t, p);
+         }
+      }
+   }
+}
+
+/* to_field - reduce a signed coefficient mod p and enter Montgomery form */
+static inline uint32_t to_field(const ntt_field* f, int64_t v)
+{
+   int64_t r = v % (int64_t)f->p;
+
+   if (r < 0)
+      r += f->p;
+
+   return mont_mul(f, (uint32_t)r, f->r2);
+}
+
+/*
+** convolve
+**
+** Cyclic convolution of length n = 2^lg_n modulo one prime. The inputs
+** are read through one of the two typed pointers so int32 data doesn't
+** need a widening copy. The result (plain, not Montgomery form) is left
+** in out.
+*/
+static void convolve(int prime, int lg_n, 
+                     const int64_t* a64, const int32_t* a32, int na,
+                     const int64_t* b64, const int32_t* b32, int nb,
+                     uint32_t* fb, uint32_t* out)
+{
+   const ntt_field* f = &fields[prime];
+   const uint32_t* fwd = twiddles(prime, lg_n, 0);
+   const uint32_t* inv = twiddles(prime, lg_n, 1);
+   uint32_t n_inv;
+   int n = 1 << lg_n;
+   int j;
+
+   for (j = 0; j < n; j++)
+   {
+      out[j] = (j < na) ? to_field(f, a64 ? a64[j] : a32[j]) : 0;
+      fb[j]  = (j < nb) ? to_field(f, b64 ? b64[j] : b32[j]) : 0;
+   }
+
+   ntt_dif(f, out, n, fwd);
+   ntt_dif(f, fb, n, fwd);
+
+   for (j = 0; j < n; j++)
+      out[j] = mont_mul(f, out[j], fb[j]);
+
+   ntt_dit(f, out, n, inv);
+
+   /* Multiplying by plain n^-1 also leaves Montgomery form */
+   n_inv = pow_mod(n, f->p - 2, f->p);
+   for (j = 0; j < n; j++)
+      out[j] = mont_mul(f, out[j], n_inv);
+}
+
+/* max_abs - largest |coefficient| (as unsigned, so INT64_MIN is fine) */
+static uint64_t max_abs(const int64_t* a64, const int32_t* a32, int n)
+{
+   uint64_t m = 0, v;
+   int64_t x;
+   int j;
+
+   for (j = 0; j < n; j++)
+   {
+      x = a64 ? a64[j] : a32[j];
+      v = (x < 0) ? (uint64_t)0 - (uint64_t)x : (uint64_t)x;
+      if (v > m)
+         m = v;
+   }
+
+   return m;
+}
+
+/* ntt_mul - shared body of poly_mul_ntt and poly_mul_ntt32 */
+static int ntt_mul(const int64_t* a64, const int32_t* a32, int na,
+                   const int64_t* b64, const int32_t* b32, int nb,
+                   int64_t* c)
+{
+   unsigned __int128 bound, modulus, x, half;
+   fft_probe probe;
+   uint32_t* res[NUM_PRIMES];
+   uint64_t t1, t2, p0, p1, p2, inv_p0, inv_p0p1;
+   int num_primes, lg_n, i, j;
+   size_t need;
+
+   if (na <= 0 || nb <= 0)
+      return NTT_BAD_LENGTH;
+
+   if (!fields_ready)
+      init_fields();
+
+   /* |c[k]| <= min(na, nb) * max|a| * max|b| */
+   bound = (unsigned __int128)max_abs(a64, a32, na) * max_abs(b64, b32, nb);
+   if (bound > (unsigned __int128)INT64_MAX / (uint64_t)(na < nb ? na : nb))
+      return NTT_OVERFLOW;
+   bound *= (uint64_t)(na < nb ? na : nb);
+
+   /* Use just enough primes that the signed result fits in (-M/2, M/2) */
+   modulus = 1;
+   for (num_primes = 0; num_primes < NUM_PRIMES; )
+   {
+      modulus *= primes[num_primes++].p;
+      if (bound < modulus/2)
+         break;
+   }
+
+   lg_n = 0;
+   while ((1 << lg_n) < (na + nb - 1))
+      lg_n++;
+   for (i = 0; i < num_primes; i++)
+   {
+      if (lg_n > primes[i].max_lg_n)
+         return NTT_TOO_LONG;
+   }
+
+   fft_probe_begin(&probe);
+
+   /* One scratch transform plus one result per prime */
+   need = (size_t)(num_primes + 1) << lg_n;
+   if (work_size < need)
+   {
+      fft_free(work);
+      work = (uint32_t*)fft_malloc(need * sizeof(uint32_t));
+      work_size = need;
+   }
+   for (i = 0; i < num_primes; i++)
+   {
+      res[i] = work + ((size_t)(i + 1) << lg_n);
+      convolve(i, lg_n, a64, a32, na, b64, b32, nb, work, res[i]);
+   }
+
+   /* Garner's algorithm: x = r0 + p0*t1 + p0*p1*t2 */
+   p0 = primes[0].p;
+   p1 = primes[1].p;
+   p2 = primes[2].p;
+   inv_p0 = pow_mod((uint32_t)(p0 % p1), p1 - 2, p1);
+   inv_p0p1 = pow_mod((uint32_t)(p0 * p1 % p2), p2 - 2, p2);
+   half = modulus/2;
+   for (j = 0; j < (na + nb - 1); j++)
+   {
+      x = res[0][j];
+      if (num_primes > 1)
+      {
+         t1 = (res[1][j] + p1 - x % p1) % p1;
+         t1 = t1 * inv_p0 % p1;
+         x += (unsigned __int128)p0 * t1;
+      }
+      if (num_primes > 2)
+      {
+         t2 = (uint64_t)((res[2][j] + p2 - (uint64_t)(x % p2)) % p2);
+         t2 = t2 * inv_p0p1 % p2;
+         x += (unsigned __int128)p0 * p1 * t2;
+      }
+
+      /* Residues are in [0, M); the upper half is negative */
+      c[j] = (x > half) ? -(int64_t)(modulus - x) : (int64_t)x;
+   }
+
+   fft_probe_end(&probe, FFT_PHASE_NTT, 
+                 (a64 ? 8.0 : 4.0)*(na + nb) + 8.0*(na + nb - 1));
+   return NTT_OK;
+}
+
+/* poly_mul_ntt - see ntt.h for more details */
+int poly_mul_ntt(const int64_t* a, int na, const int64_t* b, int nb, 
+                 int64_t* c)
+{
+   return ntt_mul(a, NULL, na, b, NULL, nb, c);
+}
+
+/* poly_mul_ntt32 - see ntt.h for more details */
+int poly_mul_ntt32(const int32_t* a, int na, const int32_t* b, int nb, 
+                   int64_t* c)
+{
+   return ntt_mul(NULL, a, na, NULL, b, nb, c);
+}
+
+/* ntt_strerror - see ntt.h for more details */
+const char* ntt_strerror(int ret)
+{
+   switch (ret)
+   {
+      case NTT_OK:         return "success";
+      case NTT_OVERFLOW:   return "product does not fit in 64-bit integers";
+      case NTT_TOO_LONG:   return "product is too long for the exact (NTT) "
+                                  "multiply";
+      case NTT_BAD_LENGTH: return "empty polynomial";
+   }
+   return "unknown error";
+}
@@ -0,0 +1,50 @@
+#ifndef NTT_H
+#define NTT_H
+
+#include <stdint.h>
+
+/* Return codes of poly_mul_ntt and poly_mul_ntt32 */
+#define NTT_OK          0
+#define NTT_OVERFLOW   -1   /* product could overflow int64_t */
+#define NTT_TOO_LONG   -2   /* transform longer than the primes allow */
+#define NTT_BAD_LENGTH -3   /* na or nb < 1 */
+
+/*---------------------------------------------------------
+** NAME: poly_mul_ntt
+**
+** PURPOSE:
+**    Exact multiplication of integer polynomials with the
+**    Number Theoretic Transform. The convolution is done 
+**    modulo up to three NTT-friendly primes (as many as 
+**    the coefficient bound needs) and the result is put 
+**    back together with the Chinese Remainder Theorem, so
+**    there is no floating point rounding.
+**
+** INPUTS:
+**    a     Coefficients of the first polynomial
+**    na    Number of coefficients in a
+**    b     Coefficients of the second polynomial
+**    nb    Number of coefficients in b
+**
+** OUTPUTS:
+**    c     na+nb-1 coefficients of a*b. User must allocate
+**          this memory.
+**
+** RETURNS: NTT_OK on success, NTT_OVERFLOW if the product
+**          could overflow int64_t, NTT_TOO_LONG if the
+**          transform would be too long (more than 2^24
+**          points when three primes are needed),
+**          NTT_BAD_LENGTH for an empty polynomial
+**
+**-------------------------------------------------------*/
+int poly_mul_ntt(const int64_t* a, int na, const int64_t* b, int nb, 
+                 int64_t* c);
+
+/* poly_mul_ntt32 - same as poly_mul_ntt for int32_t coefficients */
+int poly_mul_ntt32(const int32_t* a, int na, const int32_t* b, int nb, 
+                   int64_t* c);
+
+/* ntt_strerror - message for a return code of poly_mul_ntt */
+const char* ntt_strerror(int ret);
+
+#endif
@@ -0,0 +1,1337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "cl_engine.h"
+
+#define MAX_SOURCE_SIZE (0x100000)
+
+// Local memory used by fft_local (the block is also capped at 8 elements
+// per work item)
+#define MAX_LOCAL_BYTES 32768
+
+// First bytes of a binary cache file (followed by the 64-bit key and the
+// program binary)
+#define CACHE_MAGIC     "CLFFTBIN"
+
+static const char* kernel_names[NUM_KERNELS] =
+   { "bitrev_permute_x2", "parallel_fft_x2", "pointwise_mul",
+     "inverse_parallel_fft", "fft_radix2", "fft_radix4", "fft_radix8",
+     "fft_local" };
+
+// Function prototypes
+static int pick_device(cl_platform_id* p, cl_device_id* d);
+static cl_int build_program(cl_engine* e, int constant);
+static unsigned long long cache_key(cl_engine* e, const char* options);
+static cl_program load_binary(cl_engine* e, const char* path,
+                              const char* options, unsigned long long key);
+static void save_binary(cl_program program, const char* path,
+                        unsigned long long key);
+static cl_mem get_twiddles(cl_engine* e, int lg_n);
+static void launch(cl_engine* e, cl_kernel kernel, cl_uint dims,
+                   size_t global, size_t count, size_t local, int phase);
+static cl_event* next_event(cl_engine* e, int phase);
+static size_t local_size(cl_engine_program* p, int k, size_t global);
+static cl_mem enqueue_legacy(cl_engine* e, cl_engine_program* p, cl_mem* mem,
+                             cl_mem twiddles, int lg_n);
+static cl_mem enqueue_local(cl_engine* e, cl_engine_program* p, cl_mem* mem,
+                            cl_mem twiddles, int lg_n);
+static void enqueue_passes(cl_engine* e, cl_engine_program* p, cl_mem data1,
+                           cl_mem data2, int vectors, cl_mem twiddles,
+                           int lg_n, float sign, float scale,
+                           unsigned int dif, int phase);
+static void abort_jobs(cl_engine* e);
+static double event_sec(cl_event e);
+static void swap_mem_ptr(cl_mem* a, cl_mem* b);
+
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_create
+//
+// PURPOSE: See cl_engine.h
+//-----------------------------------------------------------------------------
+cl_engine* cl_engine_create(const char* source_path, const char* cache_dir,
+                            int kernels)
+{
+   cl_engine* e;
+   FILE* fp;
+   cl_int ret;
+
+   e = (cl_engine*)calloc(1, sizeof(cl_engine));
+   e->kernels = kernels;
+   e->num_slots = 1;
+   if (cache_dir && cache_dir[0])
+      e->cache_dir = strdup(cache_dir);
+
+   // Load kernel code into buffer
+   fp = fopen(source_path, "r");
+   if (!fp)
+   {
+      fprintf(stderr, "Failed to load kernel.\n");
+      cl_engine_release(e);
+      return NULL;
+   }
+   e->source = (char*)malloc(MAX_SOURCE_SIZE);
+   e->source_size = fread(e->source, 1, MAX_SOURCE_SIZE, fp);
+   fclose(fp);
+
+   // Get platform and device information
+   if (pick_device(&e->platform, &e->device) != 0)
+   {
+      fprintf(stderr, "No OpenCL device found.\n");
+      cl_engine_release(e);
+      return NULL;
+   }
+   clGetDeviceInfo(e->device, CL_DEVICE_LOCAL_MEM_SIZE,
+                   sizeof(e->local_mem_size), &e->local_mem_size, NULL);
+   clGetDeviceInfo(e->device, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE,
+                   sizeof(e->constant_mem_size), &e->constant_mem_size, NULL);
+   clGetDeviceInfo(e->device, CL_DEVICE_MAX_WORK_GROUP_SIZE,
+                   sizeof(e->group_size), &e->group_size, NULL);
+
+   // Create an OpenCL context, the kernel queue and the transfer queues
+   // of the pipeline
+   e->context = clCreateContext(NULL, 1, &e->device, NULL, NULL, &ret);
+   if (ret == CL_SUCCESS)
+      e->queue = clCreateCommandQueue(e->context, e->device,
+                                      CL_QUEUE_PROFILING_ENABLE, &ret);
+   if (ret == CL_SUCCESS)
+      e->upload_queue = clCreateCommandQueue(e->context, e->device, 0, &ret);
+   if (ret == CL_SUCCESS)
+      e->download_queue = clCreateCommandQueue(e->context, e->device, 0, &ret);
+   if (ret != CL_SUCCESS)
+   {
+      fprintf(stderr, "Failed to create the OpenCL context (error %d).\n",
+              (int)ret);
+      cl_engine_release(e);
+      return NULL;
+   }
+
+   return e;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_release
+//
+// PURPOSE: See cl_engine.h
+//-----------------------------------------------------------------------------
+void cl_engine_release(cl_engine* e)
+{
+   int i, k;
+
+   if (!e)
+      return;
+
+   cl_engine_finish(e);
+   if (e->upload_queue)
+      clReleaseCommandQueue(e->upload_queue);
+   if (e->download_queue)
+      clReleaseCommandQueue(e->download_queue);
+   if (e->queue)
+   {
+      clFinish(e->queue);
+      clReleaseCommandQueue(e->queue);
+   }
+
+   // Release kernels and programs
+   for (i=0; i<2; i++)
+   {
+      for (k=0; k<NUM_KERNELS; k++)
+      {
+         if (e->programs[i].kernels[k])
+            clReleaseKernel(e->programs[i].kernels[k]);
+      }
+      if (e->programs[i].program)
+         clReleaseProgram(e->programs[i].program);
+   }
+
+   // Release device memory
+   for (i=0; i<MAX_SLOTS; i++)
+   {
+      for (k=0; k<4; k++)
+      {
+         if (e->slots[i].mem[k])
+            clReleaseMemObject(e->slots[i].mem[k]);
+      }
+   }
+   for (i=0; i<=MAX_LG; i++)
+   {
+      if (e->twiddles[i])
+         clReleaseMemObject(e->twiddles[i]);
+   }
+
+   if (e->context)
+      clReleaseContext(e->context);
+
+   // Free host memory
+   free(e->host[0]);
+   free(e->host[1]);
+   free(e->source);
+   free(e->cache_dir);
+   free(e);
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_prepare
+//
+// PURPOSE: See cl_engine.h
+//-----------------------------------------------------------------------------
+cl_int cl_engine_prepare(cl_engine* e, int lg_n)
+{
+   size_t fft_size = (size_t)1 << lg_n;
+   cl_engine_slot* slot;
+   cl_int ret = CL_SUCCESS;
+   int constant;
+   int i, k;
+
+   if (lg_n < 0 || lg_n > MAX_LG)
+      return CL_INVALID_VALUE;
+
+   // The twiddle table goes in constant memory if it fits
+   constant = (fft_size / 2) * sizeof(cl_float2) <= e->constant_mem_size;
+   if (!e->programs[constant].program)
+   {
+      ret = build_program(e, constant);
+      if (ret != CL_SUCCESS)
+         return ret;
+   }
+   e->constant_twiddles = constant;
+
+   if (!get_twiddles(e, lg_n))
+      return CL_OUT_OF_RESOURCES;
+
+   // Device buffers only grow (a buffer still used by a job in flight
+   // is freed by the runtime once the job is done)
+   for (i=0; i<e->num_slots; i++)
+   {
+      slot = &e->slots[i];
+      if (fft_size <= slot->size)
+         continue;
+
+      for (k=0; k<4; k++)
+      {
+         if (slot->mem[k])
+            clReleaseMemObject(slot->mem[k]);
+         slot->mem[k] = clCreateBuffer(e->context, CL_MEM_READ_WRITE,
+                                       fft_size * sizeof(cl_float2), NULL, &ret);
+         if (ret != CL_SUCCESS)
+         {
+            for (; k>=0; k--)
+            {
+               if (slot->mem[k])
+                  clReleaseMemObject(slot->mem[k]);
+               slot->mem[k] = NULL;
+            }
+            slot->size = 0;
+            return ret;
+         }
+      }
+      slot->size = fft_size;
+   }
+
+   return CL_SUCCESS;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_multiply
+//
+// PURPOSE: See cl_engine.h
+//-----------------------------------------------------------------------------
+cl_int cl_engine_multiply(cl_engine* e, const cl_float2* in1,
+                          const cl_float2* in2, int lg_n, cl_float2* out,
+                          double* times)
+{
+   size_t bytes = ((size_t)1 << lg_n) * sizeof(cl_float2);
+   cl_engine_program* p;
+   cl_mem twiddles;
+   cl_mem final_output = NULL;
+   cl_mem* mem;
+   cl_int ret;
+   int i;
+
+   // Slot 0 may still be in the pipeline
+   ret = cl_engine_finish(e);
+   if (ret == CL_SUCCESS)
+      ret = cl_engine_prepare(e, lg_n);
+   if (ret != CL_SUCCESS)
+      return ret;
+   p = &e->programs[e->constant_twiddles];
+   twiddles = e->twiddles[lg_n];
+   mem = e->slots[0].mem;
+
+   e->num_events = 0;
+   e->num_launches = 0;
+   e->profile = (times != NULL);
+   e->error = CL_SUCCESS;
+
+   // Transfer host memory to device
+   ret = clEnqueueWriteBuffer(e->queue, mem[0], CL_TRUE, 0, bytes, in1,
+                              0, NULL, next_event(e, PHASE_UPLOAD));
+   if (ret == CL_SUCCESS)
+      ret = clEnqueueWriteBuffer(e->queue, mem[1], CL_TRUE, 0, bytes, in2,
+                                 0, NULL, next_event(e, PHASE_UPLOAD));
+
+   // Bit reversal, FFT, pointwise multiplication and inverse FFT
+   if (ret == CL_SUCCESS)
+   {
+      if (e->kernels == KERNELS_LEGACY)
+         final_output = enqueue_legacy(e, p, mem, twiddles, lg_n);
+      else
+         final_output = enqueue_local(e, p, mem, twiddles, lg_n);
+      ret = e->error;
+   }
+
+   // Transfer device memory to host
+   if (ret == CL_SUCCESS)
+      ret = clEnqueueReadBuffer(e->queue, final_output, CL_TRUE, 0, bytes,
+                                out, 0, NULL, next_event(e, PHASE_DOWNLOAD));
+   if (ret != CL_SUCCESS)
+      clFinish(e->queue);
+
+   // Sum the device time of each phase
+   if (times)
+   {
+      for (i=0; i<NUM_PHASES; i++)
+      {
+         if (i != PHASE_TOTAL)
+            times[i] = 0.0;
+      }
+      for (i=0; i<e->num_events; i++)
+      {
+         if (ret == CL_SUCCESS)
+            times[e->event_phase[i]] += event_sec(e->events[i]);
+         clReleaseEvent(e->events[i]);
+      }
+   }
+   e->num_events = 0;
+
+   return ret;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_poly_mul
+//
+// PURPOSE: See cl_engine.h
+//-----------------------------------------------------------------------------
+cl_int cl_engine_poly_mul(cl_engine* e, const float* a, int na,
+                          const float* b, int nb, float* c)
+{
+   size_t fft_size = 1;
+   int lg_n = 0;
+   int i;
+   cl_int ret;
+
+   if (na < 1 || nb < 1)
+      return CL_INVALID_VALUE;
+
+   while (fft_size < (size_t)(na + nb - 1))
+   {
+      fft_size <<= 1;
+      lg_n++;
+   }
+   if (lg_n > MAX_LG)
+      return CL_INVALID_VALUE;
+
+   // Host staging only grows
+   if (fft_size > e->host_size)
+   {
+      for (i=0; i<2; i++)
+      {
+         free(e->host[i]);
+         e->host[i] = (cl_float2*)malloc(fft_size * sizeof(cl_float2));
+      }
+      e->host_size = fft_size;
+   }
+
+   // Zero-padded complex inputs
+   memset(e->host[0], 0, fft_size * sizeof(cl_float2));
+   memset(e->host[1], 0, fft_size * sizeof(cl_float2));
+   for (i=0; i<na; i++)
+      e->host[0][i].x = a[i];
+   for (i=0; i<nb; i++)
+      e->host[1][i].x = b[i];
+
+   ret = cl_engine_multiply(e, e->host[0], e->host[1], lg_n, e->host[0], NULL);
+   if (ret != CL_SUCCESS)
+      return ret;
+
+   for (i=0; i<na+nb-1; i++)
+      c[i] = e->host[0][i].x;
+
+   return CL_SUCCESS;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_set_slots
+//
+// PURPOSE: See cl_engine.h
+//-----------------------------------------------------------------------------
+cl_int cl_engine_set_slots(cl_engine* e, int slots)
+{
+   cl_int ret;
+
+   if (slots < 1 || slots > MAX_SLOTS)
+      return CL_INVALID_VALUE;
+
+   ret = cl_engine_finish(e);
+   e->num_slots = slots;
+   e->next_slot = 0;
+
+   return ret;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_submit
+//
+// PURPOSE: See cl_engine.h
+//-----------------------------------------------------------------------------
+cl_int cl_engine_submit(cl_engine* e, const cl_float2* in1,
+                        const cl_float2* in2, int lg_n, cl_float2* out)
+{
+   size_t bytes = ((size_t)1 << lg_n) * sizeof(cl_float2);
+   cl_engine_slot* slot;
+   cl_mem final_output = NULL;
+   cl_event uploaded = NULL;
+   cl_int ret;
+
+   ret = cl_engine_prepare(e, lg_n);
+   if (ret != CL_SUCCESS)
+      return ret;
+
+   // Wait for the job that used the slot last: its buffers are reused and
+   // its output is complete from here on
+   slot = &e->slots[e->next_slot];
+   e->next_slot = (e->next_slot + 1) % e->num_slots;
+   if (slot->done)
+   {
+      ret = clWaitForEvents(1, &slot->done);
+      clReleaseEvent(slot->done);
+      slot->done = NULL;
+      if (ret != CL_SUCCESS)
+      {
+         abort_jobs(e);
+         return ret;
+      }
+   }
+
+   // Upload on the upload queue (in order, so the event of the second
+   // copy is the end of both)
+   ret = clEnqueueWriteBuffer(e->upload_queue, slot->mem[0], CL_FALSE, 0,
+                              bytes, in1, 0, NULL, NULL);
+   if (ret == CL_SUCCESS)
+      ret = clEnqueueWriteBuffer(e->upload_queue, slot->mem[1], CL_FALSE, 0,
+                                 bytes, in2, 0, NULL, &uploaded);
+
+   // Kernels on the kernel queue, after the upload
+   if (ret == CL_SUCCESS)
+   {
+      e->num_events = 0;
+      e->num_launches = 0;
+      e->profile = 0;
+      e->error = CL_SUCCESS;
+      e->wait_event = uploaded;
+      e->keep_last = 1;
+      if (e->kernels == KERNELS_LEGACY)
+         final_output = enqueue_legacy(e, &e->programs[e->constant_twiddles],
+                                       slot->mem, e->twiddles[lg_n], lg_n);
+      else
+         final_output = enqueue_local(e, &e->programs[e->constant_twiddles],
+                                      slot->mem, e->twiddles[lg_n], lg_n);
+      e->wait_event = NULL;
+      e->keep_last = 0;
+      ret = e->error;
+   }
+   if (uploaded)
+      clReleaseEvent(uploaded);
+
+   // Download on the download queue, after the last kernel
+   if (ret == CL_SUCCESS)
+      ret = clEnqueueReadBuffer(e->download_queue, final_output, CL_FALSE, 0,
+                                bytes, out, 1, &e->last_event, &slot->done);
+   if (e->last_event)
+      clReleaseEvent(e->last_event);
+   e->last_event = NULL;
+
+   if (ret != CL_SUCCESS)
+   {
+      abort_jobs(e);
+      return ret;
+   }
+
+   // Start all three without waiting
+   clFlush(e->upload_queue);
+   clFlush(e->queue);
+   clFlush(e->download_queue);
+
+   return CL_SUCCESS;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_finish
+//
+// PURPOSE: See cl_engine.h
+//-----------------------------------------------------------------------------
+cl_int cl_engine_finish(cl_engine* e)
+{
+   cl_int ret = CL_SUCCESS;
+   cl_int status;
+   int i;
+
+   for (i=0; i<MAX_SLOTS; i++)
+   {
+      if (!e->slots[i].done)
+         continue;
+
+      status = clWaitForEvents(1, &e->slots[i].done);
+      if (status != CL_SUCCESS && ret == CL_SUCCESS)
+         ret = status;
+      clReleaseEvent(e->slots[i].done);
+      e->slots[i].done = NULL;
+   }
+
+   return ret;
+}
+
+
+// Drain all queues after a failed enqueue and forget the jobs in flight
+static void abort_jobs(cl_engine* e)
+{
+   int i;
+
+   clFinish(e->upload_queue);
+   clFinish(e->queue);
+   clFinish(e->download_queue);
+   for (i=0; i<MAX_SLOTS; i++)
+   {
+      if (e->slots[i].done)
+         clReleaseEvent(e->slots[i].done);
+      e->slots[i].done = NULL;
+   }
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: build_program
+//
+// PURPOSE:
+//    Creates one of the engine's programs: from the binary cache if it
+//    holds a build for this device, driver, source and options, otherwise
+//    from the source (and then stores the binary in the cache). Creates
+//    one kernel object per function and sizes the fft_local block: the
+//    largest power of 2 that fits in MAX_LOCAL_BYTES (and the device's
+//    local memory) with at most 8 elements per work item.
+//
+// INPUT:
+//    e        Engine
+//    constant 1 to put the twiddle table in constant memory
+//
+// OUTPUT: e->programs[constant]
+//
+// RETURNS: CL_SUCCESS or an OpenCL error code
+//-----------------------------------------------------------------------------
+static cl_int build_program(cl_engine* e, int constant)
+{
+   cl_engine_program* p = &e->programs[constant];
+   const char* options = constant ? "-D TWIDDLE_SPACE=__constant" : "";
+   const char* src = e->source;
+   size_t max_bytes = MAX_LOCAL_BYTES;
+   unsigned long long key = 0;
+   char* path = NULL;
+   char* build_log;
+   size_t log_size;
+   size_t items;
+   cl_int ret = CL_SUCCESS;
+   int k;
+
+   if (e->cache_dir)
+   {
+      key = cache_key(e, options);
+      path = (char*)malloc(strlen(e->cache_dir) + 64);
+      sprintf(path, "%s/parallel_fft-%016llx.clbin", e->cache_dir, key);
+      p->program = load_binary(e, path, options, key);
+      p->from_cache = (p->program != NULL);
+   }
+
+   if (!p->program)
+   {
+      // Create and build the program from the kernel source
+      p->program = clCreateProgramWithSource(e->context, 1, &src,
+                                             &e->source_size, &ret);
+      if (ret == CL_SUCCESS)
+         ret = clBuildProgram(p->program, 1, &e->device, options, NULL, NULL);
+
+      // Show the build log if there is one
+      if (p->program)
+      {
+         log_size = 0;
+         clGetProgramBuildInfo(p->program, e->device, CL_PROGRAM_BUILD_LOG,
+                               0, NULL, &log_size);
+         build_log = malloc(log_size+1);
+         clGetProgramBuildInfo(p->program, e->device, CL_PROGRAM_BUILD_LOG,
+                               log_size, build_log, NULL);
+         build_log[log_size] = 0;
+         if (strspn(build_log, " \t\r\n") < strlen(build_log))
+            printf("%s\n", build_log);
+         free(build_log);
+      }
+
+      if (ret != CL_SUCCESS)
+      {
+         fprintf(stderr, "Failed to build kernels (error %d).\n", (int)ret);
+         if (p->program)
+            clReleaseProgram(p->program);
+         p->program = NULL;
+         free(path);
+         return ret;
+      }
+
+      if (path)
+         save_binary(p->program, path, key);
+   }
+   free(path);
+
+   // One kernel object per function, whatever the arguments, and the
+   // largest power of 2 work group it can run with: register or local
+   // memory use can keep a kernel below the device maximum
+   for (k=0; k<NUM_KERNELS; k++)
+   {
+      p->kernels[k] = clCreateKernel(p->program, kernel_names[k], &ret);
+      if (ret != CL_SUCCESS)
+         return ret;
+
+      items = e->group_size;
+      clGetKernelWorkGroupInfo(p->kernels[k], e->device,
+                               CL_KERNEL_WORK_GROUP_SIZE, sizeof(items),
+                               &items, NULL);
+      if (items > e->group_size)
+         items = e->group_size;
+      p->group_items[k] = 1;
+      while (2*p->group_items[k] <= items)
+         p->group_items[k] <<= 1;
+   }
+   p->local_items = p->group_items[KERNEL_LOCAL];
+
+   // Block size
+   if (e->local_mem_size < max_bytes)
+      max_bytes = e->local_mem_size;
+   p->lg_block = 0;
+   while (((size_t)2 << p->lg_block) <= 8*p->local_items &&
+          ((size_t)2 << p->lg_block) * sizeof(cl_float2) <= max_bytes)
+      p->lg_block++;
+
+   return CL_SUCCESS;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: cache_key
+//
+// PURPOSE:
+//    64-bit FNV-1a hash of everything a program binary depends on: the
+//    platform, the device and its driver version, the build options and
+//    the kernel source.
+//
+// INPUT:
+//    e        Engine
+//    options  Build options
+//
+// OUTPUT: none
+//
+// RETURNS: Cache key
+//-----------------------------------------------------------------------------
+static unsigned long long cache_key(cl_engine* e, const char* options)
+{
+   static const cl_device_info device_infos[3] =
+      { CL_DEVICE_NAME, CL_DEVICE_VERSION, CL_DRIVER_VERSION };
+   unsigned long long h = 14695981039346656037ULL;
+   char info[1024];
+   const char* parts[6];
+   size_t sizes[6];
+   size_t i, j;
+
+   for (i=0; i<6; i++)
+   {
+      info[0] = 0;
+      if (i == 0)
+         clGetPlatformInfo(e->platform, CL_PLATFORM_NAME, sizeof(info), info,
+                           NULL);
+      else if (i < 4)
+         clGetDeviceInfo(e->device, device_infos[i-1], sizeof(info), info,
+                         NULL);
+      info[sizeof(info) - 1] = 0;
+
+      parts[i] = (i < 4) ? info : (i == 4) ? options : e->source;
+      sizes[i] = (i < 5) ? strlen(parts[i]) + 1 : e->source_size;
+      for (j=0; j<sizes[i]; j++)
+      {
+         h ^= (unsigned char)parts[i][j];
+         h *= 1099511628211ULL;
+      }
+   }
+
+   return h;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: load_binary
+//
+// PURPOSE: Creates and builds a program from a binary cache file
+//
+// INPUT:
+//    e        Engine
+//    path     Cache file
+//    options  Build options
+//    key      Cache key the file must have been written with
+//
+// OUTPUT: none
+//
+// RETURNS: Built program, NULL if the file is missing, stale or rejected
+//          by the driver
+//-----------------------------------------------------------------------------
+static cl_program load_binary(cl_engine* e, const char* path,
+                              const char* options, unsigned long long key)
+{
+   char magic[8];
+   unsigned long long file_key;
+   unsigned char* binary;
+   size_t size;
+   long end;
+   cl_program program;
+   cl_int status, ret;
+   FILE* fp;
+
+   fp = fopen(path, "rb");
+   if (!fp)
+      return NULL;
+
+   if (fread(magic, 1, 8, fp) != 8 || memcmp(magic, CACHE_MAGIC, 8) != 0 ||
+       fread(&file_key, sizeof(file_key), 1, fp) != 1 || file_key != key ||
+       fseek(fp, 0, SEEK_END) != 0 || (end = ftell(fp)) <= 16)
+   {
+      fclose(fp);
+      return NULL;
+   }
+
+   size = (size_t)end - 16;
+   binary = (unsigned char*)malloc(size);
+   fseek(fp, 16, SEEK_SET);
+   if (fread(binary, 1, size, fp) != size)
+   {
+      fclose(fp);
+      free(binary);
+      return NULL;
+   }
+   fclose(fp);
+
+   program = clCreateProgramWithBinary(e->context, 1, &e->device, &size,
+         (const unsigned char**)&binary, &status, &ret);
+   free(binary);
+   if (ret != CL_SUCCESS || status != CL_SUCCESS)
+   {
+      if (program)
+         clReleaseProgram(program);
+      return NULL;
+   }
+
+   // Binaries still have to be built
+   if (clBuildProgram(program, 1, &e->device, options, NULL, NULL) != CL_SUCCESS)
+   {
+      clReleaseProgram(program);
+      return NULL;
+   }
+
+   return program;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: save_binary
+//
+// PURPOSE:
+//    Writes the binary of a built program to the cache. The file is
+//    written under a temporary name with the process id in it and
+//    renamed, so concurrent runs never write to or see a partial file.
+//    Failures are ignored (the cache is optional).
+//
+// INPUT:
+//    program  Program built for the engine's device
+//    path     Cache file
+//    key      Cache key
+//
+// OUTPUT: Cache file
+//
+// RETURNS: void
+//-----------------------------------------------------------------------------
+static void save_binary(cl_program program, const char* path,
+                        unsigned long long key)
+{
+   unsigned char* binary;
+   size_t size = 0;
+   char* tmp;
+   FILE* fp;
+   int ok;
+
+   if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size),
+                        &size, NULL) != CL_SUCCESS || size == 0)
+      return;
+
+   binary = (unsigned char*)malloc(size);
+   if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binary),
+                        &binary, NULL) != CL_SUCCESS)
+   {
+      free(binary);
+      return;
+   }
+
+   tmp = (char*)malloc(strlen(path) + 32);
+   sprintf(tmp, "%s.tmp%ld", path, (long)getpid());
+   fp = fopen(tmp, "wb");
+   if (fp)
+   {
+      ok = fwrite(CACHE_MAGIC, 1, 8, fp) == 8 &&
+           fwrite(&key, sizeof(key), 1, fp) == 1 &&
+           fwrite(binary, 1, size, fp) == size;
+      if (fclose(fp) != 0)
+         ok = 0;
+      if (!ok || rename(tmp, path) != 0)
+         remove(tmp);
+   }
+
+   free(tmp);
+   free(binary);
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: get_twiddles
+//
+// PURPOSE:
+//    Returns the read-only device buffer of twiddle factors
+//    e ^ (2*pi*i*j/n), j < n/2, for FFT size n = 2^lg_n. The table is
+//    computed in double precision on the host (so every entry is the
+//    correctly rounded float, where cospi/sinpi on the device may be off
+//    by several ulps), uploaded once, and kept in e->twiddles for every
+//    later multiplication of the same size. Kernels of smaller stages
+//    index it with a stride.
+//
+// INPUT:
+//    e        Engine
+//    lg_n     log2 of the FFT size
+//
+// OUTPUT: e->twiddles[lg_n]
+//
+// RETURNS: Buffer of n/2 float2 (NULL on failure)
+//-----------------------------------------------------------------------------
+static cl_mem get_twiddles(cl_engine* e, int lg_n)
+{
+   size_t half = ((size_t)1 << lg_n) / 2;
+   cl_float2* table;
+   cl_int ret;
+   size_t j;
+
+   if (e->twiddles[lg_n])
+      return e->twiddles[lg_n];
+
+   if (half == 0)
+      half = 1;
+   table = (cl_float2*)malloc(half * sizeof(cl_float2));
+   for (j = 0; j < half; j++)
+   {
+      table[j].x = (float)cos(M_PI * j / half);
+      table[j].y = (float)sin(M_PI * j / half);
+   }
+
+   e->twiddles[lg_n] = clCreateBuffer(e->context,
+         CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, half * sizeof(cl_float2),
+         table, &ret);
+   free(table);
+
+   if (ret != CL_SUCCESS)
+      e->twiddles[lg_n] = NULL;
+   return e->twiddles[lg_n];
+}
+
+
+// Event for the next command (NULL when not profiling)
+static cl_event* next_event(cl_engine* e, int phase)
+{
+   if (!e->profile || e->num_events >= MAX_COMMANDS)
+      return NULL;
+
+   e->event_phase[e->num_events] = phase;
+   return &e->events[e->num_events++];
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: launch
+//
+// PURPOSE:
+//    Enqueues one kernel launch. The kernel's arguments must be set just
+//    before: they are captured at enqueue, so the next launch can set
+//    them again on the same kernel object. The launch waits for
+//    e->wait_event if there is one (the kernel queue is in order, so the
+//    launches after it wait too), and with e->keep_last its event is kept
+//    in e->last_event.
+//
+// INPUT:
+//    e        Engine
+//    kernel   Kernel (arguments set)
+//    dims     Number of NDRange dimensions (1 or 2)
+//    global   Work items in the first dimension
+//    count    Work items in the second dimension (vectors processed)
+//    local    Work group size in the first dimension
+//    phase    Phase the launch is timed under
+//
+// OUTPUT: e->last_event, e->error on failure
+//
+// RETURNS: void
+//-----------------------------------------------------------------------------
+static void launch(cl_engine* e, cl_kernel kernel, cl_uint dims,
+                   size_t global, size_t count, size_t local, int phase)
+{
+   size_t global_size[2] = { global, count };
+   size_t local_size[2] = { local, 1 };
+   cl_event* event = next_event(e, phase);
+   cl_event last = NULL;
+   cl_int ret;
+
+   if (!event && e->keep_last)
+      event = &last;
+
+   ret = clEnqueueNDRangeKernel(e->queue, kernel, dims, NULL, global_size,
+                                local_size, e->wait_event ? 1 : 0,
+                                e->wait_event ? &e->wait_event : NULL, event);
+   e->wait_event = NULL;
+   if (ret != CL_SUCCESS && e->error == CL_SUCCESS)
+      e->error = ret;
+   e->num_launches++;
+
+   if (e->keep_last && ret == CL_SUCCESS)
+   {
+      if (e->last_event)
+         clReleaseEvent(e->last_event);
+      if (event != &last)
+         clRetainEvent(*event);
+      e->last_event = *event;
+   }
+}
+
+
+// local_size - work group of kernel k for a launch of global work items
+static size_t local_size(cl_engine_program* p, int k, size_t global)
+{
+   return (global >= p->group_items[k]) ? p->group_items[k] : global;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: enqueue_legacy
+//
+// PURPOSE:
+//    Enqueues one multiplication with one radix-2 kernel per FFT stage:
+//    bit reversal, lg(n) forward stages, pointwise multiplication, bit
+//    reversal and lg(n) inverse stages, each reading the previous output
+//    (the input and output buffers are swapped after every kernel).
+//
+// INPUT:
+//    e        Engine
+//    p        Program
+//    mem      in1, in2, out1, out2 device buffers (the polynomials are
+//             uploaded to in1 and in2)
+//    twiddles Twiddle table (get_twiddles)
+//    lg_n     log2 of the FFT size
+//
+// OUTPUT: 2*lg(n) + 3 launches enqueued
+//
+// RETURNS: Buffer that holds the product
+//-----------------------------------------------------------------------------
+static cl_mem enqueue_legacy(cl_engine* e, cl_engine_program* p, cl_mem* mem,
+                             cl_mem twiddles, int lg_n)
+{
+   cl_mem in_mem_obj1 = mem[0];
+   cl_mem in_mem_obj2 = mem[1];
+   cl_mem out_mem_obj1 = mem[2];
+   cl_mem out_mem_obj2 = mem[3];
+   size_t fft_size = (size_t)1 << lg_n;
+   cl_kernel kernel;
+   unsigned int n;
+   int i;
+
+   //---------------------------
+   // Bit-Reverse Permutation
+   //---------------------------
+   kernel = p->kernels[KERNEL_BITREV];
+   clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&in_mem_obj1);
+   clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&in_mem_obj2);
+   clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&out_mem_obj1);
+   clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&out_mem_obj2);
+   clSetKernelArg(kernel, 4, sizeof(unsigned int), (void*)&lg_n);
+   launch(e, kernel, 1, fft_size, 1, local_size(p, KERNEL_BITREV, fft_size),
+          PHASE_BITREV);
+
+   // Swap device memory pointers (output of this will be input to parallel-fft)
+   swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
+   swap_mem_ptr(&in_mem_obj2, &out_mem_obj2);
+
+   //---------------------------
+   // lg(n) FFT stages
+   //---------------------------
+   kernel = p->kernels[KERNEL_FFT_X2];
+   for (i=0; i<lg_n; i++)
+   {
+      n = (1 << (i+1)); // double n for each stage of FFT (2,4,8,16...)
+      clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&in_mem_obj1);
+      clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&in_mem_obj2);
+      clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&out_mem_obj1);
+      clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&out_mem_obj2);
+      clSetKernelArg(kernel, 4, sizeof(unsigned int), (void*)&n);
+      clSetKernelArg(kernel, 5, sizeof(cl_mem), (void *)&twiddles);
+      launch(e, kernel, 1, fft_size, 1, local_size(p, KERNEL_FFT_X2, fft_size),
+             PHASE_FFT);
+
+      // Swap memory pointers (output of this stage will be input of next)
+      swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
+      swap_mem_ptr(&in_mem_obj2, &out_mem_obj2);
+   }
+
+   //---------------------------
+   // Point-wise multiplication
+   //---------------------------
+   kernel = p->kernels[KERNEL_POINTWISE];
+   clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&in_mem_obj1);
+   clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&in_mem_obj2);
+   clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&out_mem_obj1);
+   launch(e, kernel, 1, fft_size, 1, local_size(p, KERNEL_POINTWISE, fft_size),
+          PHASE_POINTWISE);
+
+   // Swap memory pointers (output of this stage will be input of next)
+   swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
+
+   //---------------------------
+   // Bit-Reverse Permutation
+   //---------------------------
+   // NOTE: We're using the bitrev_permute_x2 kernel function, but we
+   //       are only concerned with bit reversing in_mem_obj1.
+   kernel = p->kernels[KERNEL_BITREV];
+   clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&in_mem_obj1);
+   clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&in_mem_obj2);
+   clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&out_mem_obj1);
+   clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&out_mem_obj2);
+   clSetKernelArg(kernel, 4, sizeof(unsigned int), (void*)&lg_n);
+   launch(e, kernel, 1, fft_size, 1, local_size(p, KERNEL_BITREV, fft_size),
+          PHASE_BITREV);
+
+   // Swap device memory pointers (output of this will be input to inverse parallel-fft)
+   swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
+
+   //---------------------------
+   // lg(n) inverse-FFT stages
+   //---------------------------
+   kernel = p->kernels[KERNEL_INVERSE];
+   for (i=0; i<lg_n; i++)
+   {
+      n = (1 << (i+1)); // double n for each stage of FFT (2,4,8,16...)
+      clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&in_mem_obj1);
+      clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&out_mem_obj1);
+      clSetKernelArg(kernel, 2, sizeof(unsigned int), (void*)&n);
+      clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&twiddles);
+      launch(e, kernel, 1, fft_size, 1, local_size(p, KERNEL_INVERSE, fft_size),
+             PHASE_INVERSE);
+
+      // Swap memory pointers (output of this stage will be input of next)
+      swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
+   }
+
+   // one final swap
+   swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
+   return out_mem_obj1;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: enqueue_local
+//
+// PURPOSE:
+//    Enqueues one multiplication with the multi-stage kernels: the forward
+//    FFT of both vectors in place by decimation in frequency (natural
+//    order in, bit-reversed out), pointwise multiplication into out1 and
+//    the inverse FFT of out1 in place by decimation in time (bit-reversed
+//    in, natural out). The spectra are never put in natural order, so
+//    there is no bit reversal kernel.
+//
+// INPUT:
+//    e        Engine
+//    p        Program
+//    mem      in1, in2, out1, out2 device buffers (the polynomials are
+//             uploaded to in1 and in2)
+//    twiddles Twiddle table (get_twiddles)
+//    lg_n     log2 of the FFT size
+//
+// OUTPUT: Launches enqueued
+//
+// RETURNS: Buffer that holds the product
+//-----------------------------------------------------------------------------
+static cl_mem enqueue_local(cl_engine* e, cl_engine_program* p, cl_mem* mem,
+                            cl_mem twiddles, int lg_n)
+{
+   size_t fft_size = (size_t)1 << lg_n;
+   cl_kernel kernel;
+
+   // Forward FFT of both, in frequency
+   enqueue_passes(e, p, mem[0], mem[1], 2, twiddles, lg_n,
+                  1.0f, 1.0f, 1, PHASE_FFT);
+
+   // Point-wise multiplication into out1
+   kernel = p->kernels[KERNEL_POINTWISE];
+   clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&mem[0]);
+   clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&mem[1]);
+   clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&mem[2]);
+   launch(e, kernel, 1, fft_size, 1, local_size(p, KERNEL_POINTWISE, fft_size),
+          PHASE_POINTWISE);
+
+   // Inverse FFT in time, divided by n on the last pass
+   enqueue_passes(e, p, mem[2], mem[2], 1, twiddles, lg_n,
+                  -1.0f, 1.0f / fft_size, 0, PHASE_INVERSE);
+
+   return mem[2];
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: enqueue_passes
+//
+// PURPOSE:
+//    Enqueues one in-place FFT of one or two vectors. fft_local does the
+//    lg(block) smallest stages in local memory (see build_program for the
+//    block size). fft_radix8 does the others three stages per pass, with
+//    one fft_radix4 or fft_radix2 pass for the remainder, so the transform
+//    takes about 1 + (lg(n) - lg(block)) / 3 passes over global memory
+//    instead of lg(n). In time (bit-reversed input) the local pass comes
+//    first and the radix passes go up; in frequency (natural input) the
+//    radix passes go down and the local pass is last.
+//
+// INPUT:
+//    e        Engine
+//    p        Program
+//    data1    First vector
+//    data2    Second vector (ignored if vectors is 1)
+//    vectors  Number of vectors to transform (1 or 2)
+//    twiddles Twiddle table (get_twiddles)
+//    lg_n     log2 of the FFT size
+//    sign     1 for the forward FFT, -1 for the inverse
+//    scale    Factor applied on the last pass
+//    dif      1 for decimation in frequency, 0 for decimation in time
+//    phase    Phase the launches are timed under
+//
+// OUTPUT: Launches enqueued
+//
+// RETURNS: void
+//-----------------------------------------------------------------------------
+static void enqueue_passes(cl_engine* e, cl_engine_program* p, cl_mem data1,
+                           cl_mem data2, int vectors, cl_mem twiddles,
+                           int lg_n, float sign, float scale,
+                           unsigned int dif, int phase)
+{
+   size_t fft_size = (size_t)1 << lg_n;
+   size_t items = p->local_items;
+   size_t global;
+   unsigned int lg_b, s, lg_r, done;
+   float pass_scale;
+   cl_kernel kernel;
+   cl_kernel local_kernel = p->kernels[KERNEL_LOCAL];
+
+   //---------------------------
+   // Stages in local memory
+   //---------------------------
+   lg_b = ((int)p->lg_block < lg_n) ? p->lg_block : (unsigned int)lg_n;
+   while (items > 1 && 8*items > ((size_t)1 << lg_b))
+      items >>= 1;
+
+   if (!dif)
+   {
+      pass_scale = ((int)lg_b == lg_n) ? scale : 1.0f;
+      clSetKernelArg(local_kernel, 0, sizeof(cl_mem), (void *)&data1);
+      clSetKernelArg(local_kernel, 1, sizeof(cl_mem), (void *)&data2);
+      clSetKernelArg(local_kernel, 2, ((size_t)1 << lg_b) * sizeof(cl_float2), NULL);
+      clSetKernelArg(local_kernel, 3, sizeof(cl_mem), (void *)&twiddles);
+      clSetKernelArg(local_kernel, 4, sizeof(unsigned int), (void*)&lg_b);
+      clSetKernelArg(local_kernel, 5, sizeof(unsigned int), (void*)&lg_n);
+      clSetKernelArg(local_kernel, 6, sizeof(float), (void*)&sign);
+      clSetKernelArg(local_kernel, 7, sizeof(float), (void*)&pass_scale);
+      clSetKernelArg(local_kernel, 8, sizeof(unsigned int), (void*)&dif);
+      launch(e, local_kernel, 2, (fft_size >> lg_b) * items, vectors, items,
+             phase);
+   }
+
+   //---------------------------
+   // Other stages, 3 per pass
+   //---------------------------
+   for (done = lg_b; (int)done < lg_n; done += lg_r)
+   {
+      lg_r = (lg_n - done < 3) ? lg_n - done : 3;
+      s = dif ? lg_n + lg_b - done - lg_r : done; // smallest stage of the pass
+      kernel = p->kernels[KERNEL_RADIX2 + lg_r - 1];
+
+      pass_scale = (!dif && (int)(done + lg_r) == lg_n) ? scale : 1.0f;
+      clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&data1);
+      clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&data2);
+      clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&twiddles);
+      clSetKernelArg(kernel, 3, sizeof(unsigned int), (void*)&s);
+      clSetKernelArg(kernel, 4, sizeof(unsigned int), (void*)&lg_n);
+      clSetKernelArg(kernel, 5, sizeof(float), (void*)&sign);
+      clSetKernelArg(kernel, 6, sizeof(float), (void*)&pass_scale);
+      clSetKernelArg(kernel, 7, sizeof(unsigned int), (void*)&dif);
+
+      global = fft_size >> lg_r;
+      launch(e, kernel, 2, global, vectors,
+             local_size(p, KERNEL_RADIX2 + lg_r - 1, global), phase);
+   }
+
+   if (dif)
+   {
+      pass_scale = scale;
+      clSetKernelArg(local_kernel, 0, sizeof(cl_mem), (void *)&data1);
+      clSetKernelArg(local_kernel, 1, sizeof(cl_mem), (void *)&data2);
+      clSetKernelArg(local_kernel, 2, ((size_t)1 << lg_b) * sizeof(cl_float2), NULL);
+      clSetKernelArg(local_kernel, 3, sizeof(cl_mem), (void *)&twiddles);
+      clSetKernelArg(local_kernel, 4, sizeof(unsigned int), (void*)&lg_b);
+      clSetKernelArg(local_kernel, 5, sizeof(unsigned int), (void*)&lg_n);
+      clSetKernelArg(local_kernel, 6, sizeof(float), (void*)&sign);
+      clSetKernelArg(local_kernel, 7, sizeof(float), (void*)&pass_scale);
+      clSetKernelArg(local_kernel, 8, sizeof(unsigned int), (void*)&dif);
+      launch(e, local_kernel, 2, (fft_size >> lg_b) * items, vectors, items,
+             phase);
+   }
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: pick_device
+//
+// PURPOSE: Finds a compute device: the first GPU of any platform, or else
+//          the first device of any type (e.g. a CPU runtime such as PoCL)
+//
+// INPUT: none
+//
+// OUTPUT:
+//    p     Platform ID
+//    d     Compute Device
+//
+// RETURNS: 0 on success, -1 if there is no device
+//-----------------------------------------------------------------------------
+static int pick_device(cl_platform_id* p, cl_device_id* d)
+{
+   cl_platform_id platforms[16];
+   cl_uint num_platforms = 0;
+   cl_uint num_devices;
+   int pass, i;
+
+   if (clGetPlatformIDs(16, platforms, &num_platforms) != CL_SUCCESS)
+      return -1;
+   if (num_platforms > 16)
+      num_platforms = 16;
+
+   for (pass = 0; pass < 2; pass++)
+   {
+      for (i = 0; i < (int)num_platforms; i++)
+      {
+         if (clGetDeviceIDs(platforms[i],
+                            pass ? CL_DEVICE_TYPE_ALL : CL_DEVICE_TYPE_GPU,
+                            1, d, &num_devices) == CL_SUCCESS && num_devices)
+         {
+            *p = platforms[i];
+            return 0;
+         }
+      }
+   }
+
+   return -1;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_print_info
+//
+// PURPOSE: Prints the specifications of the engine's compute device
+//
+// INPUT:
+//    e     Engine
+//
+// OUTPUT:
+//    Prints device specifications to stdout
+//
+// RETURNS: void
+//-----------------------------------------------------------------------------
+void cl_engine_print_info(cl_engine* e)
+{
+   cl_device_id d = e->device;
+   cl_device_type type = 0;
+   char vendor[1024];
+   char device_ver[1024];
+   char device_name[1024];
+   cl_uint num_cores;
+   cl_long global_mem;
+   cl_uint clk_freq;
+   cl_uint item_dim;
+   size_t* item_sizes;
+   cl_uint i;
+
+   clGetPlatformInfo(e->platform, CL_PLATFORM_VENDOR, sizeof(vendor), vendor, NULL);
+   printf("-------------------------------------------------\n");
+   printf("Platform Vendor: %s\n", vendor);
+
+   clGetDeviceInfo(d, CL_DEVICE_NAME, sizeof(device_name), device_name, NULL);
+   clGetDeviceInfo(d, CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+   clGetDeviceInfo(d, CL_DEVICE_VENDOR, sizeof(vendor), vendor, NULL);
+   clGetDeviceInfo(d, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(num_cores), &num_cores, NULL);
+   clGetDeviceInfo(d, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(global_mem), &global_mem, NULL);
+   clGetDeviceInfo(d, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(clk_freq), &clk_freq, NULL);
+   clGetDeviceInfo(d, CL_DEVICE_VERSION, sizeof(device_ver), device_ver, NULL);
+   clGetDeviceInfo(d, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, sizeof(item_dim), &item_dim, NULL);
+   item_sizes = malloc(item_dim * sizeof(size_t));
+   clGetDeviceInfo(d, CL_DEVICE_MAX_WORK_ITEM_SIZES, item_dim * sizeof(size_t), item_sizes, NULL);
+
+   printf("   Name: %s\n", device_name);
+   printf("   Type: %s\n", (type & CL_DEVICE_TYPE_GPU) ? "GPU" :
+                         (type & CL_DEVICE_TYPE_CPU) ? "CPU" : "other");
+   printf("   Vendor: %s\n", vendor);
+   printf("   Compute Units: %u\n", num_cores);
+   printf("   Global Memory: %d bytes\n", (int)global_mem);
+   printf("   Max Clock Freq: %d MHz\n", (int)clk_freq);
+   printf("   Local Memory: %d bytes\n", (int)e->local_mem_size);
+   printf("   Constant Memory: %d bytes\n", (int)e->constant_mem_size);
+   printf("   Work Group Size: %d\n", (int)e->group_size);
+   for (i=0; i < item_dim; i++)
+      printf("   Dim %u Work Items: %d\n", i+1, (int)item_sizes[i]);
+   printf("   Device Version: %s\n", device_ver);
+   printf("-------------------------------------------------\n");
+   free(item_sizes);
+}
+
+// Device execution time of a finished command, in seconds
+static double event_sec(cl_event e)
+{
+   cl_ulong start = 0, end = 0;
+
+   clGetEventProfilingInfo(e, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+   clGetEventProfilingInfo(e, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+   return (end - start) * 1e-9;
+}
+
+// Swap cl_mem pointers
+static void swap_mem_ptr(cl_mem* a, cl_mem* b)
+{
+   cl_mem temp = *a;
+   *a = *b;
+   *b = temp;
+}
@@ -0,0 +1,276 @@
+#ifndef CL_ENGINE_H
+#define CL_ENGINE_H
+
+#if defined __APPLE__ || defined(MACOSX)
+   #include <OpenCL/opencl.h>
+#else
+   #include <CL/cl.h>
+#endif
+
+// Kernel sets (-k)
+#define KERNELS_LEGACY  0    // one radix-2 kernel per stage
+#define KERNELS_LOCAL   1    // local memory and radix-8 multi-stage kernels
+
+// Largest lg(FFT size) (-n 28 doubles to 2^29)
+#define MAX_LG          29
+
+// Timed phases of one multiplication (TOTAL is host wall-clock time and
+// is not filled in by the engine)
+#define PHASE_UPLOAD    0
+#define PHASE_BITREV    1
+#define PHASE_FFT       2
+#define PHASE_POINTWISE 3
+#define PHASE_INVERSE   4
+#define PHASE_DOWNLOAD  5
+#define PHASE_TOTAL     6
+#define NUM_PHASES      7
+
+// Kernel functions of parallel_fft.cl (index into cl_engine_program.kernels)
+#define KERNEL_BITREV     0
+#define KERNEL_FFT_X2     1
+#define KERNEL_POINTWISE  2
+#define KERNEL_INVERSE    3
+#define KERNEL_RADIX2     4
+#define KERNEL_RADIX4     5
+#define KERNEL_RADIX8     6
+#define KERNEL_LOCAL      7
+#define NUM_KERNELS       8
+
+// Most commands one multiplication enqueues (legacy kernels: two uploads,
+// 2*lg(n) + 3 kernels and one download)
+#define MAX_COMMANDS    (2*MAX_LG + 6)
+
+// Most buffer sets of the job pipeline (see cl_engine_set_slots)
+#define MAX_SLOTS       3
+
+// One build of parallel_fft.cl and one kernel object per function
+typedef struct
+{
+   cl_program program;              // NULL until first used
+   cl_kernel kernels[NUM_KERNELS];
+   size_t group_items[NUM_KERNELS]; // largest power of 2 work group of each
+   size_t local_items;              // largest fft_local work group
+   unsigned int lg_block;           // log2 of the largest fft_local block
+   int from_cache;                  // 1 if loaded from the binary cache
+} cl_engine_program;
+
+// Device buffers of one job in flight
+typedef struct
+{
+   cl_mem mem[4];                   // in1, in2, out1, out2
+   size_t size;                     // float2 per buffer
+   cl_event done;                   // download of the slot's last job
+} cl_engine_slot;
+
+// Everything that outlives one multiplication
+typedef struct
+{
+   cl_platform_id platform;
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;          // kernels; in order, profiling enabled
+   cl_command_queue upload_queue;   // host to device copies of the pipeline
+   cl_command_queue download_queue; // device to host copies of the pipeline
+
+   // max work group size, local and constant memory of the device
+   size_t group_size;
+   cl_ulong local_mem_size;
+   cl_ulong constant_mem_size;
+
+   int kernels;                     // KERNELS_LEGACY or KERNELS_LOCAL
+   char* source;                    // parallel_fft.cl
+   size_t source_size;
+   char* cache_dir;                 // binary cache directory, NULL if off
+
+   // Programs with the twiddle table in global [0] and constant [1] memory
+   cl_engine_program programs[2];
+
+   // Twiddle tables by lg(FFT size) (see get_twiddles)
+   cl_mem twiddles[MAX_LG + 1];
+
+   // Buffer sets (cl_engine_multiply uses slots[0]), the number the
+   // pipeline cycles through and the slot of the next job
+   cl_engine_slot slots[MAX_SLOTS];
+   int num_slots;
+   int next_slot;
+
+   // Host staging of cl_engine_poly_mul and its size in float2
+   cl_float2* host[2];
+   size_t host_size;
+
+   // Profiling events of the current multiplication and their phases
+   cl_event events[MAX_COMMANDS];
+   int event_phase[MAX_COMMANDS];
+   int num_events;
+   int profile;
+
+   // Event the next kernel launch waits for, and the event of the last
+   // launch when keep_last is set (pipeline)
+   cl_event wait_event;
+   cl_event last_event;
+   int keep_last;
+
+   // Last multiplication: kernel launches, twiddles in constant memory,
+   // and the first error of an enqueue
+   int num_launches;
+   int constant_twiddles;
+   cl_int error;
+} cl_engine;
+
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_create
+//
+// PURPOSE:
+//    Picks a device (the first GPU of any platform, or else the first
+//    device of any type, e.g. a CPU runtime such as PoCL), creates the
+//    context and command queue and loads the kernel source. Programs,
+//    kernels, twiddle tables and buffers are made on first use and kept
+//    for every later multiplication.
+//
+//    Compiled programs are cached on disk as CL_PROGRAM_BINARIES in
+//    cache_dir, one file per device, driver, build options and source
+//    (parallel_fft-<hash>.clbin), so only the first run on a machine
+//    pays for clBuildProgram.
+//
+// INPUT:
+//    source_path Kernel source (parallel_fft.cl)
+//    cache_dir   Binary cache directory (NULL or "" for no cache)
+//    kernels     KERNELS_LEGACY or KERNELS_LOCAL
+//
+// OUTPUT: none
+//
+// RETURNS: New engine, NULL if there is no device or no source
+//-----------------------------------------------------------------------------
+cl_engine* cl_engine_create(const char* source_path, const char* cache_dir,
+                            int kernels);
+
+// cl_engine_release - release every OpenCL object and free the engine
+void cl_engine_release(cl_engine* e);
+
+// cl_engine_print_info - print the specifications of the engine's device
+void cl_engine_print_info(cl_engine* e);
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_prepare
+//
+// PURPOSE:
+//    Builds (or loads from the cache) the program for FFT size 2^lg_n and
+//    creates its kernels, twiddle table and the buffers of every slot, so
+//    that the first multiplication of that size does no setup.
+//    cl_engine_multiply and cl_engine_submit call it themselves.
+//
+// INPUT:
+//    e        Engine
+//    lg_n     log2 of the FFT size
+//
+// OUTPUT: Programs, twiddle table and buffers of e
+//
+// RETURNS: CL_SUCCESS or an OpenCL error code
+//-----------------------------------------------------------------------------
+cl_int cl_engine_prepare(cl_engine* e, int lg_n);
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_multiply
+//
+// PURPOSE:
+//    Multiplies two zero-padded coefficient vectors of FFT size 2^lg_n:
+//    uploads them, enqueues the FFTs, the pointwise multiplication and the
+//    inverse FFT (arguments are set on the engine's kernels for every
+//    launch) and reads the product back. Jobs still in the pipeline are
+//    finished first.
+//
+// INPUT:
+//    e        Engine
+//    in1      First vector, 2^lg_n float2 (upper half zero)
+//    in2      Second vector, 2^lg_n float2 (upper half zero)
+//    lg_n     log2 of the FFT size
+//    times    NULL, or NUM_PHASES device times in seconds to fill in from
+//             profiling events (all but PHASE_TOTAL)
+//
+// OUTPUT:
+//    out      Product, 2^lg_n float2 (may be in1 or in2)
+//
+// RETURNS: CL_SUCCESS or an OpenCL error code
+//-----------------------------------------------------------------------------
+cl_int cl_engine_multiply(cl_engine* e, const cl_float2* in1,
+                          const cl_float2* in2, int lg_n, cl_float2* out,
+                          double* times);
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_poly_mul
+//
+// PURPOSE:
+//    Multiplies two polynomials with real coefficients on the device. The
+//    FFT size is the smallest power of 2 that holds the product; host
+//    staging, device buffers and kernels are reused between calls.
+//
+// INPUT:
+//    e        Engine
+//    a        Coefficients of the first polynomial (x^0 first)
+//    na       Number of coefficients of a
+//    b        Coefficients of the second polynomial (x^0 first)
+//    nb       Number of coefficients of b
+//
+// OUTPUT:
+//    c        na + nb - 1 product coefficients (may not overlap a or b)
+//
+// RETURNS: CL_SUCCESS or an OpenCL error code
+//-----------------------------------------------------------------------------
+cl_int cl_engine_poly_mul(cl_engine* e, const float* a, int na,
+                          const float* b, int nb, float* c);
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_set_slots
+//
+// PURPOSE:
+//    Sets the number of buffer sets cl_engine_submit cycles through:
+//    1 runs the jobs one after the other, 2 (double buffering) overlaps
+//    the transfers of one job with the kernels of another, 3 (triple
+//    buffering) lets the upload of job k+1, the kernels of job k and the
+//    download of job k-1 run at the same time. Jobs in flight are
+//    finished first.
+//
+// INPUT:
+//    e        Engine
+//    slots    1 to MAX_SLOTS
+//
+// OUTPUT: e->num_slots
+//
+// RETURNS: CL_SUCCESS or an OpenCL error code
+//-----------------------------------------------------------------------------
+cl_int cl_engine_set_slots(cl_engine* e, int slots);
+
+//-----------------------------------------------------------------------------
+// NAME: cl_engine_submit
+//
+// PURPOSE:
+//    Starts one multiplication of a stream without waiting for it, like
+//    cl_engine_multiply. The job takes the next slot. Its upload, kernels
+//    and download go to three queues as non-blocking commands, each
+//    waiting on the event of the one before. The host only waits when a
+//    slot comes round again: for the download of the job that used the
+//    slot num_slots jobs earlier.
+//
+//    in1 and in2 must not change, and out must not be read, until the job
+//    is done: after num_slots more submits have returned, or after
+//    cl_engine_finish.
+//
+// INPUT:
+//    e        Engine
+//    in1      First vector, 2^lg_n float2 (upper half zero)
+//    in2      Second vector, 2^lg_n float2 (upper half zero)
+//    lg_n     log2 of the FFT size
+//
+// OUTPUT:
+//    out      Product, 2^lg_n float2 (must not overlap in1 or in2)
+//
+// RETURNS: CL_SUCCESS or an OpenCL error code
+//-----------------------------------------------------------------------------
+cl_int cl_engine_submit(cl_engine* e, const cl_float2* in1,
+                        const cl_float2* in2, int lg_n, cl_float2* out);
+
+// cl_engine_finish - wait for every submitted job (CL_SUCCESS or an error)
+cl_int cl_engine_finish(cl_engine* e);
+
+#endif
@@ -1,58 +1,132 @@
 #include <stdio.h>
 #include <stdlib.h>
-#if defined __APPLE__ || defined(MACOSX)
-   #include <OpenCL/opencl.h>
-#else
-   #include <CL/cl.h>
-#endif
+#include <string.h>
 #include <time.h>
+#include "cl_engine.h"
+
+// Product coefficients compared with the exact ones
+#define NUM_CHECKS      16
 
-#define MAX_SOURCE_SIZE (0x100000)
+// Default buffer sets of the job pipeline (-s)
+#define DEFAULT_SLOTS   3
+
+static const char* phase_names[NUM_PHASES] = 
+   { "upload", "bitrev", "fft", "pointwise", "inverse", "download", "total" };
 
 // Function prototypes
-static void print_device_info(cl_platform_id p, cl_device_id d);
+static double check_product(int size);
 static int get_input_polynomials();
-static void swap_mem_ptr(cl_mem* a, cl_mem* b);
 static int gen_polynomials();
+static double now_sec(void);
+static int run_jobs(cl_engine* engine, int jobs, int slots, int fft_size, 
+                    int lg_n);
+static void report(FILE* csv, const char* phase, int n, double* samples, 
+                   int count, double flops, double bytes);
 
-// Global coefficient arrays
+// Global coefficient arrays (the product is read back into poly1_out)
 cl_float2* poly1;
 cl_float2* poly2;
-
-// max work group size
-size_t group_size;
+cl_float2* poly1_out;
 
 
 //-----------------------------------------------------------------------------
 // NAME: main
 //
 // PURPOSE:
-//    Compiles OpenCL kernels, creates device memory buffers, 
-//    creates kernel instances, deploys kernels to GPU, and 
-//    verifies results.
+//    Creates an OpenCL engine (cl_engine.h) on a GPU if there is one,
+//    otherwise on e.g. a CPU runtime such as PoCL, runs polynomial
+//    multiplications on it and verifies results. The compiled program is
+//    cached on disk, so only the first run on a machine compiles
+//    parallel_fft.cl.
 //
 //    High-Level Algorithm:
 //       1. Get polynomials from user
-//       2. Compile the kernels and create device memory
-//       3. Create kernel instances
-//             a. Bit-reverse permutation
-//             b. lg(n) FFT stages for both polynomials
+//       2. Create the engine and prepare it for the size (program built
+//          or loaded from the binary cache, kernels, twiddles, buffers)
+//       3. Multiply (warm-up runs, then timed runs with per-phase device
+//          times from profiling events); each multiplication enqueues
+//             a. Bit-reverse permutation (-k legacy only)
+//             b. lg(n) FFT stages for both polynomials: one kernel per
+//                stage (-k legacy), or three stages per kernel and the
+//                ones that fit in local memory in one kernel, decimated
+//                in frequency (-k local)
 //             c. Point-wise multiplication of two polynomials
-//             d. Bit-reverse permutation
-//             e. lg(n) inverse-FFT stages
-//       4. Deploy kernel instances to GPU
-//       5. Verify results
-//       6. Clean up
+//             d. Bit-reverse permutation (-k legacy only)
+//             e. lg(n) inverse-FFT stages (grouped the same way,
+//                decimated in time)
+//       4. Verify results
+//       5. Optionally time repeated cl_engine_poly_mul calls (-p)
+//       6. Optionally run a stream of jobs through the pipeline (-j)
+//       7. Clean up
 //
-// INPUT: void
+// INPUT:
+//    -n lg       Polynomial size 2^lg (default 24)
+//    -r reps     Timed runs (default 5)
+//    -w warmup   Untimed runs first (default 1)
+//    -c file     Also write the timings as CSV
+//    -k set      Kernels: local (default) or legacy
+//    -p calls    Also time this many cl_engine_poly_mul calls
+//    -j jobs     Also run this many multiplications pipelined and one at
+//                a time, and report jobs per second
+//    -s slots    Buffer sets of the pipeline, 1 to 3 (default 3)
 //
-// OUTPUT: Prints device specs and results of polynomial multiplication
+//    FFT_CL_CACHE  Binary cache directory (default ".", empty for none)
+//
+// OUTPUT: Prints device specs, the setup time, the median/p90/p99 time,
+//         GFLOP/s and GB/s of each phase, and the error of sampled product
+//         coefficients
 //
 // RETURNS: 0 on success, error code otherwise
 //----------------------------------------------------------------------------- 
 int main(int argc, char* argv[]) 
 {
    int i;
+   int poly_lg = 24;
+   int reps = 5;
+   int warmup = 1;
+   int calls = 0;
+   int jobs = 0;
+   int slots = DEFAULT_SLOTS;
+   int kernels = KERNELS_LOCAL;
+   const char* csv_path = NULL;
+   const char* cache_dir;
+   
+   for (i=1; i<argc; i++)
+   {
+      if (strcmp(argv[i], "-n") == 0 && (i+1) < argc)
+         poly_lg = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-r") == 0 && (i+1) < argc)
+         reps = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-w") == 0 && (i+1) < argc)
+         warmup = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-c") == 0 && (i+1) < argc)
+         csv_path = argv[++i];
+      else if (strcmp(argv[i], "-p") == 0 && (i+1) < argc)
+         calls = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-j") == 0 && (i+1) < argc)
+         jobs = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-s") == 0 && (i+1) < argc)
+         slots = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-k") == 0 && (i+1) < argc)
+      {
+         i++;
+         if (strcmp(argv[i], "legacy") == 0)
+            kernels = KERNELS_LEGACY;
+         else if (strcmp(argv[i], "local") == 0)
+            kernels = KERNELS_LOCAL;
+         else
+            poly_lg = -1;
+      }
+      else
+         poly_lg = -1;
+   }
+   if (poly_lg < 0 || poly_lg > 28 || reps < 1 || warmup < 0 || calls < 0 ||
+       jobs < 0 || slots < 1 || slots > MAX_SLOTS)
+   {
+      fprintf(stderr, "usage: %s [-n lg] [-r reps] [-w warmup] [-c file.csv] "
+              "[-k local|legacy] [-p calls] [-j jobs] [-s slots]\n", argv[0]);
+      return 1;
+   }
    
    ////////////////////////////////////
    //
@@ -60,7 +134,8 @@ int main(int argc, char* argv[])
    //
    ////////////////////////////////////
    //int fft_size = 2 * get_input_polynomials();
-   int fft_size = 2 * gen_polynomials((1<<24));
+   int fft_size = 2 * gen_polynomials(1 << poly_lg);
+   poly1_out = (cl_float2*)malloc(fft_size * sizeof(cl_float2));
    
    // Calculate log (base 2) of fft_size
    int lg_n = 0;
@@ -73,261 +148,246 @@ int main(int argc, char* argv[])
    
    ////////////////////////////////////
    //
-   // Compile the kernels and create device memory
+   // Create and prepare the engine
    //
    ////////////////////////////////////
-    
-   // Load kernel code into buffer
-   FILE *fp;
-   char *source_str;
-   size_t source_size;
-
-   fp = fopen("parallel_fft.cl", "r");
-   if (!fp) 
+   cache_dir = getenv("FFT_CL_CACHE");
+   if (!cache_dir)
+      cache_dir = ".";
+   
+   double setup = now_sec();
+   cl_engine* engine = cl_engine_create("parallel_fft.cl", cache_dir, kernels);
+   if (!engine)
+      exit(1);
+   cl_int ret = cl_engine_prepare(engine, lg_n);
+   setup = now_sec() - setup;
+   cl_engine_print_info(engine);
+   if (ret != CL_SUCCESS)
    {
-      fprintf(stderr, "Failed to load kernel.\n");
+      fprintf(stderr, "Failed to prepare the engine (error %d).\n", (int)ret);
+      cl_engine_release(engine);
       exit(1);
    }
-   source_str = (char*)malloc(MAX_SOURCE_SIZE);
-   source_size = fread(source_str, 1, MAX_SOURCE_SIZE, fp);
-   fclose( fp );
- 
-   // Get platform and device information
-   cl_platform_id platform_id = NULL;
-   cl_device_id device_id = NULL;   
-   cl_uint ret_num_devices;
-   cl_uint ret_num_platforms;
-   cl_int ret = clGetPlatformIDs(1, &platform_id, &ret_num_platforms);
-   ret = clGetDeviceIDs( platform_id, CL_DEVICE_TYPE_GPU, 1, &device_id, &ret_num_devices);
-   print_device_info(platform_id, device_id);
- 
-   // Create an OpenCL context and command queue
-   cl_context context = clCreateContext( NULL, 1, &device_id, NULL, NULL, &ret);
-   cl_command_queue command_queue = clCreateCommandQueue(context, device_id, 0, &ret);
-
-   // Create and build the program from the kernel source
-   cl_program program = clCreateProgramWithSource(context, 1, 
-         (const char **)&source_str, (const size_t *)&source_size, &ret);
-   ret = clBuildProgram(program, 1, &device_id, NULL, NULL, NULL);
-
-   // Show the build log
-   char* build_log;
-   size_t log_size;
-   clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
-   build_log = malloc(log_size+1);
-   clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, log_size, build_log, NULL);
-   build_log[log_size] = 0;
-   printf("%s\n",build_log);
-   free(build_log);
-   
-   // Allocate memory on device for coefficient array input and output
-   cl_mem in_mem_obj1 = clCreateBuffer(context, CL_MEM_READ_WRITE, 
-         fft_size * sizeof(cl_float2), NULL, &ret);
-   cl_mem in_mem_obj2 = clCreateBuffer(context, CL_MEM_READ_WRITE, 
-         fft_size * sizeof(cl_float2), NULL, &ret);
-   cl_mem out_mem_obj1 = clCreateBuffer(context, CL_MEM_READ_WRITE,
-         fft_size * sizeof(cl_float2), NULL, &ret);
-   cl_mem out_mem_obj2 = clCreateBuffer(context, CL_MEM_READ_WRITE,
-         fft_size * sizeof(cl_float2), NULL, &ret);
-   cl_mem initial_input1 = in_mem_obj1;
-   cl_mem initial_input2 = in_mem_obj2;
-
+   printf("setup: %.3f s, program %s\n", setup, 
+          engine->programs[engine->constant_twiddles].from_cache ? 
+          "loaded from the binary cache" : "built from source");
+   
    ////////////////////////////////////
    //
-   // Create kernel instances
+   // Multiply on the device
    //
    ////////////////////////////////////
+   double* times[NUM_PHASES];
+   double sample[NUM_PHASES];
+   for (i=0; i<NUM_PHASES; i++)
+      times[i] = (double*)calloc(reps, sizeof(double));
    
-   //---------------------------
-   // Bit-Reverse Permutation
-   //---------------------------
-   cl_kernel bitrev_kernel1 = clCreateKernel(program, "bitrev_permute_x2", &ret);
-
-   // Set the arguments of the kernel
-   ret = clSetKernelArg(bitrev_kernel1, 0, sizeof(cl_mem), (void *)&in_mem_obj1);
-   ret = clSetKernelArg(bitrev_kernel1, 1, sizeof(cl_mem), (void *)&in_mem_obj2);
-   ret = clSetKernelArg(bitrev_kernel1, 2, sizeof(cl_mem), (void *)&out_mem_obj1);
-   ret = clSetKernelArg(bitrev_kernel1, 3, sizeof(cl_mem), (void *)&out_mem_obj2);
-   ret = clSetKernelArg(bitrev_kernel1, 4, sizeof(unsigned int), (void*)&lg_n);
-         
-   // Swap device memory pointers (output of this will be input to parallel-fft)
-   swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
-   swap_mem_ptr(&in_mem_obj2, &out_mem_obj2);
- 
-   //---------------------------
-   // lg(n) FFT stages
-   //---------------------------
-   unsigned int n;
-   
-   cl_kernel* fft_kernel = (cl_kernel*)malloc(lg_n * sizeof(cl_kernel));
-   for (i=0; i<lg_n; i++)
+   // Warm-up runs first, then the timed ones
+   int run, k;
+   for (run=0; run<(warmup + reps) && ret == CL_SUCCESS; run++)
    {
-      fft_kernel[i] = clCreateKernel(program, "parallel_fft_x2", &ret);
-      
-      // Set the arguments of the kernel
-      n = (1 << (i+1)); // double n for each stage of FFT (2,4,8,16...)
-      ret = clSetKernelArg(fft_kernel[i], 0, sizeof(cl_mem), (void *)&in_mem_obj1);
-      ret = clSetKernelArg(fft_kernel[i], 1, sizeof(cl_mem), (void *)&in_mem_obj2);
-      ret = clSetKernelArg(fft_kernel[i], 2, sizeof(cl_mem), (void *)&out_mem_obj1);
-      ret = clSetKernelArg(fft_kernel[i], 3, sizeof(cl_mem), (void *)&out_mem_obj2);
-      ret = clSetKernelArg(fft_kernel[i], 4, sizeof(unsigned int), (void*)&n);
+      double start = now_sec();
+      ret = cl_engine_multiply(engine, poly1, poly2, lg_n, poly1_out, sample);
+      double wall = now_sec() - start;
       
-      // Swap memory pointers (output of this stage will be input of next)
-      swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
-      swap_mem_ptr(&in_mem_obj2, &out_mem_obj2);
+      if (run >= warmup)
+      {
+         k = run - warmup;
+         for (i=0; i<NUM_PHASES; i++)
+            times[i][k] = sample[i];
+         times[PHASE_TOTAL][k] = wall;
+      }
+   }
+   if (ret != CL_SUCCESS)
+   {
+      fprintf(stderr, "Multiplication failed (error %d).\n", (int)ret);
+      cl_engine_release(engine);
+      exit(1);
    }
    
-   //---------------------------
-   // Point-wise multiplication
-   //---------------------------
-   cl_kernel mul_kernel = clCreateKernel(program, "pointwise_mul", &ret);
-   
-   // Set the arguments of the kernel
-   ret = clSetKernelArg(mul_kernel, 0, sizeof(cl_mem), (void *)&in_mem_obj1);
-   ret = clSetKernelArg(mul_kernel, 1, sizeof(cl_mem), (void *)&in_mem_obj2);
-   ret = clSetKernelArg(mul_kernel, 2, sizeof(cl_mem), (void *)&out_mem_obj1);
-   
-   // Swap memory pointers (output of this stage will be input of next)
-   swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
+   // Nominal work per phase: 5 n lg n flops per complex FFT, float2 = 8 bytes
+   double nlgn = (double)fft_size * lg_n;
+   double flops[NUM_PHASES] = { 0.0, 0.0, 10.0*nlgn, 6.0*fft_size, 5.0*nlgn, 0.0,
+                                15.0*nlgn + 6.0*fft_size };
+   double bytes[NUM_PHASES] = { 16.0*fft_size, 48.0*fft_size, 32.0*nlgn, 
+                                24.0*fft_size, 16.0*nlgn, 8.0*fft_size, 
+                                24.0*fft_size };
    
-   //---------------------------
-   // Bit-Reverse Permutation
-   //---------------------------
-   cl_kernel bitrev_kernel2 = clCreateKernel(program, "bitrev_permute_x2", &ret);
-
-   // Set the arguments of the kernel
-   // NOTE: We're using the bitrev_permute_x2 kernel function, but we 
-   //       are only concerned with bit reversing in_mem_obj1.
-   ret = clSetKernelArg(bitrev_kernel2, 0, sizeof(cl_mem), (void *)&in_mem_obj1);
-   ret = clSetKernelArg(bitrev_kernel2, 1, sizeof(cl_mem), (void *)&in_mem_obj2);
-   ret = clSetKernelArg(bitrev_kernel2, 2, sizeof(cl_mem), (void *)&out_mem_obj1);
-   ret = clSetKernelArg(bitrev_kernel2, 3, sizeof(cl_mem), (void *)&out_mem_obj2);
-   ret = clSetKernelArg(bitrev_kernel2, 4, sizeof(unsigned int), (void*)&lg_n);
-         
-   // Swap device memory pointers (output of this will be input to inverse parallel-fft)
-   swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
- 
-   //---------------------------
-   // lg(n) inverse-FFT stages
-   //---------------------------
-   cl_kernel* inv_fft_kernel = (cl_kernel*)malloc(lg_n * sizeof(cl_kernel));
-   for (i=0; i<lg_n; i++)
+   FILE* csv = NULL;
+   if (csv_path)
    {
-      inv_fft_kernel[i] = clCreateKernel(program, "inverse_parallel_fft", &ret);
-      
-      // Set the arguments of the kernel
-      n = (1 << (i+1)); // double n for each stage of FFT (2,4,8,16...)
-      ret = clSetKernelArg(inv_fft_kernel[i], 0, sizeof(cl_mem), (void *)&in_mem_obj1);
-      ret = clSetKernelArg(inv_fft_kernel[i], 1, sizeof(cl_mem), (void *)&out_mem_obj1);
-      ret = clSetKernelArg(inv_fft_kernel[i], 2, sizeof(unsigned int), (void*)&n);
-            
-      // Swap memory pointers (output of this stage will be input of next)
-      swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
+      csv = fopen(csv_path, "w");
+      if (csv)
+         fprintf(csv, "phase,n,samples,median,p90,p99,min,gflops,gbytes\n");
    }
    
-   // one final swap
-   swap_mem_ptr(&in_mem_obj1, &out_mem_obj1);
-   cl_mem final_output = out_mem_obj1;
-   
-   ////////////////////////////////////
-   //
-   // Deploy kernel instances to GPU
-   //
-   ////////////////////////////////////
-   printf("starting\n");
+   printf("kernels: %s, %d launches per multiplication, twiddles in %s memory\n",
+          (kernels == KERNELS_LEGACY) ? "legacy" : "local", engine->num_launches,
+          engine->constant_twiddles ? "constant" : "global");
+   printf("%-10s %9s %13s %13s %13s %9s %9s\n", "phase", "n", "median (s)", 
+          "p90 (s)", "p99 (s)", "GFLOP/s", "GB/s");
+   for (i=0; i<NUM_PHASES; i++)
+      report(csv, phase_names[i], fft_size, times[i], reps, flops[i], bytes[i]);
    
-   size_t global_item_size = fft_size;
-   size_t local_item_size;
-   if (fft_size >= group_size)
-      local_item_size = group_size;
-   else
-      local_item_size = fft_size;
+   if (csv)
+      fclose(csv);
    
-   // Transfer host memory to device
-   ret = clEnqueueWriteBuffer(command_queue, initial_input1, CL_TRUE, 0,
-         fft_size * sizeof(cl_float2), poly1, 0, NULL, NULL);
-   ret = clEnqueueWriteBuffer(command_queue, initial_input2, CL_TRUE, 0,
-         fft_size * sizeof(cl_float2), poly2, 0, NULL, NULL);
-         
-   // Bit-Reverse Permutation
-   ret = clEnqueueNDRangeKernel(command_queue, bitrev_kernel1, 1, NULL, 
-         &global_item_size, &local_item_size, 0, NULL, NULL);
-         
-   // FFT stages
-   for (i=0; i<lg_n; i++)
-      ret = clEnqueueNDRangeKernel(command_queue, fft_kernel[i], 1, NULL, 
-            &global_item_size, &local_item_size, 0, NULL, NULL);
-            
-   // Pointwise Multiplication
-   ret = clEnqueueNDRangeKernel(command_queue, mul_kernel, 1, NULL, 
-         &global_item_size, &local_item_size, 0, NULL, NULL);
-         
-   // Bit-Reverse Permutation
-   ret = clEnqueueNDRangeKernel(command_queue, bitrev_kernel2, 1, NULL, 
-         &global_item_size, &local_item_size, 0, NULL, NULL);
-         
-   // Inverse FFT stages
-   for (i=0; i<lg_n; i++)
-      ret = clEnqueueNDRangeKernel(command_queue, inv_fft_kernel[i], 1, NULL, 
-            &global_item_size, &local_item_size, 0, NULL, NULL);
-            
-   // Transfer device memory to host
-   ret = clEnqueueReadBuffer(command_queue, final_output, CL_TRUE, 0, 
-         fft_size * sizeof(cl_float2), poly1, 0, NULL, NULL);
-   printf("done\n");
+   for (i=0; i<NUM_PHASES; i++)
+      free(times[i]);
    
    ////////////////////////////////////
    //
    // Verify results
    //
    ////////////////////////////////////
+   printf("max error of %d sampled coefficients: %g\n", NUM_CHECKS,
+          check_product(fft_size / 2));
 #if 0
    printf("\nPrinting coefficients for x^k:\n");
    for (i=0; i<(fft_size-1); i++)
       printf("[k = %d]: %.0f\n", 
              i, 
              // eliminates "-0" floating-point artifact in output
-             poly1[i].x < 0 ? -poly1[i].x : poly1[i].x); 
+             poly1_out[i].x < 0 ? -poly1_out[i].x : poly1_out[i].x); 
 #endif
- 
+   
    ////////////////////////////////////
    //
-   // Clean up
+   // Repeated poly_mul calls
    //
    ////////////////////////////////////
-   
-   // Flush command queue
-   ret = clFlush(command_queue);
-   ret = clFinish(command_queue);
-   
-   // Release kernels
-   ret = clReleaseKernel(bitrev_kernel1);
-   ret = clReleaseKernel(bitrev_kernel2);
-   for (i=0; i<lg_n; i++)
+   if (calls > 0)
    {
-      clReleaseKernel(fft_kernel[i]);
-      clReleaseKernel(inv_fft_kernel[i]);
+      int size = fft_size / 2;
+      float* a = (float*)malloc(size * sizeof(float));
+      float* b = (float*)malloc(size * sizeof(float));
+      float* c = (float*)malloc((2*size - 1) * sizeof(float));
+      
+      for (i=0; i<size; i++)
+      {
+         a[i] = poly1[i].x;
+         b[i] = poly2[i].x;
+      }
+      
+      double start = now_sec();
+      for (run=0; run<calls && ret == CL_SUCCESS; run++)
+         ret = cl_engine_poly_mul(engine, a, size, b, size, c);
+      double elapsed = now_sec() - start;
+      
+      if (ret == CL_SUCCESS)
+      {
+         for (i=0; i<2*size - 1; i++)
+            poly1_out[i].x = c[i];
+         printf("poly_mul: %d calls, %.6f s per call, max error %g\n", calls,
+                elapsed / calls, check_product(size));
+      }
+      else
+         fprintf(stderr, "poly_mul failed (error %d).\n", (int)ret);
+      
+      free(a);
+      free(b);
+      free(c);
    }
-   ret = clReleaseKernel(mul_kernel);
-   ret = clReleaseProgram(program);
    
-   // Release device memory
-   ret = clReleaseMemObject(in_mem_obj1);
-   ret = clReleaseMemObject(in_mem_obj2);
-   ret = clReleaseMemObject(out_mem_obj1);
-   ret = clReleaseMemObject(out_mem_obj2);
-   
-   // Release command queue and context
-   ret = clReleaseCommandQueue(command_queue);
-   ret = clReleaseContext(context);
+   ////////////////////////////////////
+   //
+   // Pipelined job stream
+   //
+   ////////////////////////////////////
+   if (jobs > 0 && ret == CL_SUCCESS)
+      ret = run_jobs(engine, jobs, slots, fft_size, lg_n);
+ 
+   ////////////////////////////////////
+   //
+   // Clean up
+   //
+   ////////////////////////////////////
+   cl_engine_release(engine);
    
    // Free host memory
    free(poly1);
    free(poly2);
-   free(fft_kernel);
-   free(inv_fft_kernel);
+   free(poly1_out);
+   
+   return (ret == CL_SUCCESS) ? 0 : 1;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: run_jobs
+//
+// PURPOSE:
+//    Runs the same stream of multiplications (all of poly1 times poly2)
+//    twice: one at a time with cl_engine_multiply, then through the
+//    pipeline with cl_engine_submit, where the upload of one job, the
+//    kernels of the next older one and the download of the one before
+//    that overlap. Prints the sustained jobs per second of both and the
+//    largest error of the pipelined products.
+//
+// INPUT:
+//    engine   Engine
+//    jobs     Number of multiplications
+//    slots    Buffer sets of the pipeline (1 to MAX_SLOTS)
+//    fft_size FFT size of poly1 and poly2
+//    lg_n     log2 of fft_size
+//
+// OUTPUT: One line on stdout
+//
+// RETURNS: CL_SUCCESS or an OpenCL error code
+//-----------------------------------------------------------------------------
+static int run_jobs(cl_engine* engine, int jobs, int slots, int fft_size, 
+                    int lg_n)
+{
+   cl_float2* outs[MAX_SLOTS];
+   cl_float2* product = poly1_out;
+   double serial, pipelined, err, max_err = 0.0;
+   cl_int ret = CL_SUCCESS;
+   int i, k;
+   
+   // One output per slot: job k writes outs[k % slots], which is free again
+   // once the job slots earlier in the same slot is done
+   for (i=0; i<slots; i++)
+      outs[i] = (cl_float2*)malloc(fft_size * sizeof(cl_float2));
+   
+   // One at a time
+   serial = now_sec();
+   for (k=0; k<jobs && ret == CL_SUCCESS; k++)
+      ret = cl_engine_multiply(engine, poly1, poly2, lg_n, outs[0], NULL);
+   serial = now_sec() - serial;
+   
+   // Pipelined
+   if (ret == CL_SUCCESS)
+      ret = cl_engine_set_slots(engine, slots);
+   pipelined = now_sec();
+   for (k=0; k<jobs && ret == CL_SUCCESS; k++)
+      ret = cl_engine_submit(engine, poly1, poly2, lg_n, outs[k % slots]);
+   if (ret == CL_SUCCESS)
+      ret = cl_engine_finish(engine);
+   pipelined = now_sec() - pipelined;
+   
+   if (ret == CL_SUCCESS)
+   {
+      // Check the last job of every slot
+      for (i=0; i<slots && i<jobs; i++)
+      {
+         poly1_out = outs[i];
+         err = check_product(fft_size / 2);
+         if (err > max_err)
+            max_err = err;
+      }
+      poly1_out = product;
+      
+      printf("jobs: %d, %d slots, %.1f jobs/s pipelined, %.1f jobs/s one at a "
+             "time, max error %g\n", jobs, slots, jobs / pipelined, 
+             jobs / serial, max_err);
+   }
+   else
+      fprintf(stderr, "Job stream failed (error %d).\n", (int)ret);
+   
+   for (i=0; i<slots; i++)
+      free(outs[i]);
    
-   return 0;
+   return ret;
 }
 
 
@@ -445,65 +505,100 @@ static int gen_polynomials(int size)
 
 
 //-----------------------------------------------------------------------------
-// NAME: print_device_info
+// NAME: check_product
 //
-// PURPOSE: Prints the specifications of a particular compute device
+// PURPOSE:
+//    Compares NUM_CHECKS coefficients of the product in poly1_out (the
+//    first, the last, the middle and random ones) with the exact sums of
+//    the integer input coefficients.
 //
 // INPUT:
-//    p     Platform ID
-//    d     Compute Device
+//    size     Size of the polynomials in poly1 and poly2
 //
-// OUTPUT:
-//    Prints device specifications to stdout
+// OUTPUT: none
 //
-// RETURNS: void
+// RETURNS: Largest absolute error
 //-----------------------------------------------------------------------------
-static void print_device_info(cl_platform_id p, cl_device_id d)
+static double check_product(int size)
 {
-   char vendor[1024];
-   char device_ver[1024];
-   char device_name[1024];
-   cl_uint num_cores;
-   cl_long global_mem;
-   cl_long local_mem;
-   cl_uint clk_freq;
-   cl_uint item_dim;
-   size_t* item_sizes;
-   int i;
+   double exact, err, max_err = 0.0;
+   int c, i, k;
+   
+   for (c = 0; c < NUM_CHECKS; c++)
+   {
+      if (c == 0)
+         k = 0;
+      else if (c == 1)
+         k = 2*size - 2;
+      else if (c == 2)
+         k = size - 1;
+      else
+         k = rand() % (2*size - 1);
+         
+      exact = 0.0;
+      for (i = (k < size) ? 0 : k - size + 1; i <= k && i < size; i++)
+         exact += (double)poly1[i].x * poly2[k - i].x;
+         
+      err = poly1_out[k].x - exact;
+      if (err < 0.0)
+         err = -err;
+      if (err > max_err)
+         max_err = err;
+   }
+   
+   return max_err;
+}
 
-   clGetPlatformInfo(p, CL_PLATFORM_VENDOR, sizeof(vendor), vendor, NULL);
-   printf("-------------------------------------------------\n");
-   printf("Platform Vendor: %s\n", vendor);
 
-   clGetDeviceInfo(d, CL_DEVICE_NAME, sizeof(device_name), device_name, NULL);
-   clGetDeviceInfo(d, CL_DEVICE_VENDOR, sizeof(vendor), vendor, NULL);
-   clGetDeviceInfo(d, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(num_cores), &num_cores, NULL);
-   clGetDeviceInfo(d, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(global_mem), &global_mem, NULL);
-   clGetDeviceInfo(d, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(clk_freq), &clk_freq, NULL);
-   clGetDeviceInfo(d, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(local_mem), &local_mem, NULL);
-   clGetDeviceInfo(d, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(group_size), &group_size, NULL);
-   clGetDeviceInfo(d, CL_DEVICE_VERSION, sizeof(device_ver), device_ver, NULL);
-   clGetDeviceInfo(d, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, sizeof(item_dim), &item_dim, NULL);
-   item_sizes = malloc(item_dim * sizeof(size_t));
-   clGetDeviceInfo(d, CL_DEVICE_MAX_WORK_ITEM_SIZES, item_dim * sizeof(size_t), item_sizes, NULL);
+// Monotonic wall-clock time in seconds
+static double now_sec(void)
+{
+   struct timespec ts;
+   
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-   printf("   Name: %s\n", device_name);
-   printf("   Vendor: %s\n", vendor);
-   printf("   Compute Units: %u\n", num_cores);
-   printf("   Global Memory: %d bytes\n", (int)global_mem);
-   printf("   Max Clock Freq: %d MHz\n", (int)clk_freq);
-   printf("   Local Memory: %d bytes\n", (int)local_mem);
-   printf("   Work Group Size: %d\n", (int)group_size);
-   for (i=0; i < item_dim; i++)
-      printf("   Dim %d Work Items: %d\n", i+1, (int)item_sizes[i]);
-   printf("   Device Version: %s\n", device_ver);
-   printf("-------------------------------------------------\n");
+static int cmp_double(const void* x, const void* y)
+{
+   double a = *(const double*)x, b = *(const double*)y;
+   
+   return (a < b) ? -1 : (a > b);
 }
 
-// Swap cl_mem pointers
-static void swap_mem_ptr(cl_mem* a, cl_mem* b)
+//-----------------------------------------------------------------------------
+// NAME: report
+//
+// PURPOSE: Prints (and optionally writes as CSV) the statistics of one phase.
+//          Percentiles are nearest-rank; throughputs use the median.
+//
+// INPUT:
+//    csv      CSV file or NULL
+//    phase    Phase name
+//    n        FFT size
+//    samples  Times in seconds (sorted in place)
+//    count    Number of samples
+//    flops    Nominal flops of the phase (0 if not meaningful)
+//    bytes    Nominal bytes moved by the phase
+//
+// OUTPUT: One line on stdout (and in csv)
+//
+// RETURNS: void
+//-----------------------------------------------------------------------------
+static void report(FILE* csv, const char* phase, int n, double* samples, 
+                   int count, double flops, double bytes)
 {
-   cl_mem temp = *a;
-   *a = *b;
-   *b = temp;
+   qsort(samples, count, sizeof(double), cmp_double);
+   
+   double median = samples[(count - 1) / 2];
+   double p90 = samples[(int)(0.90 * count + 0.999999) - 1];
+   double p99 = samples[(int)(0.99 * count + 0.999999) - 1];
+   double gflops = (median > 0.0) ? flops / median * 1e-9 : 0.0;
+   double gbytes = (median > 0.0) ? bytes / median * 1e-9 : 0.0;
+   
+   printf("%-10s %9d %13.9f %13.9f %13.9f %9.3f %9.3f\n", 
+          phase, n, median, p90, p99, gflops, gbytes);
+   if (csv)
+      fprintf(csv, "%s,%d,%d,%.9e,%.9e,%.9e,%.9e,%.6f,%.6f\n", phase, n, count,
+              median, p90, p99, samples[0], gflops, gbytes);
 }
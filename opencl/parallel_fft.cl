@@ -1,3 +1,9 @@
+// Address space of the twiddle table. The host builds with
+// -D TWIDDLE_SPACE=__constant when the table fits in constant memory.
+#ifndef TWIDDLE_SPACE
+#define TWIDDLE_SPACE __global const
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 // Complex Arithmetic Functions
 ///////////////////////////////////////////////////////////////////////////////
@@ -5,6 +11,12 @@
 float2 complex_mul(float2 a, float2 b);
 float2 complex_add(float2 a, float2 b);
 float2 complex_sub(float2 a, float2 b);
+void radix_stages(float2 *x, unsigned int lg_r, unsigned int t, 
+                  unsigned int s, TWIDDLE_SPACE float2 *twiddles, 
+                  unsigned int lg_n, float sign, unsigned int dif);
+void radix_pass(__global float2 *data, unsigned int lg_r, unsigned int s, 
+                TWIDDLE_SPACE float2 *twiddles, unsigned int lg_n, 
+                float sign, float scale, unsigned int dif);
 
 float2 complex_mul(float2 a, float2 b)
 {
@@ -88,13 +100,15 @@ __kernel void bitrev_permute_x2(__global const float2 *in1,
 //
 // PURPOSE:
 //    Perform forward fft on two input coefficient vectors. Uses work item
-//    index to calculate the twiddle factor then performs either the top
+//    index to look up the twiddle factor then performs either the top
 //    or bottom half of the size-n butterfly operation.
 //
 // INPUT: 
-//    in1     First vector to perform forward fft on
-//    in2     Second vector to perform forward fft on
-//    n       Size of butterfly operation
+//    in1       First vector to perform forward fft on
+//    in2       Second vector to perform forward fft on
+//    n         Size of butterfly operation
+//    twiddles  e ^ (2*pi*i*j/N), j < N/2, for the full size N (the global
+//              size)
 //
 // OUTPUT: 
 //    out1    Output of forward fft on first input vector
@@ -106,7 +120,8 @@ __kernel void parallel_fft_x2(__global const float2 *in1,
                               __global const float2 *in2,
                               __global float2 *out1,
                               __global float2 *out2,
-                              unsigned int n)
+                              unsigned int n,
+                              TWIDDLE_SPACE float2 *twiddles)
 {
    unsigned int gid = get_global_id(0);
    unsigned int n_div2 = n>>1;
@@ -117,10 +132,8 @@ __kernel void parallel_fft_x2(__global const float2 *in1,
    // Determine if this work item will be the bottom part of the butterfly operation
    unsigned int is_bottom = gid & n_div2;
    
-   // calculate twiddle factor ( e ^ (2*pi*exp/n) )
-   float2 twiddle;
-   twiddle.x = cospi(2*exp/(float)n);
-   twiddle.y = sinpi(2*exp/(float)n);
+   // look up twiddle factor ( e ^ (2*pi*exp/n) )
+   float2 twiddle = twiddles[exp * (get_global_size(0) / n)];
    
    float2 t1, t2;
    float2 input1 = in1[gid];
@@ -191,8 +204,10 @@ __kernel void pointwise_mul(__global const float2 *in1,
 //       2. The output vector is divided by n at the final stage
 //
 // INPUT: 
-//    in      Vector to perform inverse fft on
-//    n       Size of butterfly operation
+//    in        Vector to perform inverse fft on
+//    n         Size of butterfly operation
+//    twiddles  e ^ (2*pi*i*j/N), j < N/2, for the full size N (the global
+//              size)
 //
 // OUTPUT: 
 //    out     Output of inverse fft on first input vector
@@ -201,7 +216,8 @@ __kernel void pointwise_mul(__global const float2 *in1,
 //-----------------------------------------------------------------------------
 __kernel void inverse_parallel_fft(__global const float2 *in,
                                    __global float2 *out,
-                                   unsigned int n)
+                                   unsigned int n,
+                                   TWIDDLE_SPACE float2 *twiddles)
 {
    unsigned int gid = get_global_id(0);
    unsigned int n_div2 = n>>1;
@@ -212,10 +228,9 @@ __kernel void inverse_parallel_fft(__global const float2 *in,
    // Determine if this work item will be the bottom part of the butterfly operation
    unsigned int is_bottom = gid & n_div2;
    
-   // calculate twiddle factor ( e ^ (-2*pi*exp/n) )
-   float2 twiddle;
-   twiddle.x = cospi(-2*exp/(float)n);
-   twiddle.y = sinpi(-2*exp/(float)n);
+   // look up twiddle factor ( e ^ (-2*pi*exp/n) )
+   float2 twiddle = twiddles[exp * (get_global_size(0) / n)];
+   twiddle.y = -twiddle.y;
    
    float2 t;
    float2 input = in[gid];
@@ -242,3 +257,276 @@ __kernel void inverse_parallel_fft(__global const float2 *in,
    if (n == get_global_size(0))
       out[gid].x /= (float)n;
 }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Multi-Stage Kernels
+//
+// The kernels above make one pass over global memory per radix-2 stage. The
+// kernels below run several stages per pass: a work item loads a whole
+// butterfly group (2, 4 or 8 elements spaced h apart), performs all of its
+// stages in registers and stores it back. fft_local first does every stage
+// that stays within a block of the vector in local memory, then fft_radix8
+// (with one fft_radix4 or fft_radix2 pass at the end) does the rest, three
+// stages per pass.
+//
+// They transform in place and take both vectors; the second NDRange
+// dimension selects one (size 2 transforms both, size 1 only the first).
+// Twiddle factors come from the same table as above, for the full size
+// 2^lg_n.
+//
+// With dif = 0 they are decimation in time like the kernels above
+// (bit-reversed input, natural output, stages from the smallest up). With
+// dif = 1 they are decimation in frequency: natural input, bit-reversed
+// output, stages from the largest down (the radix passes first, then
+// fft_local). A forward transform in frequency followed by the pointwise
+// product and an inverse in time needs no bit reversal at all, since the
+// product does not depend on the order of the spectrum.
+///////////////////////////////////////////////////////////////////////////////
+
+// Largest butterfly group of one work item (3 stages)
+#define MAX_RADIX 8
+
+//-----------------------------------------------------------------------------
+// NAME: radix_stages
+//
+// PURPOSE:
+//    Perform lg_r consecutive radix-2 stages on one butterfly group. Element
+//    m of the group is element t + m*h of its block of the vector (h = 2^s),
+//    so the stages have half sizes h, 2h, ... and twiddle factors
+//    e ^ (sign*pi*i*j/half size), j = (t + m*h) mod half size.
+//
+// INPUT: 
+//    x         2^lg_r elements of the group
+//    lg_r      Number of stages (at most 3)
+//    t         Offset of the group within the first stage's butterflies
+//    s         log2 of the half size of the first stage
+//    twiddles  e ^ (2*pi*i*j/2^lg_n), j < 2^(lg_n-1)
+//    lg_n      log2 of the transform size
+//    sign      1 for the forward fft, -1 for the inverse
+//    dif       1 for decimation in frequency, 0 for decimation in time
+//
+// OUTPUT: 
+//    x       Group after the lg_r stages
+//
+// RETURNS: void
+//-----------------------------------------------------------------------------
+void radix_stages(float2 *x, unsigned int lg_r, unsigned int t, 
+                  unsigned int s, TWIDDLE_SPACE float2 *twiddles, 
+                  unsigned int lg_n, float sign, unsigned int dif)
+{
+   unsigned int r = 1 << lg_r;
+   unsigned int h = 1 << s;
+   unsigned int k, q, m, span;
+   float2 twiddle, top_part, bottom_part;
+   
+   for (k = 0; k < lg_r; k++)
+   {
+      q = dif ? lg_r - 1 - k : k; // largest stage first in frequency
+      span = 1 << q; // distance of butterfly partners within the group
+      for (m = 0; m < r; m++)
+      {
+         if (m & span)
+            continue;
+         
+         // j / (h*span) = (j << (lg_n-1 - s-q)) / (N/2)
+         twiddle = twiddles[(t + (m & (span - 1)) * h) << (lg_n - 1 - s - q)];
+         twiddle.y *= sign;
+         
+         if (dif)
+         {
+            top_part = x[m];
+            bottom_part = x[m + span];
+            x[m] = complex_add(top_part, bottom_part);
+            x[m + span] = complex_mul(twiddle, 
+                                      complex_sub(top_part, bottom_part));
+         }
+         else
+         {
+            top_part = x[m];
+            bottom_part = complex_mul(twiddle, x[m + span]);
+            x[m] = complex_add(top_part, bottom_part);
+            x[m + span] = complex_sub(top_part, bottom_part);
+         }
+      }
+   }
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: radix_pass
+//
+// PURPOSE:
+//    Perform stages s .. s+lg_r-1 of a transform on the butterfly group of
+//    this work item (one work item per 2^lg_r elements).
+//
+// INPUT: 
+//    data      Vector, after the preceding stages
+//    lg_r      Number of stages (at most 3)
+//    s         Smallest stage (half size 2^s)
+//    twiddles  e ^ (2*pi*i*j/2^lg_n), j < 2^(lg_n-1)
+//    lg_n      log2 of the transform size
+//    sign      1 for the forward fft, -1 for the inverse
+//    scale     Factor applied to the output (1/n on the last inverse pass)
+//    dif       1 for decimation in frequency, 0 for decimation in time
+//
+// OUTPUT: 
+//    data    Vector after stages s .. s+lg_r-1
+//
+// RETURNS: void
+//-----------------------------------------------------------------------------
+void radix_pass(__global float2 *data, unsigned int lg_r, unsigned int s, 
+                TWIDDLE_SPACE float2 *twiddles, unsigned int lg_n, 
+                float sign, float scale, unsigned int dif)
+{
+   unsigned int g = get_global_id(0);
+   unsigned int h = 1 << s;
+   unsigned int t = g & (h - 1);
+   unsigned int start = ((g - t) << lg_r) + t;
+   unsigned int m;
+   float2 x[MAX_RADIX];
+   
+   for (m = 0; m < (1u << lg_r); m++)
+      x[m] = data[start + m*h];
+      
+   radix_stages(x, lg_r, t, s, twiddles, lg_n, sign, dif);
+   
+   for (m = 0; m < (1u << lg_r); m++)
+      data[start + m*h] = x[m] * scale;
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: fft_radix8, fft_radix4, fft_radix2
+//
+// PURPOSE:
+//    Perform 3, 2 or 1 stages of a forward or inverse fft from stage s up,
+//    in place. The global size is n/8, n/4 or n/2 (times 1 or 2).
+//
+// INPUT: 
+//    data1     First vector
+//    data2     Second vector
+//    twiddles  e ^ (2*pi*i*j/2^lg_n), j < 2^(lg_n-1)
+//    s         Smallest stage (half size 2^s)
+//    lg_n      log2 of the transform size
+//    sign      1 for the forward fft, -1 for the inverse
+//    scale     Factor applied to the output
+//    dif       1 for decimation in frequency, 0 for decimation in time
+//
+// OUTPUT: 
+//    data1   First vector after the stages
+//    data2   Second vector after the stages
+//
+// RETURNS: void
+//-----------------------------------------------------------------------------
+__kernel void fft_radix8(__global float2 *data1,
+                         __global float2 *data2,
+                         TWIDDLE_SPACE float2 *twiddles,
+                         unsigned int s,
+                         unsigned int lg_n,
+                         float sign,
+                         float scale,
+                         unsigned int dif)
+{
+   radix_pass(get_global_id(1) ? data2 : data1, 3, s, twiddles, lg_n, 
+              sign, scale, dif);
+}
+
+__kernel void fft_radix4(__global float2 *data1,
+                         __global float2 *data2,
+                         TWIDDLE_SPACE float2 *twiddles,
+                         unsigned int s,
+                         unsigned int lg_n,
+                         float sign,
+                         float scale,
+                         unsigned int dif)
+{
+   radix_pass(get_global_id(1) ? data2 : data1, 2, s, twiddles, lg_n, 
+              sign, scale, dif);
+}
+
+__kernel void fft_radix2(__global float2 *data1,
+                         __global float2 *data2,
+                         TWIDDLE_SPACE float2 *twiddles,
+                         unsigned int s,
+                         unsigned int lg_n,
+                         float sign,
+                         float scale,
+                         unsigned int dif)
+{
+   radix_pass(get_global_id(1) ? data2 : data1, 1, s, twiddles, lg_n, 
+              sign, scale, dif);
+}
+
+
+//-----------------------------------------------------------------------------
+// NAME: fft_local
+//
+// PURPOSE:
+//    Perform the lg_b smallest stages of a forward or inverse fft in place
+//    (the first ones in time, the last ones in frequency).
+//    Each work group copies one block of 2^lg_b elements to local memory,
+//    runs the stages there in radix-8 passes (each work item taking whole
+//    butterfly groups, a barrier between passes) and copies it back. The
+//    global size is (n / 2^lg_b) times the work group size (times 1 or 2).
+//
+// INPUT: 
+//    data1     First vector
+//    data2     Second vector
+//    buf       Local memory for 2^lg_b elements
+//    twiddles  e ^ (2*pi*i*j/2^lg_n), j < 2^(lg_n-1)
+//    lg_b      Number of stages (log2 of the block size)
+//    lg_n      log2 of the transform size
+//    sign      1 for the forward fft, -1 for the inverse
+//    scale     Factor applied to the output
+//    dif       1 for decimation in frequency, 0 for decimation in time
+//
+// OUTPUT: 
+//    data1   First vector after the stages
+//    data2   Second vector after the stages
+//
+// RETURNS: void
+//-----------------------------------------------------------------------------
+__kernel void fft_local(__global float2 *data1,
+                        __global float2 *data2,
+                        __local float2 *buf,
+                        TWIDDLE_SPACE float2 *twiddles,
+                        unsigned int lg_b,
+                        unsigned int lg_n,
+                        float sign,
+                        float scale,
+                        unsigned int dif)
+{
+   __global float2 *data = get_global_id(1) ? data2 : data1;
+   unsigned int lid = get_local_id(0);
+   unsigned int items = get_local_size(0);
+   unsigned int base = get_group_id(0) << lg_b;
+   unsigned int size = 1 << lg_b;
+   unsigned int k, s, lg_r, g, h, t, start, m;
+   float2 x[MAX_RADIX];
+   
+   for (g = lid; g < size; g += items)
+      buf[g] = data[base + g];
+   barrier(CLK_LOCAL_MEM_FENCE);
+   
+   for (k = 0; k < lg_b; k += lg_r)
+   {
+      lg_r = min(3u, lg_b - k);
+      s = dif ? lg_b - k - lg_r : k;
+      h = 1 << s;
+      for (g = lid; g < (size >> lg_r); g += items)
+      {
+         t = g & (h - 1);
+         start = ((g - t) << lg_r) + t;
+         for (m = 0; m < (1u << lg_r); m++)
+            x[m] = buf[start + m*h];
+         radix_stages(x, lg_r, t, s, twiddles, lg_n, sign, dif);
+         for (m = 0; m < (1u << lg_r); m++)
+            buf[start + m*h] = x[m];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+   
+   for (g = lid; g < size; g += items)
+      data[base + g] = buf[g] * scale;
+}
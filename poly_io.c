@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common_defs.h"
+#include "ntt.h"
+#include "poly_io.h"
+
+/* elem_size - bytes per element of a type, 0 if unknown */
+static size_t elem_size(int type)
+{
+   switch (type)
+   {
+      case POLY_INT32:  return 4;
+      case POLY_INT64:  return 8;
+      case POLY_DOUBLE: return 8;
+   }
+   return 0;
+}
+
+/* swap_bytes - reverse the byte order of count elements of size bytes */
+static void swap_bytes(void* dst, const void* src, size_t size, int64_t count)
+{
+   const unsigned char* s = (const unsigned char*)src;
+   unsigned char* d = (unsigned char*)dst;
+   unsigned char t;
+   int64_t k;
+   size_t j;
+
+   for (k = 0; k < count; k++, s += size, d += size)
+   {
+      for (j = 0; j < size/2; j++)
+      {
+         t = s[j];
+         d[j] = s[size-1-j];
+         d[size-1-j] = t;
+      }
+   }
+}
+
+/* poly_file_open - see poly_io.h for more details */
+int poly_file_open(const char* path, poly_file* f)
+{
+   unsigned char* p;
+   struct stat st;
+   uint32_t mark;
+   uint16_t version, type;
+   size_t size;
+   uint64_t avail;
+
+   f->map = NULL;
+   f->fd = open(path, O_RDONLY);
+   if (f->fd < 0)
+   {
+      perror(path);
+      return -1;
+   }
+
+   if (fstat(f->fd, &st) != 0 || st.st_size < POLY_FILE_HEADER)
+   {
+      fprintf(stderr, "%s: not a polynomial file\n", path);
+      poly_file_close(f);
+      return -1;
+   }
+
+   f->map_size = (size_t)st.st_size;
+   f->map = mmap(NULL, f->map_size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+   if (f->map == MAP_FAILED)
+   {
+      f->map = NULL;
+      perror(path);
+      poly_file_close(f);
+      return -1;
+   }
+   p = (unsigned char*)f->map;
+
+   /* Header fields are in the writer's byte order */
+   memcpy(&mark, p + 4, 4);
+   f->swapped = (mark != POLY_ENDIAN_MARK);
+   memcpy(&version, p + 8, 2);
+   memcpy(&type, p + 10, 2);
+   memcpy(&f->na, p + 16, 8);
+   memcpy(&f->nb, p + 24, 8);
+   if (f->swapped)
+   {
+      swap_bytes(&mark, &mark, 4, 1);
+      swap_bytes(&version, &version, 2, 1);
+      swap_bytes(&type, &type, 2, 1);
+      swap_bytes(&f->na, &f->na, 8, 1);
+      swap_bytes(&f->nb, &f->nb, 8, 1);
+   }
+   f->type = type;
+   size = elem_size(type);
+
+   avail = size ? (f->map_size - POLY_FILE_HEADER) / size : 0;
+   if (memcmp(p, POLY_FILE_MAGIC, 4) != 0 || mark != POLY_ENDIAN_MARK ||
+       version != POLY_FILE_VERSION || size == 0 || f->na < 0 || f->nb < 0 ||
+       (uint64_t)f->na > avail || (uint64_t)f->nb > avail - f->na)
+   {
+      fprintf(stderr, "%s: bad polynomial file header\n", path);
+      poly_file_close(f);
+      return -1;
+   }
+
+   f->a = p + POLY_FILE_HEADER;
+   f->b = (f->nb > 0) ? p + POLY_FILE_HEADER + f->na * size : NULL;
+
+   return 0;
+}
+
+/* poly_file_create - see poly_io.h for more details */
+int poly_file_create(const char* path, int type, int64_t na, int64_t nb,
+                     poly_file* f)
+{
+   unsigned char* p;
+   uint32_t mark = POLY_ENDIAN_MARK;
+   uint16_t version = POLY_FILE_VERSION;
+   uint16_t t = (uint16_t)type;
+   size_t size = elem_size(type);
+
+   f->map = NULL;
+   f->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (f->fd < 0)
+   {
+      perror(path);
+      return -1;
+   }
+
+   f->map_size = POLY_FILE_HEADER + (size_t)(na + nb) * size;
+   if (ftruncate(f->fd, (off_t)f->map_size) != 0)
+   {
+      perror(path);
+      poly_file_close(f);
+      return -1;
+   }
+
+   f->map = mmap(NULL, f->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 f->fd, 0);
+   if (f->map == MAP_FAILED)
+   {
+      f->map = NULL;
+      perror(path);
+      poly_file_close(f);
+      return -1;
+   }
+   p = (unsigned char*)f->map;
+
+   memcpy(p, POLY_FILE_MAGIC, 4);
+   memcpy(p + 4, &mark, 4);
+   memcpy(p + 8, &version, 2);
+   memcpy(p + 10, &t, 2);
+   memset(p + 12, 0, 4);
+   memcpy(p + 16, &na, 8);
+   memcpy(p + 24, &nb, 8);
+
+   f->type = type;
+   f->swapped = 0;
+   f->na = na;
+   f->nb = nb;
+   f->a = p + POLY_FILE_HEADER;
+   f->b = (nb > 0) ? p + POLY_FILE_HEADER + na * size : NULL;
+
+   return 0;
+}
+
+/* poly_file_close - see poly_io.h for more details */
+void poly_file_close(poly_file* f)
+{
+   if (f->map)
+      munmap(f->map, f->map_size);
+   if (f->fd >= 0)
+      close(f->fd);
+
+   f->map = NULL;
+   f->fd = -1;
+}
+
+/* native_copy - the elements of p, swapped into a new buffer if needed;
+   NULL if that buffer cannot be allocated */
+static void* native_copy(const poly_file* f, void* p, int64_t count)
+{
+   size_t size = elem_size(f->type);
+   void* buf;
+
+   if (!f->swapped)
+      return p;
+
+   buf = malloc(count * size + 1);
+   if (!buf)
+      return NULL;
+   swap_bytes(buf, p, size, count);
+   return buf;
+}
+
+/* poly_file_mul - see poly_io.h for more details */
+int poly_file_mul(const char* in_path, const char* out_path)
+{
+   poly_file in, out;
+   char* tmp_path;
+   void* a;
+   void* b;
+   int ret = 0;
+
+   if (poly_file_open(in_path, &in) != 0)
+      return -1;
+
+   if (in.na < 1 || in.nb < 1 || in.na > INT_MAX/2 || in.nb > INT_MAX/2)
+   {
+      fprintf(stderr, "%s: need two polynomials of 1 to %d coefficients\n",
+              in_path, INT_MAX/2);
+      poly_file_close(&in);
+      return -1;
+   }
+
+   /* Opening out_path itself with O_TRUNC would truncate the input
+      under its mapping if both name the same file */
+   tmp_path = (char*)malloc(strlen(out_path) + 32);
+   sprintf(tmp_path, "%s.tmp%ld", out_path, (long)getpid());
+   if (poly_file_create(tmp_path, (in.type == POLY_DOUBLE) ? POLY_DOUBLE :
+                        POLY_INT64, in.na + in.nb - 1, 0, &out) != 0)
+   {
+      poly_file_close(&in);
+      free(tmp_path);
+      return -1;
+   }
+
+   a = native_copy(&in, in.a, in.na);
+   b = native_copy(&in, in.b, in.nb);
+   if (!a || !b)
+   {
+      fprintf(stderr, "%s: out of memory for the byte swapped "
+                      "coefficients\n", in_path);
+      ret = -1;
+   }
+   else
+   {
+      switch (in.type)
+      {
+         case POLY_DOUBLE:
+            poly_mul_auto((double*)a, (int)in.na, (double*)b, (int)in.nb,
+                          (double*)out.a);
+            break;
+
+         case POLY_INT32:
+            ret = poly_mul_ntt32((int32_t*)a, (int)in.na, (int32_t*)b,
+                                 (int)in.nb, (int64_t*)out.a);
+            break;
+
+         case POLY_INT64:
+            ret = poly_mul_ntt((int64_t*)a, (int)in.na, (int64_t*)b,
+                               (int)in.nb, (int64_t*)out.a);
+            break;
+      }
+
+      if (ret != NTT_OK)
+      {
+         fprintf(stderr, "%s: %s\n", in_path, ntt_strerror(ret));
+         ret = -1;
+      }
+   }
+
+   if (a != in.a)
+      free(a);
+   if (b != in.b)
+      free(b);
+   poly_file_close(&in);
+   poly_file_close(&out);
+
+   if (ret == 0 && rename(tmp_path, out_path) != 0)
+   {
+      perror(out_path);
+      ret = -1;
+   }
+   if (ret != 0)
+      unlink(tmp_path);
+   free(tmp_path);
+
+   return ret;
+}
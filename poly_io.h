@@ -0,0 +1,127 @@
+#ifndef POLY_IO_H
+#define POLY_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+** Binary polynomial files (see README for the full layout)
+**
+**    offset  size  field
+**    0       4     magic "PMUL"
+**    4       4     endianness marker 0x01020304, in the byte order of
+**                  the writer (reads as 0x04030201 on a machine of the
+**                  other order)
+**    8       2     version (POLY_FILE_VERSION)
+**    10      2     element type (POLY_INT32, POLY_INT64, POLY_DOUBLE)
+**    12      4     reserved, 0
+**    16      8     na, coefficients of the first polynomial
+**    24      8     nb, coefficients of the second one (0 if none)
+**    32            na elements of a, then nb elements of b
+**
+** All header fields and elements use the byte order of the marker.
+*/
+#define POLY_FILE_MAGIC    "PMUL"
+#define POLY_FILE_VERSION  1
+#define POLY_FILE_HEADER   32
+#define POLY_ENDIAN_MARK   0x01020304u
+
+/* Element types */
+#define POLY_INT32         1
+#define POLY_INT64         2
+#define POLY_DOUBLE        3
+
+/*
+** poly_file
+**
+** An open, memory-mapped polynomial file. a and b point into
+** the mapping (b is NULL when nb is 0).
+*/
+typedef struct
+{
+   int fd;              /* file descriptor, -1 if closed */
+   void* map;           /* start of the mapping */
+   size_t map_size;     /* bytes mapped */
+   int type;            /* element type */
+   int swapped;         /* 1 if written with the other byte order */
+   int64_t na;          /* coefficients in a */
+   int64_t nb;          /* coefficients in b */
+   void* a;             /* first polynomial */
+   void* b;             /* second polynomial */
+} poly_file;
+
+/*---------------------------------------------------------
+** NAME: poly_file_open
+**
+** PURPOSE:
+**    Map an existing polynomial file read-only and check
+**    its header (magic, version, type, marker and size).
+**
+** INPUTS:
+**    path  File name
+**
+** OUTPUTS:
+**    f     Open file (close with poly_file_close)
+**
+** RETURNS: 0 on success, -1 on error (message on stderr)
+**
+**-------------------------------------------------------*/
+int poly_file_open(const char* path, poly_file* f);
+
+/*---------------------------------------------------------
+** NAME: poly_file_create
+**
+** PURPOSE:
+**    Create (or truncate) a polynomial file of the given
+**    type and sizes in native byte order, write the header
+**    and map it read/write. The elements are zero and can
+**    be filled through f->a and f->b.
+**
+** INPUTS:
+**    path  File name
+**    type  Element type
+**    na    Coefficients in a
+**    nb    Coefficients in b (0 for one polynomial)
+**
+** OUTPUTS:
+**    f     Open file (close with poly_file_close)
+**
+** RETURNS: 0 on success, -1 on error (message on stderr)
+**
+**-------------------------------------------------------*/
+int poly_file_create(const char* path, int type, int64_t na, int64_t nb,
+                     poly_file* f);
+
+/* poly_file_close - unmap and close (writes reach the file) */
+void poly_file_close(poly_file* f);
+
+/*---------------------------------------------------------
+** NAME: poly_file_mul
+**
+** PURPOSE:
+**    Multiply the two polynomials of a binary file and
+**    write the na+nb-1 product coefficients to a new
+**    binary file. Doubles go through poly_mul_auto and
+**    integers through the exact NTT (int64 output). Native
+**    input is read straight from the input mapping and the
+**    product is written straight into the output mapping;
+**    only input in the other byte order is first swapped
+**    into a buffer.
+**
+**    The product is written to a temporary file next to
+**    out_path and renamed over it only on success, so
+**    out_path may name the input file and is never left
+**    half written.
+**
+** INPUTS:
+**    in_path   Input file (a and b)
+**    out_path  Output file (product, nb = 0)
+**
+** OUTPUTS: none
+**
+** RETURNS: 0 on success, -1 on error (message on stderr)
+**
+**-------------------------------------------------------*/
+int poly_file_mul(const char* in_path, const char* out_path);
+
+#endif
@@ -0,0 +1,261 @@
+#include <stdlib.h>
+#include <math.h>
+#include "common_defs.h"
+#include "fft_stats.h"
+
+/*
+** Real-input transforms of length n are done with one complex transform
+** of length m = n/2 on z[j] = x[2j] + i*x[2j+1]. With E and O the DFTs
+** of the even and odd samples and w = exp(2*PI*i/n):
+**
+**    Z[k] = E[k] + i*O[k]
+**    E[k] = (Z[k] + conj(Z[m-k]))/2,  O[k] = (Z[k] - conj(Z[m-k]))/(2i)
+**    X[k] = E[k] + w^k * O[k]                       (0 <= k <= m)
+**
+** Only X[0..m] is stored, since X[n-k] = conj(X[k]) for real x. The
+** inverse runs the same steps backwards.
+*/
+
+/* Number of cached root tables (least recently used is replaced) */
+#define MAX_ROOTS  8
+
+/* Cached w^k tables, their lengths n and the lookup count of their last use */
+static complex* root_cache[MAX_ROOTS];
+static int root_n[MAX_ROOTS];
+static unsigned long root_used[MAX_ROOTS];
+static unsigned long root_clock = 0;
+
+/*
+** real_roots
+**
+** w^k = exp(2*PI*i*k/n) for k < n/2, from a small LRU cache keyed by n.
+** The table is all real_split/real_merge need, so there is no length n
+** plan to build (and no mixed radix plan cache slot to take).
+*/
+static const complex* real_roots(int n)
+{
+   complex* root;
+   double theta;
+   int i, k;
+   int oldest = 0;
+
+   root_clock++;
+   for (i = 0; i < MAX_ROOTS; i++)
+   {
+      if (root_cache[i] && root_n[i] == n)
+      {
+         root_used[i] = root_clock;
+         return root_cache[i];
+      }
+      if (root_used[i] < root_used[oldest])
+         oldest = i;
+   }
+
+   root = (complex*)fft_malloc((n/2 > 0 ? n/2 : 1) * sizeof(complex));
+   for (k = 0; k < (n/2); k++)
+   {
+      theta = 2*PI*(double)k/(double)n;
+      root[k].r = cos(theta);
+      root[k].i = sin(theta);
+   }
+
+   fft_free(root_cache[oldest]);
+   root_cache[oldest] = root;
+   root_n[oldest] = n;
+   root_used[oldest] = root_clock;
+   return root;
+}
+
+/* complex_conj - complex conjugate */
+static complex complex_conj(complex a)
+{
+   a.i = -a.i;
+   return a;
+}
+
+/* half_div_i - compute a/(2i) */
+static complex half_div_i(complex a)
+{
+   complex ans;
+
+   ans.r = 0.5 * a.i;
+   ans.i = -0.5 * a.r;
+
+   return ans;
+}
+
+/* half - compute a/2 */
+static complex half(complex a)
+{
+   a.r *= 0.5;
+   a.i *= 0.5;
+   return a;
+}
+
+/* plus_i_times - compute a + i*b */
+static complex plus_i_times(complex a, complex b)
+{
+   complex ans;
+
+   ans.r = a.r - b.i;
+   ans.i = a.i + b.r;
+
+   return ans;
+}
+
+/*
+** real_split
+**
+** Turn the length m DFT of the packed even/odd samples held in y[0..m-1]
+** into the half-complex spectrum X[0..m] (in place, y has m+1 slots).
+*/
+static void real_split(complex* y, int n)
+{
+   const complex* w = real_roots(n);
+   complex zk, zk2, e, o;
+   int m = n/2;
+   int k, k2;
+
+   /* k = 0 and k = m only depend on Z[0] (w^m = -1) */
+   e.r = y[0].r; e.i = 0.0;
+   o.r = y[0].i; o.i = 0.0;
+   y[0] = complex_add(e, o);
+   y[m] = complex_sub(e, o);
+
+   /* Remaining bins are produced in (k, m-k) pairs */
+   for (k = 1; k <= (m/2); k++)
+   {
+      k2 = m - k;
+      zk  = y[k];
+      zk2 = y[k2];
+
+      e = half(complex_add(zk, complex_conj(zk2)));
+      o = half_div_i(complex_sub(zk, complex_conj(zk2)));
+      y[k] = complex_add(e, complex_mul(w[k], o));
+
+      e = half(complex_add(zk2, complex_conj(zk)));
+      o = half_div_i(complex_sub(zk2, complex_conj(zk)));
+      y[k2] = complex_add(e, complex_mul(w[k2], o));
+   }
+}
+
+/*
+** real_merge
+**
+** Inverse of real_split: turn X[0..m] into the length m spectrum whose 
+** (unscaled) inverse DFT is x[2j] + i*x[2j+1], scaled by 2 so that the
+** final result matches an unscaled length n inverse DFT. Uses w^-k, the
+** conjugate of real_split's w^k.
+*/
+static void real_merge(complex* y, int n)
+{
+   const complex* w = real_roots(n);
+   complex xk, xk2, e, o;
+   int m = n/2;
+   int k, k2;
+
+   /* k = 0 pairs X[0] with X[m] */
+   xk  = y[0];
+   xk2 = y[m];
+   e = complex_add(xk, complex_conj(xk2));
+   o = complex_sub(xk, complex_conj(xk2));
+   y[0] = plus_i_times(e, o);
+
+   for (k = 1; k <= (m/2); k++)
+   {
+      k2 = m - k;
+      xk  = y[k];
+      xk2 = y[k2];
+
+      e = complex_add(xk, complex_conj(xk2));
+      o = complex_mul(complex_conj(w[k]), complex_sub(xk, complex_conj(xk2)));
+      y[k] = plus_i_times(e, o);
+
+      e = complex_add(xk2, complex_conj(xk));
+      o = complex_mul(complex_conj(w[k2]), complex_sub(xk2, complex_conj(xk)));
+      y[k2] = plus_i_times(e, o);
+   }
+}
+
+/* rfft - see common_defs.h for more details */
+void rfft(double* x, complex* y, int n)
+{
+   int j;
+
+   /* Pack even samples into the real part, odd samples into the imaginary */
+   for (j = 0; j < (n/2); j++)
+   {
+      y[j].r = x[2*j];
+      y[j].i = x[2*j+1];
+   }
+
+   fft_execute(fft_plan_get(n/2, 0), y);
+   real_split(y, n);
+}
+
+/* irfft - see common_defs.h for more details */
+void irfft(complex* y, double* x, int n)
+{
+   int j;
+
+   real_merge(y, n);
+   fft_execute(fft_plan_get(n/2, 1), y);
+
+   /* Unpack even/odd samples */
+   for (j = 0; j < (n/2); j++)
+   {
+      x[2*j]   = y[j].r;
+      x[2*j+1] = y[j].i;
+   }
+}
+
+/* poly_mul_real - see common_defs.h for more details */
+void poly_mul_real(complex* a, complex* b, int n)
+{
+   complex zk, zc, ya, yb;
+   fft_probe probe;
+   double bytes = (double)n * sizeof(complex);
+   int m = n/2;
+   int j, k;
+
+   /* One complex DFT of a + i*b gives the spectra of both polynomials */
+   fft_probe_begin(&probe);
+   for (j = 0; j < n; j++)
+      a[j].i = b[j].r;
+
+   fft_execute(fft_plan_get(n, 0), a);
+   fft_probe_end(&probe, FFT_PHASE_FORWARD, 3*bytes);
+
+   /* 
+   ** Separate the spectra by conjugate symmetry and multiply. Only
+   ** bins 0..m are needed since the product is real as well.
+   */
+   fft_probe_begin(&probe);
+   for (k = 0; k <= m; k++)
+   {
+      zk = a[k];
+      zc = complex_conj(a[k ? n-k : 0]);
+
+      ya = half(complex_add(zk, zc));
+      yb = half_div_i(complex_sub(zk, zc));
+      b[k] = complex_mul(ya, yb);
+   }
+   fft_probe_end(&probe, FFT_PHASE_POINTWISE, 1.5*bytes);
+
+   /* Half-length real inverse DFT */
+   fft_probe_begin(&probe);
+   real_merge(b, n);
+   fft_execute(fft_plan_get(m, 1), b);
+   fft_probe_end(&probe, FFT_PHASE_INVERSE, 2*bytes);
+
+   /* Unpack and divide by n */
+   fft_probe_begin(&probe);
+   for (j = 0; j < m; j++)
+   {
+      a[2*j].r   = b[j].r/n;
+      a[2*j].i   = 0.0;
+      a[2*j+1].r = b[j].i/n;
+      a[2*j+1].i = 0.0;
+   }
+   fft_probe_end(&probe, FFT_PHASE_SCALE, 1.5*bytes);
+}
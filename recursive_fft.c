@@ -1,36 +1,33 @@
 #include <math.h>
 #include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
 #include "common_defs.h"
+#include "fft_trace.h"
 
-#ifdef DEBUG_TRACE
-static char debug_buf[256];
-#endif
-
-/* recursive_fft - see common_defs.h for more details */
-void recursive_fft(complex* a, complex* y, int n, int inv)
+/*
+** recursive_fft_scratch
+**
+** Recursive FFT worker. The even/odd coefficients are copied into the 
+** first n entries of scratch, and the half-size FFTs are written straight
+** into the two halves of y (so no separate y0/y1 buffers are needed).
+** Both children reuse scratch+n in turn, which bounds the total scratch
+** at n + n/2 + n/4 + ... < 2n.
+*/
+static void recursive_fft_scratch(complex* a, complex* y, int n, int inv,
+                                  complex* scratch)
 {
-   complex w, wn, twiddle;
+   complex w, wn, twiddle, u;
    complex* a0;
    complex* a1;
-   complex* y0;
-   complex* y1;
    int i, k;
    
-#ifdef DEBUG_TRACE
-   /* Debug print of recursion trace */
-   printf("N = %-3d\v\b\b\b",n);
-#endif
+   /* Recursion trace (binary events, see fft_trace.h) */
+   FFT_TRACE_ENTER_N(n, inv);
 
    /* Base Case */
    if (n == 1)
    {
-#ifdef DEBUG_TRACE
-      /* For proper formatting, need to backspace for next level up */
-      printf("\b\b\b\b");
-#endif
       y[0] = a[0];
+      FFT_TRACE_EXIT_N(n, inv);
       return;
    }
 
@@ -48,11 +45,9 @@ void recursive_fft(complex* a, complex* y, int n, int inv)
    w.r = 1.0;
    w.i = 0.0;
    
-   /* allocate memory for even/odd coefficients and corresponding FFTs */
-   a0 = (complex*)malloc((n/2) * sizeof(complex));
-   a1 = (complex*)malloc((n/2) * sizeof(complex));
-   y0 = (complex*)malloc((n/2) * sizeof(complex));
-   y1 = (complex*)malloc((n/2) * sizeof(complex));
+   /* even/odd coefficients live in scratch */
+   a0 = scratch;
+   a1 = scratch + n/2;
    
    /* Extract even and odd coefficients */
    for (i = 0; i < (n/2); i++)
@@ -61,43 +56,40 @@ void recursive_fft(complex* a, complex* y, int n, int inv)
       a1[i] = a[2*i+1];
    }
 
-   /* Calculate 2 FFTs of size n/2 */
-   recursive_fft(a0, y0, n/2, inv);
-   recursive_fft(a1, y1, n/2, inv);
+   /* Calculate 2 FFTs of size n/2 (y0 = y[0..n/2), y1 = y[n/2..n)) */
+   recursive_fft_scratch(a0, y, n/2, inv, scratch + n);
+   recursive_fft_scratch(a1, y + n/2, n/2, inv, scratch + n);
    
    /* Combine results from half-size FFTs */
    for (k = 0; k < (n/2); k++)
    {
-      twiddle  = complex_mul(w, y1[k]);
-      y[k]     = complex_add(y0[k], twiddle);
-      y[k+n/2] = complex_sub(y0[k], twiddle);
-      
-#ifdef DEBUG_TRACE
-      sprintf(debug_buf,
-         "w = (%.4f, %.4f), y[%d] = (%.4f, %.4f), y[%d] = (%.4f, %.4f)",
-         w.r, w.i,
-         k, y[k].r, y[k].i,
-         k+n/2, y[k+n/2].r, y[k+n/2].i);
-      printf("%s", debug_buf);
-      
-      /* After printing string, go back to where we started */
-      for (i = 0; i < strlen(debug_buf); i++)
-         printf("\b");
-      printf("\v");
-#endif      
+      twiddle  = complex_mul(w, y[k+n/2]);
+      u        = y[k];
+      y[k]     = complex_add(u, twiddle);
+      y[k+n/2] = complex_sub(u, twiddle);
+      FFT_TRACE_BUTTERFLY_K(n, k, inv);
       
       w = complex_mul(w, wn);
    }
    
-#ifdef DEBUG_TRACE
-   /* For proper formatting, need to backspace for next level up */
-   printf("\b\b\b\b");
-#endif
-   
-   free(a0);
-   free(a1);
-   free(y0);
-   free(y1);
-   
+   FFT_TRACE_EXIT_N(n, inv);
    return;
 }
+
+/* recursive_fft_arena - see common_defs.h for more details */
+void recursive_fft_arena(complex* a, complex* y, int n, int inv, 
+                         fft_arena* arena)
+{
+   fft_arena_reserve(arena, 2*n);
+   recursive_fft_scratch(a, y, n, inv, arena->buf);
+}
+
+/* recursive_fft - see common_defs.h for more details */
+void recursive_fft(complex* a, complex* y, int n, int inv)
+{
+   fft_arena arena = { NULL, 0 };
+   
+   /* One scratch allocation for the whole recursion */
+   recursive_fft_arena(a, y, n, inv, &arena);
+   fft_arena_free(&arena);
+}
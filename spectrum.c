@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <string.h>
+#include "common_defs.h"
+#include "fft_stats.h"
+
+/*
+** Pre-transformed operands. A poly_spectrum holds rfft(b)/size for a
+** fixed polynomial b, so each product with it costs one forward and one
+** inverse real transform. Inputs too long for the transform are cut into
+** blocks of size - nb + 1 coefficients and the block products are added
+** together (overlap-add), so one spectrum serves inputs of any length.
+**
+** poly_spectrum_get keeps the most recently used spectra in a small LRU
+** cache keyed by an FNV-1a hash of the coefficients, nb and the size.
+** A hash match is confirmed against a copy of the coefficients.
+*/
+
+/* Number of spectra kept by poly_spectrum_get */
+#define SPECTRUM_CACHE_SIZE  16
+
+/* 64-bit FNV-1a parameters */
+#define FNV_OFFSET  14695981039346656037ULL
+#define FNV_PRIME   1099511628211ULL
+
+typedef struct
+{
+   poly_spectrum* spec;
+   unsigned long long hash;
+   unsigned long last_use;    /* 0 for an empty slot */
+} spectrum_entry;
+
+static spectrum_entry cache[SPECTRUM_CACHE_SIZE];
+static unsigned long use_clock = 0;
+static long cache_hits = 0;
+static long cache_misses = 0;
+
+/* Block spectrum and one real block (grow only) */
+static fft_arena work = { NULL, 0 };
+
+/* hash_coeffs - FNV-1a over the bytes of n doubles */
+static unsigned long long hash_coeffs(const double* b, int n)
+{
+   const unsigned char* p = (const unsigned char*)b;
+   unsigned long long h = FNV_OFFSET;
+   size_t j;
+
+   for (j = 0; j < n * sizeof(double); j++)
+   {
+      h ^= p[j];
+      h *= FNV_PRIME;
+   }
+
+   return h;
+}
+
+/* poly_spectrum_create - see common_defs.h for more details */
+poly_spectrum* poly_spectrum_create(const double* b, int nb, int max_na)
+{
+   poly_spectrum* s;
+   double* x;
+   int j;
+
+   if (nb < 1 || max_na < 1)
+      return NULL;
+
+   s = (poly_spectrum*)fft_malloc(sizeof(poly_spectrum));
+   s->n = nb;
+   s->size = 2 * fft_good_size((max_na + nb) / 2);
+   s->coeffs = (double*)fft_malloc(nb * sizeof(double));
+   s->spec = (complex*)fft_malloc((s->size/2 + 1) * sizeof(complex));
+   memcpy(s->coeffs, b, nb * sizeof(double));
+
+   /* Transform b padded to size, with the 1/size of the inverse folded in */
+   x = (double*)fft_malloc(s->size * sizeof(double));
+   for (j = 0; j < s->size; j++)
+      x[j] = (j < nb) ? b[j] / s->size : 0.0;
+   rfft(x, s->spec, s->size);
+   fft_free(x);
+
+   return s;
+}
+
+/* poly_spectrum_destroy - see common_defs.h for more details */
+void poly_spectrum_destroy(poly_spectrum* s)
+{
+   if (!s)
+      return;
+
+   fft_free(s->coeffs);
+   fft_free(s->spec);
+   fft_free(s);
+}
+
+/* poly_mul_spectrum - see common_defs.h for more details */
+void poly_mul_spectrum(const double* a, int na, const poly_spectrum* s,
+                       double* c)
+{
+   fft_probe probe;
+   complex* ys;
+   double* x;
+   double re;
+   int size = s->size;
+   int block = size - s->n + 1;
+   int o, len, j;
+
+   fft_probe_begin(&probe);
+
+   fft_arena_reserve(&work, (size/2 + 1) + size/2);
+   ys = work.buf;
+   x = (double*)(ys + (size/2 + 1));
+
+   for (j = 0; j < (na + s->n - 1); j++)
+      c[j] = 0.0;
+
+   for (o = 0; o < na; o += block)
+   {
+      len = (na - o < block) ? na - o : block;
+      for (j = 0; j < size; j++)
+         x[j] = (j < len) ? a[o + j] : 0.0;
+
+      rfft(x, ys, size);
+      for (j = 0; j <= (size/2); j++)
+      {
+         re = ys[j].r*s->spec[j].r - ys[j].i*s->spec[j].i;
+         ys[j].i = ys[j].r*s->spec[j].i + ys[j].i*s->spec[j].r;
+         ys[j].r = re;
+      }
+      irfft(ys, x, size);
+
+      for (j = 0; j < (len + s->n - 1); j++)
+         c[o + j] += x[j];
+   }
+
+   fft_probe_end(&probe, FFT_PHASE_SPECTRUM, 8.0*(2*na + s->n - 1));
+}
+
+/* poly_spectrum_get - see common_defs.h for more details */
+poly_spectrum* poly_spectrum_get(const double* b, int nb, int max_na)
+{
+   unsigned long long h;
+   poly_spectrum* s;
+   int size, i, victim;
+
+   if (nb < 1 || max_na < 1)
+      return NULL;
+
+   h = hash_coeffs(b, nb);
+   size = 2 * fft_good_size((max_na + nb) / 2);
+
+   for (i = 0; i < SPECTRUM_CACHE_SIZE; i++)
+   {
+      s = cache[i].spec;
+      if (s && cache[i].hash == h && s->n == nb && s->size == size &&
+          memcmp(s->coeffs, b, nb * sizeof(double)) == 0)
+      {
+         cache[i].last_use = ++use_clock;
+         cache_hits++;
+         return s;
+      }
+   }
+
+   /* Miss: replace an empty slot or the least recently used one */
+   cache_misses++;
+   victim = 0;
+   for (i = 1; i < SPECTRUM_CACHE_SIZE; i++)
+   {
+      if (cache[i].last_use < cache[victim].last_use)
+         victim = i;
+   }
+
+   poly_spectrum_destroy(cache[victim].spec);
+   cache[victim].spec = poly_spectrum_create(b, nb, max_na);
+   cache[victim].hash = h;
+   cache[victim].last_use = ++use_clock;
+
+   return cache[victim].spec;
+}
+
+/* poly_spectrum_cache_stats - see common_defs.h for more details */
+void poly_spectrum_cache_stats(long* hits, long* misses)
+{
+   *hits = cache_hits;
+   *misses = cache_misses;
+}
+
+/* poly_spectrum_cache_clear - see common_defs.h for more details */
+void poly_spectrum_cache_clear(void)
+{
+   int i;
+
+   for (i = 0; i < SPECTRUM_CACHE_SIZE; i++)
+   {
+      poly_spectrum_destroy(cache[i].spec);
+      cache[i].spec = NULL;
+      cache[i].last_use = 0;
+   }
+
+   cache_hits = 0;
+   cache_misses = 0;
+}
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <string.h>
+#include "common_defs.h"
+
+/*
+** Streaming overlap-add. The input arrives in pieces of any length and
+** is buffered into blocks of s->block coefficients. Each full block is
+** multiplied by the kernel spectrum, the nk-1 coefficients carried over
+** from the previous block are added to the front, the first block
+** coefficients are final and go to the callback, and the last nk-1 are
+** carried to the next block. Memory depends only on block and nk.
+*/
+
+/* Block size used when poly_stream_create gets block <= 0 */
+#define STREAM_DEFAULT_BLOCK  8192
+
+/* run_block - multiply the buffered len input coefficients and emit len */
+static void run_block(poly_stream* s, int len)
+{
+   int j;
+
+   poly_mul_spectrum(s->in, len, s->kernel, s->prod);
+
+   for (j = 0; j < (s->nk - 1); j++)
+      s->prod[j] += s->tail[j];
+
+   s->emit(s->prod, len, s->arg);
+   s->emitted += len;
+
+   memcpy(s->tail, s->prod + len, (s->nk - 1) * sizeof(double));
+   s->in_count = 0;
+}
+
+/* poly_stream_create - see common_defs.h for more details */
+poly_stream* poly_stream_create(const double* kernel, int nk, int block,
+                                poly_stream_fn emit, void* arg)
+{
+   poly_stream* s;
+
+   if (nk < 1 || !emit)
+      return NULL;
+
+   if (block <= 0)
+      block = (nk > STREAM_DEFAULT_BLOCK) ? nk : STREAM_DEFAULT_BLOCK;
+
+   s = (poly_stream*)fft_malloc(sizeof(poly_stream));
+   s->nk = nk;
+   s->block = block;
+   s->kernel = poly_spectrum_create(kernel, nk, block);
+   s->in = (double*)fft_malloc(block * sizeof(double));
+   s->prod = (double*)fft_malloc((block + nk - 1) * sizeof(double));
+   s->tail = (double*)fft_malloc((nk > 1 ? nk - 1 : 1) * sizeof(double));
+   s->in_count = 0;
+   s->pushed = 0;
+   s->emitted = 0;
+   s->emit = emit;
+   s->arg = arg;
+   memset(s->tail, 0, (nk > 1 ? nk - 1 : 1) * sizeof(double));
+
+   return s;
+}
+
+/* poly_stream_push - see common_defs.h for more details */
+void poly_stream_push(poly_stream* s, const double* a, int count)
+{
+   int take;
+
+   while (count > 0)
+   {
+      take = s->block - s->in_count;
+      if (take > count)
+         take = count;
+
+      memcpy(s->in + s->in_count, a, take * sizeof(double));
+      s->in_count += take;
+      s->pushed += take;
+      a += take;
+      count -= take;
+
+      if (s->in_count == s->block)
+         run_block(s, s->block);
+   }
+}
+
+/* poly_stream_finish - see common_defs.h for more details */
+void poly_stream_finish(poly_stream* s)
+{
+   if (s->pushed == 0)
+      return;
+
+   if (s->in_count > 0)
+      run_block(s, s->in_count);
+
+   /* The carried coefficients are the end of the product */
+   if (s->nk > 1)
+      s->emit(s->tail, s->nk - 1, s->arg);
+   s->emitted += s->nk - 1;
+}
+
+/* poly_stream_destroy - see common_defs.h for more details */
+void poly_stream_destroy(poly_stream* s)
+{
+   if (!s)
+      return;
+
+   poly_spectrum_destroy(s->kernel);
+   fft_free(s->in);
+   fft_free(s->prod);
+   fft_free(s->tail);
+   fft_free(s);
+}
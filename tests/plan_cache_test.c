@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../common_defs.h"
+
+/*
+** Check of the mixed radix plan cache (run with "make check"): a size
+** whose forward plan is the oldest entry of a full cache is multiplied
+** with poly_mul, which fetches the forward and then the inverse plan.
+** The inverse plan must not replace the forward plan it is paired with.
+*/
+
+/* Transform length of the multiply (3 * 2^6, a mixed radix size) */
+#define N             192
+
+/* Mixed radix sizes looked up after N, enough to fill the cache */
+#define OTHER_SIZES   63
+
+int main(void)
+{
+   complex a[N];
+   complex b[N];
+   double expect[N];
+   double err, max_err = 0.0;
+   int i, j, m, found;
+
+   /* N's forward plan goes in first, so it becomes the oldest entry */
+   fft_plan_get(N, 0);
+
+   for (m = 6, found = 0; found < OTHER_SIZES; m = fft_good_size(m + 1))
+   {
+      if ((m & (m - 1)) != 0 && m != N)
+      {
+         fft_plan_get(m, 0);
+         found++;
+      }
+   }
+
+   srand(1);
+   for (i = 0; i < N; i++)
+   {
+      a[i].r = i < N/2 ? rand() % 100 : 0;
+      b[i].r = i < N/2 ? rand() % 100 : 0;
+      a[i].i = b[i].i = 0;
+      expect[i] = 0;
+   }
+   for (i = 0; i < N/2; i++)
+      for (j = 0; j < N/2; j++)
+         expect[i + j] += a[i].r * b[j].r;
+
+   poly_mul_set_engine(FFT_ENGINE_PLAN);
+   poly_mul(a, b, N);
+
+   for (i = 0; i < N; i++)
+   {
+      err = fabs(a[i].r - expect[i]);
+      if (err > max_err)
+         max_err = err;
+   }
+
+   printf("poly_mul after %d mixed plans: max error %g\n", OTHER_SIZES,
+          max_err);
+   if (max_err > 1e-6)
+   {
+      printf("FAIL: product differs from schoolbook\n");
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "../text_io.h"
+
+/*
+** Checks of text_read_int (run with "make check"): values at the edges
+** of the int64_t range are read exactly, and longer or larger tokens are
+** a parse error instead of a wrapped value. text_peek_token then names
+** the rejected token without consuming it.
+*/
+
+/* One token and what text_read_int must return for it */
+typedef struct
+{
+   const char* text;
+   int ok;              /* expected return value */
+   int64_t value;       /* expected value if ok */
+} int_case;
+
+static const int_case cases[] =
+{
+   { "0",                             1, 0 },
+   { "-17",                           1, -17 },
+   { "+42",                           1, 42 },
+   { "12345678",                      1, 12345678 },
+   { "123456789012345678",            1, 123456789012345678LL },
+   { "9223372036854775807",           1, INT64_MAX },
+   { "-9223372036854775808",          1, INT64_MIN },
+   { "0000000000000000000000000007",  1, 7 },
+   { "9223372036854775808",           0, 0 },
+   { "-9223372036854775809",          0, 0 },
+   { "99999999999999999999",          0, 0 },
+   { "18446744073709551617",          0, 0 },
+   { "x",                             0, 0 },
+};
+
+/* A rejected token and what text_peek_token must return for it */
+typedef struct
+{
+   const char* text;
+   const char* token;
+} token_case;
+
+static const token_case tokens[] =
+{
+   { "  x1 2",                        "x1" },
+   { "\n99999999999999999999\n7",     "99999999999999999999" },
+   { "- 3",                           "-" },
+   { "   ",                           "" },
+};
+
+/* peek_one - fail text_read_int on text, then peek (twice) with a fresh
+   reader; 1 if both peeks give the expected token */
+static int peek_one(const token_case* tc, char* token, size_t size)
+{
+   text_reader r;
+   FILE* fp;
+   char again[32];
+   int64_t v;
+   int ret;
+
+   fp = tmpfile();
+   if (!fp)
+   {
+      perror("tmpfile");
+      return 0;
+   }
+   fputs(tc->text, fp);
+   rewind(fp);
+
+   text_reader_init(&r, fp);
+   ret = !text_read_int(&r, &v);
+   text_peek_token(&r, token, size);
+   text_peek_token(&r, again, sizeof(again));
+   text_reader_free(&r);
+   fclose(fp);
+
+   return ret && strcmp(token, tc->token) == 0 && strcmp(again, token) == 0;
+}
+
+/* read_one - parse text with a fresh reader */
+static int read_one(const char* text, int64_t* v)
+{
+   text_reader r;
+   FILE* fp;
+   int ret;
+
+   fp = tmpfile();
+   if (!fp)
+   {
+      perror("tmpfile");
+      return -1;
+   }
+   fputs(text, fp);
+   fputs("\n", fp);
+   rewind(fp);
+
+   text_reader_init(&r, fp);
+   ret = text_read_int(&r, v);
+   text_reader_free(&r);
+   fclose(fp);
+
+   return ret;
+}
+
+/* straddle_one - a 48 digit zero padded 7 that starts 40 bytes before the
+   end of the first TEXT_CHUNK, then 5; 1 if both are read whole */
+static int straddle_one(void)
+{
+   text_reader r;
+   FILE* fp;
+   int64_t first = 0, second = 0;
+   int i, ret;
+
+   fp = tmpfile();
+   if (!fp)
+   {
+      perror("tmpfile");
+      return 0;
+   }
+   for (i = 0; i < TEXT_CHUNK - 40; i++)
+      fputc(' ', fp);
+   for (i = 0; i < 47; i++)
+      fputc('0', fp);
+   fputs("7 5\n", fp);
+   rewind(fp);
+
+   text_reader_init(&r, fp);
+   ret = text_read_int(&r, &first) && text_read_int(&r, &second) &&
+         !text_read_int(&r, &second);
+   text_reader_free(&r);
+   fclose(fp);
+
+   if (!ret || first != 7 || second != 5)
+   {
+      printf("FAIL straddle: read %lld, %lld (expected 7, 5)\n",
+             (long long)first, (long long)second);
+      return 0;
+   }
+   return 1;
+}
+
+int main(void)
+{
+   int64_t v;
+   char token[32];
+   int i, ret;
+   int failed = 0;
+   int num_tokens = (int)(sizeof(tokens) / sizeof(tokens[0]));
+
+   for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++)
+   {
+      v = 0;
+      ret = read_one(cases[i].text, &v);
+      if (ret != cases[i].ok || (ret && v != cases[i].value))
+      {
+         printf("FAIL \"%s\": returned %d, value %lld (expected %d, %lld)\n",
+                cases[i].text, ret, (long long)v, cases[i].ok,
+                (long long)cases[i].value);
+         failed++;
+      }
+   }
+
+   if (!straddle_one())
+      failed++;
+
+   printf("text_read_int: %d of %d cases passed\n",
+          (int)(sizeof(cases) / sizeof(cases[0])) + 1 - failed,
+          (int)(sizeof(cases) / sizeof(cases[0])) + 1);
+
+   ret = failed;
+   for (i = 0; i < num_tokens; i++)
+   {
+      if (!peek_one(&tokens[i], token, sizeof(token)))
+      {
+         printf("FAIL peek \"%s\": got \"%s\" (expected \"%s\")\n",
+                tokens[i].text, token, tokens[i].token);
+         failed++;
+      }
+   }
+
+   printf("text_peek_token: %d of %d cases passed\n",
+          num_tokens - (failed - ret), num_tokens);
+   return failed ? 1 : 0;
+}
@@ -0,0 +1,326 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "text_io.h"
+
+/*
+** Fast text I/O for the driver. Reading looks at 8 bytes at a time: a
+** 64-bit load holds 8 characters, one flag per byte says which ones are
+** digits, and up to 8 digits are converted with three multiplies
+** (each step joins neighbouring digit groups: 1+1, 2+2, 4+4 digits).
+** Writing formats integers two digits at a time from a table.
+*/
+
+/* Slack after the buffered data so 8-byte loads stay in bounds */
+#define TEXT_PAD    64
+
+/* Longest number text_read_int needs in the buffer at once */
+#define MAX_NUMBER  32
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SWAR_DIGITS
+#endif
+
+static const char digit_pairs[] =
+   "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+   "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+   "8081828384858687888990919293949596979899";
+
+static const int64_t pow10[9] =
+   { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+/* refill - keep the unread bytes, append the next chunk, zero the pad */
+static void refill(text_reader* r)
+{
+   size_t got;
+
+   memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+   r->len -= r->pos;
+   r->pos = 0;
+
+   got = fread(r->buf + r->len, 1, TEXT_CHUNK - r->len, r->fp);
+   if (got == 0)
+      r->eof = 1;
+   r->len += got;
+
+   memset(r->buf + r->len, 0, TEXT_PAD);
+}
+
+/* text_reader_init - see text_io.h for more details */
+void text_reader_init(text_reader* r, FILE* fp)
+{
+   r->fp = fp;
+   r->buf = (char*)malloc(TEXT_CHUNK + TEXT_PAD);
+   r->pos = 0;
+   r->len = 0;
+   r->eof = 0;
+   memset(r->buf, 0, TEXT_PAD);
+}
+
+/* text_reader_free - see text_io.h for more details */
+void text_reader_free(text_reader* r)
+{
+   free(r->buf);
+   r->buf = NULL;
+}
+
+#ifdef SWAR_DIGITS
+/* digit_count - number of leading ASCII digits in 8 bytes (0..8) */
+static int digit_count(uint64_t chunk)
+{
+   uint64_t x = chunk ^ 0x3030303030303030ULL;
+   uint64_t mask;
+
+   /* Top bit of a byte is set unless the byte is '0'..'9' */
+   mask = (((x & 0x7F7F7F7F7F7F7F7FULL) + 0x7676767676767676ULL) | x) &
+          0x8080808080808080ULL;
+
+   return mask ? __builtin_ctzll(mask) / 8 : 8;
+}
+
+/* digit_value - value of the first k (1..8) digits of chunk */
+static int64_t digit_value(uint64_t chunk, int k)
+{
+   uint64_t v = (chunk & 0x0F0F0F0F0F0F0F0FULL) << (8 * (8 - k));
+
+   v = (v * 2561) >> 8;
+   v = ((v & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+   return (int64_t)(((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32);
+}
+#endif
+
+/* is_space - 1 for the whitespace text_read_int skips */
+static int is_space(char c)
+{
+   return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+/* parse_number - parse the number at *p (sign, digits) into v and move
+   *p past it; 0 if there are no digits or the value overflows */
+static int parse_number(const char** p, int64_t* v)
+{
+   const char* q = *p;
+   uint64_t value = 0;
+   uint64_t limit;
+   int neg = 0;
+   int k;
+#ifdef SWAR_DIGITS
+   uint64_t chunk;
+#endif
+
+   if (*q == '-' || *q == '+')
+   {
+      neg = (*q == '-');
+      q++;
+   }
+
+   /* Largest magnitude: 2^63 - 1, or 2^63 for a negative number */
+   limit = (uint64_t)INT64_MAX + neg;
+
+#ifdef SWAR_DIGITS
+   memcpy(&chunk, q, 8);
+   k = digit_count(chunk);
+   if (k == 0)
+      return 0;
+
+   for (;;)
+   {
+      if (__builtin_mul_overflow(value, (uint64_t)pow10[k], &value) ||
+          __builtin_add_overflow(value, (uint64_t)digit_value(chunk, k), 
+                                 &value) || value > limit)
+         return 0;
+      q += k;
+      if (k < 8)
+         break;
+
+      memcpy(&chunk, q, 8);
+      k = digit_count(chunk);
+      if (k == 0)
+         break;
+   }
+#else
+   if (*q < '0' || *q > '9')
+      return 0;
+
+   for (k = 0; q[k] >= '0' && q[k] <= '9'; k++)
+   {
+      if (__builtin_mul_overflow(value, 10, &value) ||
+          __builtin_add_overflow(value, (uint64_t)(q[k] - '0'), &value) ||
+          value > limit)
+         return 0;
+   }
+   q += k;
+#endif
+
+   *p = q;
+   *v = neg ? (int64_t)(0 - value) : (int64_t)value;
+   return 1;
+}
+
+/* text_read_int - see text_io.h for more details */
+int text_read_int(text_reader* r, int64_t* v)
+{
+   const char* p;
+   int64_t value;
+
+   /* Skip whitespace, refilling as needed */
+   for (;;)
+   {
+      while (r->pos < r->len && is_space(r->buf[r->pos]))
+         r->pos++;
+
+      if (r->len - r->pos >= MAX_NUMBER || r->eof)
+         break;
+      refill(r);
+   }
+
+   if (r->pos >= r->len)
+      return 0;
+
+   /*
+   ** Only MAX_NUMBER bytes are sure to be buffered. A longer number (e.g.
+   ** zero padded) that runs into the end of the data may go on in the
+   ** next chunk, so move it to the front, read more and parse it again.
+   */
+   for (;;)
+   {
+      p = r->buf + r->pos;
+      if (!parse_number(&p, &value))
+         return 0;
+
+      if (p < r->buf + r->len || r->eof)
+         break;
+
+      /* A number filling the whole buffer is too long to be valid */
+      if (r->pos == 0 && r->len == TEXT_CHUNK)
+         return 0;
+      refill(r);
+   }
+
+   r->pos = p - r->buf;
+   *v = value;
+   return 1;
+}
+
+/* text_peek_token - see text_io.h for more details */
+void text_peek_token(text_reader* r, char* buf, size_t size)
+{
+   size_t i;
+
+   /* Same skip as text_read_int, so the token is its next input */
+   for (;;)
+   {
+      while (r->pos < r->len && is_space(r->buf[r->pos]))
+         r->pos++;
+
+      if (r->len - r->pos >= MAX_NUMBER || r->eof)
+         break;
+      refill(r);
+   }
+
+   for (i = 0; i + 1 < size && r->pos + i < r->len &&
+        !is_space(r->buf[r->pos + i]); i++)
+      buf[i] = r->buf[r->pos + i];
+   buf[i] = '\0';
+}
+
+/* flush - hand the buffered output to the stream */
+static void flush(text_writer* w)
+{
+   if (w->len > 0)
+      fwrite(w->buf, 1, w->len, w->fp);
+   w->len = 0;
+}
+
+/* text_writer_init - see text_io.h for more details */
+void text_writer_init(text_writer* w, FILE* fp)
+{
+   w->fp = fp;
+   w->buf = (char*)malloc(TEXT_CHUNK + TEXT_PAD);
+   w->len = 0;
+}
+
+/* text_write_str - see text_io.h for more details */
+void text_write_str(text_writer* w, const char* s)
+{
+   while (*s)
+   {
+      if (w->len >= TEXT_CHUNK)
+         flush(w);
+      w->buf[w->len++] = *s++;
+   }
+}
+
+/* text_write_int - see text_io.h for more details */
+void text_write_int(text_writer* w, int64_t v)
+{
+   char tmp[24];
+   char* end = tmp + sizeof(tmp);
+   char* p = end;
+   uint64_t u = (v < 0) ? 0 - (uint64_t)v : (uint64_t)v;
+   int d;
+
+   if (w->len + sizeof(tmp) > TEXT_CHUNK)
+      flush(w);
+
+   /* Two digits per step from the end */
+   while (u >= 100)
+   {
+      d = (int)(u % 100) * 2;
+      u /= 100;
+      *--p = digit_pairs[d + 1];
+      *--p = digit_pairs[d];
+   }
+   if (u >= 10)
+   {
+      d = (int)u * 2;
+      *--p = digit_pairs[d + 1];
+      *--p = digit_pairs[d];
+   }
+   else
+      *--p = (char)('0' + u);
+
+   if (v < 0)
+      *--p = '-';
+
+   memcpy(w->buf + w->len, p, end - p);
+   w->len += end - p;
+}
+
+/* text_write_coeff - see text_io.h for more details */
+void text_write_coeff(text_writer* w, int64_t k, int64_t v)
+{
+   if (w->len + 64 > TEXT_CHUNK)
+      flush(w);
+
+   w->buf[w->len++] = '[';
+   text_write_int(w, k);
+   memcpy(w->buf + w->len, "] = ", 4);
+   w->len += 4;
+   text_write_int(w, v);
+   w->buf[w->len++] = '\n';
+}
+
+/* text_write_coeff_double - see text_io.h for more details */
+void text_write_coeff_double(text_writer* w, int64_t k, double v)
+{
+   char tmp[400];
+
+   if (fabs(v) < 9.0e18)
+   {
+      text_write_coeff(w, k, (int64_t)llround(v));
+      return;
+   }
+
+   snprintf(tmp, sizeof(tmp), "[%lld] = %.0f\n", (long long)k, v);
+   text_write_str(w, tmp);
+}
+
+/* text_writer_close - see text_io.h for more details */
+void text_writer_close(text_writer* w)
+{
+   flush(w);
+   fflush(w->fp);
+   free(w->buf);
+   w->buf = NULL;
+}
@@ -0,0 +1,97 @@
+#ifndef TEXT_IO_H
+#define TEXT_IO_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Bytes read or written per stdio call */
+#define TEXT_CHUNK  (1<<16)
+
+/*
+** text_reader
+**
+** Buffered integer reader. The input is read TEXT_CHUNK bytes
+** at a time and kept padded, so the parser can always look at
+** 8 bytes at once.
+*/
+typedef struct
+{
+   FILE* fp;            /* source */
+   char* buf;           /* buffered input */
+   size_t pos;          /* next unread byte */
+   size_t len;          /* bytes in buf */
+   int eof;             /* 1 once fp has no more data */
+} text_reader;
+
+/*
+** text_writer
+**
+** Buffered output. Integers are formatted by hand into the
+** buffer, which goes to the stream in TEXT_CHUNK pieces.
+*/
+typedef struct
+{
+   FILE* fp;            /* destination */
+   char* buf;           /* pending output */
+   size_t len;          /* bytes in buf */
+} text_writer;
+
+/* text_reader_init - start reading fp */
+void text_reader_init(text_reader* r, FILE* fp);
+
+/* text_reader_free - free the reader's buffer (fp is left open) */
+void text_reader_free(text_reader* r);
+
+/*---------------------------------------------------------
+** NAME: text_read_int
+**
+** PURPOSE:
+**    Read the next decimal integer (optional sign, up to 19
+**    digits), skipping whitespace, like scanf("%lld").
+**    Values outside the int64_t range are an error, not
+**    wrapped.
+**    Digits are found and converted 8 at a time with
+**    64-bit SWAR arithmetic (one byte per lane).
+**
+** INPUTS:
+**    r     Reader
+**
+** OUTPUTS:
+**    v     The integer
+**
+** RETURNS: 1 if an integer was read, 0 at end of input, if
+**          the next text is not an integer or if it does
+**          not fit in int64_t (the reader does not move)
+**
+**-------------------------------------------------------*/
+int text_read_int(text_reader* r, int64_t* v);
+
+/*
+** text_peek_token - copy the next whitespace separated token (at most
+** size-1 bytes, "" at end of input) into buf without consuming it, e.g.
+** to name the text text_read_int rejected
+*/
+void text_peek_token(text_reader* r, char* buf, size_t size);
+
+/* text_writer_init - start buffering output for fp */
+void text_writer_init(text_writer* w, FILE* fp);
+
+/* text_write_str - append a string */
+void text_write_str(text_writer* w, const char* s);
+
+/* text_write_int - append a decimal integer */
+void text_write_int(text_writer* w, int64_t v);
+
+/* text_write_coeff - append "[k] = v\n" */
+void text_write_coeff(text_writer* w, int64_t k, int64_t v);
+
+/*
+** text_write_coeff_double - append "[k] = v\n" with v rounded to the
+** nearest integer (falls back to printf formatting beyond int64)
+*/
+void text_write_coeff_double(text_writer* w, int64_t k, double v);
+
+/* text_writer_close - write out pending output and free the buffer */
+void text_writer_close(text_writer* w);
+
+#endif
@@ -0,0 +1,319 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "thread_pool.h"
+
+#define TP_MAX_THREADS  256    /* upper bound on pool size */
+#define TP_DEQUE_SIZE   4096   /* tasks per deque */
+#define TP_MAX_CHUNKS   1024   /* upper bound on tp_parallel_for chunks */
+
+/* Per-thread task deque (owner works at the bottom, thieves at the top) */
+typedef struct
+{
+   pthread_mutex_t lock;
+   tp_task* tasks[TP_DEQUE_SIZE];
+   int top;
+   int bottom;
+} tp_deque;
+
+/* One chunk of a tp_parallel_for */
+typedef struct
+{
+   void (*fn)(void* arg, int begin, int end);
+   void* arg;
+   int begin;
+   int end;
+} tp_range;
+
+static tp_deque deques[TP_MAX_THREADS];
+static pthread_t workers[TP_MAX_THREADS];
+static atomic_int num_threads;     /* 0 until the pool is started */
+static atomic_int shutting_down;
+
+/* Serializes starting and stopping the pool (num_threads changes) */
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Idle threads sleep here while there is nothing to steal */
+static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cv = PTHREAD_COND_INITIALIZER;
+static atomic_int pending;         /* tasks sitting in deques */
+
+/* Index of the calling thread's deque (pool threads are 1..n-1) */
+static __thread int self = 0;
+
+/* deque_push - push onto the bottom of a deque, 0 if full */
+static int deque_push(tp_deque* d, tp_task* task)
+{
+   int ok = 0;
+
+   pthread_mutex_lock(&d->lock);
+   if (d->bottom - d->top < TP_DEQUE_SIZE)
+   {
+      d->tasks[d->bottom % TP_DEQUE_SIZE] = task;
+      d->bottom++;
+      ok = 1;
+   }
+   pthread_mutex_unlock(&d->lock);
+
+   return ok;
+}
+
+/* deque_pop - pop from the bottom (owner), NULL if empty */
+static tp_task* deque_pop(tp_deque* d)
+{
+   tp_task* task = NULL;
+
+   pthread_mutex_lock(&d->lock);
+   if (d->bottom > d->top)
+   {
+      d->bottom--;
+      task = d->tasks[d->bottom % TP_DEQUE_SIZE];
+   }
+   pthread_mutex_unlock(&d->lock);
+
+   return task;
+}
+
+/* deque_steal - take from the top (thief), NULL if empty */
+static tp_task* deque_steal(tp_deque* d)
+{
+   tp_task* task = NULL;
+
+   pthread_mutex_lock(&d->lock);
+   if (d->bottom > d->top)
+   {
+      task = d->tasks[d->top % TP_DEQUE_SIZE];
+      d->top++;
+   }
+   pthread_mutex_unlock(&d->lock);
+
+   return task;
+}
+
+/* find_task - own deque first, then try to steal from the others */
+static tp_task* find_task(void)
+{
+   tp_task* task;
+   int n, i;
+
+   if (atomic_load(&pending) <= 0)
+      return NULL;
+
+   n = atomic_load(&num_threads);
+   task = deque_pop(&deques[self]);
+   for (i = 1; !task && i < n; i++)
+      task = deque_steal(&deques[(self + i) % n]);
+
+   if (task)
+      atomic_fetch_sub(&pending, 1);
+
+   return task;
+}
+
+/* run_task - run a task and mark it done */
+static void run_task(tp_task* task)
+{
+   task->fn(task->arg);
+   atomic_store_explicit(&task->done, 1, memory_order_release);
+}
+
+/* worker_main - pool thread loop */
+static void* worker_main(void* arg)
+{
+   tp_task* task;
+
+   self = (int)(long)arg;
+
+   while (!atomic_load(&shutting_down))
+   {
+      task = find_task();
+      if (task)
+      {
+         run_task(task);
+         continue;
+      }
+
+      pthread_mutex_lock(&idle_lock);
+      while (atomic_load(&pending) <= 0 && !atomic_load(&shutting_down))
+         pthread_cond_wait(&idle_cv, &idle_lock);
+      pthread_mutex_unlock(&idle_lock);
+   }
+
+   return NULL;
+}
+
+/* pool_start - start nthreads threads (init_lock held, pool stopped) */
+static void pool_start(int nthreads)
+{
+   long i;
+
+   if (nthreads <= 0)
+      nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   if (nthreads < 1)
+      nthreads = 1;
+   if (nthreads > TP_MAX_THREADS)
+      nthreads = TP_MAX_THREADS;
+
+   atomic_store(&shutting_down, 0);
+   atomic_store(&pending, 0);
+   for (i = 0; i < nthreads; i++)
+   {
+      pthread_mutex_init(&deques[i].lock, NULL);
+      deques[i].top = 0;
+      deques[i].bottom = 0;
+   }
+
+   atomic_store(&num_threads, nthreads);
+   for (i = 1; i < nthreads; i++)
+      pthread_create(&workers[i], NULL, worker_main, (void*)i);
+}
+
+/* pool_stop - stop and join the pool threads (init_lock held) */
+static void pool_stop(void)
+{
+   int n = atomic_load(&num_threads);
+   int i;
+
+   if (n == 0)
+      return;
+
+   pthread_mutex_lock(&idle_lock);
+   atomic_store(&shutting_down, 1);
+   pthread_cond_broadcast(&idle_cv);
+   pthread_mutex_unlock(&idle_lock);
+
+   for (i = 1; i < n; i++)
+      pthread_join(workers[i], NULL);
+   for (i = 0; i < n; i++)
+      pthread_mutex_destroy(&deques[i].lock);
+
+   atomic_store(&num_threads, 0);
+}
+
+/* tp_init - see thread_pool.h for more details */
+void tp_init(int nthreads)
+{
+   pthread_mutex_lock(&init_lock);
+   pool_stop();
+   pool_start(nthreads);
+   pthread_mutex_unlock(&init_lock);
+}
+
+/* tp_shutdown - see thread_pool.h for more details */
+void tp_shutdown(void)
+{
+   pthread_mutex_lock(&init_lock);
+   pool_stop();
+   pthread_mutex_unlock(&init_lock);
+}
+
+/* tp_num_threads - see thread_pool.h for more details */
+int tp_num_threads(void)
+{
+   char* env;
+   int n = atomic_load(&num_threads);
+
+   /* First use: only one caller starts the pool, the others wait for it */
+   if (n == 0)
+   {
+      pthread_mutex_lock(&init_lock);
+      if (atomic_load(&num_threads) == 0)
+      {
+         env = getenv("FFT_THREADS");
+         pool_start(env ? atoi(env) : 0);
+      }
+      n = atomic_load(&num_threads);
+      pthread_mutex_unlock(&init_lock);
+   }
+
+   return n;
+}
+
+/* tp_spawn - see thread_pool.h for more details */
+void tp_spawn(tp_task* task, void (*fn)(void* arg), void* arg)
+{
+   task->fn = fn;
+   task->arg = arg;
+   atomic_store(&task->done, 0);
+
+   if (tp_num_threads() == 1 || !deque_push(&deques[self], task))
+   {
+      run_task(task);
+      return;
+   }
+
+   /* Count under the idle lock so a sleeping thread can't miss it */
+   pthread_mutex_lock(&idle_lock);
+   atomic_fetch_add(&pending, 1);
+   pthread_cond_signal(&idle_cv);
+   pthread_mutex_unlock(&idle_lock);
+}
+
+/* tp_wait - see thread_pool.h for more details */
+void tp_wait(tp_task* task)
+{
+   tp_task* other;
+
+   while (!atomic_load_explicit(&task->done, memory_order_acquire))
+   {
+      other = find_task();
+      if (other)
+         run_task(other);
+      else
+         sched_yield();
+   }
+}
+
+/* run_range - tp_task wrapper for one tp_parallel_for chunk */
+static void run_range(void* arg)
+{
+   tp_range* range = (tp_range*)arg;
+
+   range->fn(range->arg, range->begin, range->end);
+}
+
+/* tp_parallel_for - see thread_pool.h for more details */
+void tp_parallel_for(int count, int grain, 
+                     void (*fn)(void* arg, int begin, int end), void* arg)
+{
+   tp_task tasks[TP_MAX_CHUNKS];
+   tp_range ranges[TP_MAX_CHUNKS];
+   int chunks, size, i;
+
+   if (grain < 1)
+      grain = 1;
+
+   /* A few chunks per thread so stealing can even out the load */
+   chunks = (count + grain - 1) / grain;
+   if (chunks > 4 * tp_num_threads())
+      chunks = 4 * tp_num_threads();
+   if (chunks > TP_MAX_CHUNKS)
+      chunks = TP_MAX_CHUNKS;
+
+   if (chunks <= 1)
+   {
+      if (count > 0)
+         fn(arg, 0, count);
+      return;
+   }
+
+   /* Rounding size up can leave fewer (never empty) chunks */
+   size = (count + chunks - 1) / chunks;
+   chunks = (count + size - 1) / size;
+   for (i = 0; i < chunks; i++)
+   {
+      ranges[i].fn = fn;
+      ranges[i].arg = arg;
+      ranges[i].begin = i * size;
+      ranges[i].end = (i + 1) * size < count ? (i + 1) * size : count;
+   }
+
+   /* Queue all but the first chunk, run the first one here */
+   for (i = 1; i < chunks; i++)
+      tp_spawn(&tasks[i], run_range, &ranges[i]);
+   run_range(&ranges[0]);
+
+   for (i = 1; i < chunks; i++)
+      tp_wait(&tasks[i]);
+}
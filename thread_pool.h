@@ -0,0 +1,101 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdatomic.h>
+
+/*
+** tp_task
+**
+** A unit of work for the thread pool. The caller owns the memory (it
+** normally lives on the stack of the spawning function) and must call
+** tp_wait before it goes out of scope.
+*/
+typedef struct
+{
+   void (*fn)(void* arg);  /* function to run */
+   void* arg;              /* argument passed to fn */
+   atomic_int done;        /* set to 1 once fn has returned */
+} tp_task;
+
+/*---------------------------------------------------------
+** NAME: tp_init
+**
+** PURPOSE:
+**    Start the work-stealing pool. Each thread has its own
+**    task deque: new tasks are pushed and popped at the 
+**    bottom of the owner's deque (depth first), and idle
+**    threads steal from the top of other deques (oldest, 
+**    i.e. largest, tasks first). The calling thread counts
+**    as one of the threads.
+**
+**    Called automatically on first use with the value of
+**    the FFT_THREADS environment variable, or the number of
+**    online CPUs if it isn't set. Starting and stopping are
+**    serialized by a lock, so threads that reach the first
+**    use together start the pool once; tp_init and
+**    tp_shutdown must still not run while tasks are queued.
+**
+** INPUTS:
+**    nthreads Total number of threads (1 = run serially,
+**             0 = number of online CPUs)
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void tp_init(int nthreads);
+
+/* tp_shutdown - stop and join all pool threads */
+void tp_shutdown(void);
+
+/* tp_num_threads - number of threads in the pool (starts it if needed) */
+int tp_num_threads(void);
+
+/*---------------------------------------------------------
+** NAME: tp_spawn
+**
+** PURPOSE:
+**    Queue fn(arg) on the calling thread's deque. If the
+**    pool is serial or the deque is full, fn runs right
+**    away on the calling thread.
+**
+** INPUTS:
+**    task  Task storage (owned by the caller)
+**    fn    Function to run
+**    arg   Argument passed to fn
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void tp_spawn(tp_task* task, void (*fn)(void* arg), void* arg);
+
+/* tp_wait - run queued/stolen tasks until task is done */
+void tp_wait(tp_task* task);
+
+/*---------------------------------------------------------
+** NAME: tp_parallel_for
+**
+** PURPOSE:
+**    Call fn(arg, begin, end) over sub-ranges covering
+**    [0, count), splitting the range across the pool in
+**    chunks of at least grain iterations. Returns once all
+**    chunks are done.
+**
+** INPUTS:
+**    count Number of iterations
+**    grain Minimum chunk size
+**    fn    Function to run on each chunk
+**    arg   Argument passed to fn
+**
+** OUTPUTS: none
+**
+** RETURNS: void
+**
+**-------------------------------------------------------*/
+void tp_parallel_for(int count, int grain, 
+                     void (*fn)(void* arg, int begin, int end), void* arg);
+
+#endif
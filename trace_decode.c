@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fft_trace.h"
+
+/*
+** Offline decoder for FFT_TRACE files (see fft_trace.h).
+**
+**    trace_decode [-d depth] [-j out.json] trace.bin
+**
+** Rebuilds the recursion tree of every thread from the enter/exit
+** events and prints
+**
+**    - a per-level summary (sub-transforms, n, total and mean time,
+**      butterflies)
+**    - the tree itself down to -d levels (default 3)
+**
+** and with -j writes the events as a Chrome trace (chrome://tracing or
+** ui.perfetto.dev): one complete ("X") event per sub-transform and an
+** instant event per recorded butterfly.
+**
+** Events lost to ring wrap-around show up as exits without an enter
+** (ignored) and enters without an exit (closed at the last event).
+*/
+
+/* Deeper than any recursion of a 32-bit length */
+#define MAX_LEVELS  64
+
+/* One sub-transform */
+typedef struct
+{
+   uint64_t start;      /* enter time stamp */
+   uint64_t end;        /* exit time stamp */
+   uint32_t n;          /* length */
+   int level;           /* depth in the tree */
+   int inv;             /* 1 for an inverse transform */
+   int parent;          /* index of the parent node, -1 at the root */
+   int child;           /* first child, -1 if none */
+   int sibling;         /* next child of the parent, -1 if none */
+   int last;            /* last child (for appending), -1 if none */
+   long butterflies;    /* butterfly events directly in this node */
+} trace_node;
+
+/* One thread of the trace */
+typedef struct
+{
+   fft_trace_thread info;
+   fft_trace_event* events;
+   trace_node* nodes;
+   int num_nodes;
+   long orphans;        /* exits whose enter was overwritten */
+} trace_thread;
+
+static fft_trace_header header;
+static trace_thread* threads;
+
+/* ns - time stamp relative to the start of tracing, in ns */
+static double ns(uint64_t tsc)
+{
+   return (double)(int64_t)(tsc - header.tsc_start) * header.ns_per_tick;
+}
+
+/* read_trace - load the header and every thread's events */
+static int read_trace(const char* path)
+{
+   FILE* fp;
+   uint32_t t;
+
+   fp = fopen(path, "rb");
+   if (!fp)
+   {
+      fprintf(stderr, "cannot open %s\n", path);
+      return -1;
+   }
+
+   if (fread(&header, sizeof(header), 1, fp) != 1 ||
+       header.magic != FFT_TRACE_MAGIC || header.version != FFT_TRACE_VERSION)
+   {
+      fprintf(stderr, "%s is not an FFT trace\n", path);
+      fclose(fp);
+      return -1;
+   }
+
+   threads = (trace_thread*)calloc(header.threads + 1, sizeof(trace_thread));
+   for (t = 0; t < header.threads; t++)
+   {
+      if (fread(&threads[t].info, sizeof(fft_trace_thread), 1, fp) != 1)
+         break;
+
+      threads[t].events = (fft_trace_event*)malloc(
+         (threads[t].info.count + 1) * sizeof(fft_trace_event));
+      if (fread(threads[t].events, sizeof(fft_trace_event),
+                threads[t].info.count, fp) != threads[t].info.count)
+         break;
+   }
+   fclose(fp);
+
+   if (t < header.threads)
+   {
+      fprintf(stderr, "%s is truncated\n", path);
+      return -1;
+   }
+
+   return 0;
+}
+
+/* build_tree - nodes of one thread from its enter/exit events */
+static void build_tree(trace_thread* th)
+{
+   int stack[MAX_LEVELS];
+   trace_node* node;
+   fft_trace_event* e;
+   uint64_t i;
+   int depth = 0;
+   int id;
+
+   th->nodes = (trace_node*)malloc((th->info.count + 1) * sizeof(trace_node));
+   th->num_nodes = 0;
+
+   for (i = 0; i < th->info.count; i++)
+   {
+      e = &th->events[i];
+      switch (e->type)
+      {
+         case FFT_TRACE_ENTER:
+            id = th->num_nodes++;
+            node = &th->nodes[id];
+            node->start = e->tsc;
+            node->end = e->tsc;
+            node->n = e->arg;
+            node->level = depth;
+            node->inv = e->flags & 1;
+            node->parent = depth ? stack[depth - 1] : -1;
+            node->child = node->sibling = node->last = -1;
+            node->butterflies = 0;
+
+            if (node->parent >= 0)
+            {
+               if (th->nodes[node->parent].last >= 0)
+                  th->nodes[th->nodes[node->parent].last].sibling = id;
+               else
+                  th->nodes[node->parent].child = id;
+               th->nodes[node->parent].last = id;
+            }
+
+            if (depth < MAX_LEVELS)
+               stack[depth++] = id;
+            break;
+
+         case FFT_TRACE_EXIT:
+            if (depth == 0)
+            {
+               th->orphans++;
+               break;
+            }
+            th->nodes[stack[--depth]].end = e->tsc;
+            break;
+
+         case FFT_TRACE_BUTTERFLY:
+            if (depth > 0)
+               th->nodes[stack[depth - 1]].butterflies++;
+            break;
+      }
+   }
+
+   /* Still open when the trace ended */
+   while (depth > 0)
+      th->nodes[stack[--depth]].end = th->events[th->info.count - 1].tsc;
+}
+
+/* print_summary - sub-transforms and time per level, all threads */
+static void print_summary(void)
+{
+   double total[MAX_LEVELS];
+   long count[MAX_LEVELS], bf[MAX_LEVELS];
+   uint32_t n_min[MAX_LEVELS], n_max[MAX_LEVELS];
+   trace_node* node;
+   uint32_t t;
+   int i, lvl, levels = 0;
+
+   memset(total, 0, sizeof(total));
+   memset(count, 0, sizeof(count));
+   memset(bf, 0, sizeof(bf));
+   for (t = 0; t < header.threads; t++)
+   {
+      for (i = 0; i < threads[t].num_nodes; i++)
+      {
+         node = &threads[t].nodes[i];
+         lvl = node->level;
+         if (count[lvl] == 0 || node->n < n_min[lvl])
+            n_min[lvl] = node->n;
+         if (count[lvl] == 0 || node->n > n_max[lvl])
+            n_max[lvl] = node->n;
+         count[lvl]++;
+         total[lvl] += ns(node->end) - ns(node->start);
+         bf[lvl] += node->butterflies;
+         if (lvl + 1 > levels)
+            levels = lvl + 1;
+      }
+   }
+
+   printf("%-6s %10s %10s %10s %14s %12s %12s\n", "level", "count", "n min",
+          "n max", "total (us)", "mean (us)", "butterflies");
+   for (lvl = 0; lvl < levels; lvl++)
+   {
+      printf("%-6d %10ld %10u %10u %14.3f %12.3f %12ld\n", lvl, count[lvl],
+             n_min[lvl], n_max[lvl], total[lvl] * 1e-3,
+             total[lvl] * 1e-3 / count[lvl], bf[lvl]);
+   }
+}
+
+/* print_node - one node and its children down to max_depth */
+static void print_node(trace_thread* th, int id, int max_depth)
+{
+   trace_node* node = &th->nodes[id];
+   int c;
+
+   printf("%*s%s n = %-8u %12.3f us  (at %.3f us)", 2 * node->level, "",
+          node->inv ? "ifft" : "fft", node->n,
+          (ns(node->end) - ns(node->start)) * 1e-3, ns(node->start) * 1e-3);
+   if (node->butterflies)
+      printf("  %ld butterflies", node->butterflies);
+   printf("\n");
+
+   if (node->level + 1 > max_depth)
+      return;
+
+   for (c = node->child; c >= 0; c = th->nodes[c].sibling)
+      print_node(th, c, max_depth);
+}
+
+/* print_trees - recursion tree of every thread */
+static void print_trees(int max_depth)
+{
+   uint32_t t;
+   int i;
+
+   for (t = 0; t < header.threads; t++)
+   {
+      printf("\nthread %u: %llu events (%llu recorded)", threads[t].info.thread,
+             (unsigned long long)threads[t].info.count,
+             (unsigned long long)threads[t].info.written);
+      if (threads[t].orphans)
+         printf(", %ld exits without enter", threads[t].orphans);
+      printf("\n");
+
+      for (i = 0; i < threads[t].num_nodes; i++)
+      {
+         if (threads[t].nodes[i].parent < 0)
+            print_node(&threads[t], i, max_depth);
+      }
+   }
+}
+
+/* write_chrome - Chrome trace JSON of all threads */
+static int write_chrome(const char* path)
+{
+   trace_thread* th;
+   trace_node* node;
+   fft_trace_event* e;
+   const char* sep = "";
+   FILE* fp;
+   uint64_t i;
+   uint32_t t;
+   int j;
+
+   fp = fopen(path, "w");
+   if (!fp)
+   {
+      fprintf(stderr, "cannot create %s\n", path);
+      return -1;
+   }
+
+   fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+   for (t = 0; t < header.threads; t++)
+   {
+      th = &threads[t];
+      for (j = 0; j < th->num_nodes; j++)
+      {
+         node = &th->nodes[j];
+         fprintf(fp, "%s{\"name\":\"%s %u\",\"cat\":\"fft\",\"ph\":\"X\","
+                 "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,"
+                 "\"args\":{\"n\":%u,\"level\":%d}}", sep,
+                 node->inv ? "ifft" : "fft", node->n, ns(node->start) * 1e-3,
+                 (ns(node->end) - ns(node->start)) * 1e-3, th->info.thread,
+                 node->n, node->level);
+         sep = ",\n";
+      }
+
+      for (i = 0; i < th->info.count; i++)
+      {
+         e = &th->events[i];
+         if (e->type != FFT_TRACE_BUTTERFLY)
+            continue;
+         fprintf(fp, "%s{\"name\":\"butterfly\",\"cat\":\"fft\",\"ph\":\"i\","
+                 "\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+                 "\"args\":{\"k\":%u,\"level\":%d}}", sep, ns(e->tsc) * 1e-3,
+                 th->info.thread, e->arg, e->level);
+         sep = ",\n";
+      }
+   }
+   fprintf(fp, "\n]}\n");
+
+   if (fclose(fp) != 0)
+   {
+      fprintf(stderr, "error writing %s\n", path);
+      return -1;
+   }
+
+   return 0;
+}
+
+int main(int argc, char* argv[])
+{
+   char* json = NULL;
+   char* path = NULL;
+   uint32_t t;
+   int max_depth = 3;
+   int i;
+
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+         max_depth = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+         json = argv[++i];
+      else if (argv[i][0] != '-' && !path)
+         path = argv[i];
+      else
+      {
+         path = NULL;
+         break;
+      }
+   }
+
+   if (!path)
+   {
+      fprintf(stderr, "usage: %s [-d depth] [-j out.json] trace.bin\n", argv[0]);
+      return 1;
+   }
+
+   if (read_trace(path) != 0)
+      return 1;
+
+   for (t = 0; t < header.threads; t++)
+      build_tree(&threads[t]);
+
+   print_summary();
+   print_trees(max_depth);
+
+   if (json && write_chrome(json) != 0)
+      return 1;
+
+   return 0;
+}